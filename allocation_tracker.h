@@ -0,0 +1,303 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <string>
+
+// Subsystems that heap usage is attributed to. The tag of the allocating
+// thread is used; ThreadPool tasks inherit the tag of the thread that
+// submitted them.
+enum class AllocationTag : uint32_t {
+    General,
+    ImageDecode,  // decoded cv::Mat images and color conversion
+    Paths,        // directory listings and path strings
+    Index,        // annotation index columns
+    Stats,        // dataset statistics
+    Anchors,      // anchor clustering
+    Caches,       // prefetch and decoded-image caches
+    Export,       // preview and video exporters
+    UI,           // Dear ImGui
+    Count
+};
+
+inline const char* AllocationTagName(AllocationTag tag) {
+    switch (tag) {
+        case AllocationTag::General: return "general";
+        case AllocationTag::ImageDecode: return "image_decode";
+        case AllocationTag::Paths: return "paths";
+        case AllocationTag::Index: return "index";
+        case AllocationTag::Stats: return "stats";
+        case AllocationTag::Anchors: return "anchors";
+        case AllocationTag::Caches: return "caches";
+        case AllocationTag::Export: return "export";
+        case AllocationTag::UI: return "ui";
+        default: return "unknown";
+    }
+}
+
+inline AllocationTag& CurrentAllocationTag() {
+    static thread_local AllocationTag tag = AllocationTag::General;
+    return tag;
+}
+
+// Attributes allocations on this thread to a subsystem for the scope's lifetime.
+// Compiles to nothing unless J_BBOX_TRACK_ALLOCATIONS is defined.
+class AllocationScope {
+#if defined(J_BBOX_TRACK_ALLOCATIONS)
+private:
+    AllocationTag previous;
+
+public:
+    explicit AllocationScope(AllocationTag tag) : previous(CurrentAllocationTag()) {
+        CurrentAllocationTag() = tag;
+    }
+    ~AllocationScope() {
+        CurrentAllocationTag() = previous;
+    }
+#else
+public:
+    explicit AllocationScope(AllocationTag) {}
+#endif
+    AllocationScope(const AllocationScope&) = delete;
+    AllocationScope& operator=(const AllocationScope&) = delete;
+};
+
+// Process-wide heap accounting per tag.
+//
+// With J_BBOX_TRACK_ALLOCATIONS defined, global operator new/delete (below),
+// Dear ImGui's allocator and OpenCV's Mat allocator all report here. Every
+// operator new block carries a small header with its size and tag so the
+// matching delete can be attributed without a lookup table.
+class AllocationTracker {
+public:
+    struct Usage {
+        int64_t currentBytes = 0;
+        int64_t peakBytes = 0;
+        uint64_t allocations = 0;
+    };
+
+private:
+    struct Counters {
+        std::atomic<int64_t> current{0};
+        std::atomic<int64_t> peak{0};
+        std::atomic<uint64_t> allocations{0};
+    };
+
+    static Counters* TagCounters() {
+        static Counters counters[(size_t)AllocationTag::Count];
+        return counters;
+    }
+
+    static Counters& TotalCounters() {
+        static Counters total;
+        return total;
+    }
+
+    static void RaisePeak(std::atomic<int64_t>& peak, int64_t value) {
+        int64_t observed = peak.load(std::memory_order_relaxed);
+        while (value > observed && !peak.compare_exchange_weak(observed, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    struct Header {
+        uint64_t size;
+        uint32_t tag;
+        uint32_t offset;  // from the start of the raw block to the user pointer
+    };
+    static_assert(sizeof(Header) == 16, "header must keep 16-byte alignment");
+
+public:
+    static constexpr bool Enabled() {
+#if defined(J_BBOX_TRACK_ALLOCATIONS)
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // Allocations made by the calling thread so far, e.g. for per-frame
+    // deltas on the UI thread
+    static uint64_t& ThreadAllocations() {
+        static thread_local uint64_t allocations = 0;
+        return allocations;
+    }
+
+    static void Record(AllocationTag tag, int64_t bytes) {
+        Counters& counters = TagCounters()[(size_t)tag];
+        int64_t current = counters.current.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        int64_t total = TotalCounters().current.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        if (bytes > 0) {
+            ThreadAllocations()++;
+            counters.allocations.fetch_add(1, std::memory_order_relaxed);
+            TotalCounters().allocations.fetch_add(1, std::memory_order_relaxed);
+            RaisePeak(counters.peak, current);
+            RaisePeak(TotalCounters().peak, total);
+        }
+    }
+
+    static Usage GetUsage(AllocationTag tag) {
+        const Counters& counters = TagCounters()[(size_t)tag];
+        return {counters.current.load(), counters.peak.load(), counters.allocations.load()};
+    }
+
+    static Usage GetTotal() {
+        const Counters& counters = TotalCounters();
+        return {counters.current.load(), counters.peak.load(), counters.allocations.load()};
+    }
+
+    static void* Allocate(size_t size, size_t alignment) {
+        size_t headerSize = alignment > sizeof(Header) ? alignment : sizeof(Header);
+        void* raw = nullptr;
+        if (alignment <= alignof(std::max_align_t)) {
+            raw = std::malloc(headerSize + size);
+        } else {
+            size_t total = (headerSize + size + alignment - 1) / alignment * alignment;
+            raw = std::aligned_alloc(alignment, total);
+        }
+        if (raw == nullptr) return nullptr;
+
+        char* user = static_cast<char*>(raw) + headerSize;
+        AllocationTag tag = CurrentAllocationTag();
+        Header* header = reinterpret_cast<Header*>(user) - 1;
+        header->size = size;
+        header->tag = (uint32_t)tag;
+        header->offset = (uint32_t)headerSize;
+        Record(tag, (int64_t)size);
+        return user;
+    }
+
+    static void Free(void* pointer) {
+        if (pointer == nullptr) return;
+        Header* header = static_cast<Header*>(pointer) - 1;
+        Record((AllocationTag)header->tag, -(int64_t)header->size);
+        std::free(static_cast<char*>(pointer) - header->offset);
+    }
+
+    // Dear ImGui allocator hooks (ImGui::SetAllocatorFunctions)
+    static void* ImGuiAlloc(size_t size, void*) {
+        AllocationScope scope(AllocationTag::UI);
+        return Allocate(size, alignof(std::max_align_t));
+    }
+    static void ImGuiFree(void* pointer, void*) {
+        Free(pointer);
+    }
+
+    static void WriteReport(std::ostream& out) {
+        char line[128];
+        std::snprintf(line, sizeof(line), "%-14s %14s %14s %14s\n", "subsystem", "current_bytes", "peak_bytes", "allocations");
+        out << line;
+        for (size_t i = 0; i < (size_t)AllocationTag::Count; i++) {
+            Usage usage = GetUsage((AllocationTag)i);
+            std::snprintf(line, sizeof(line), "%-14s %14lld %14lld %14llu\n", AllocationTagName((AllocationTag)i),
+                          (long long)usage.currentBytes, (long long)usage.peakBytes, (unsigned long long)usage.allocations);
+            out << line;
+        }
+        Usage total = GetTotal();
+        std::snprintf(line, sizeof(line), "%-14s %14lld %14lld %14llu\n", "total", (long long)total.currentBytes,
+                      (long long)total.peakBytes, (unsigned long long)total.allocations);
+        out << line;
+    }
+
+    static bool WriteReport(const std::string& path) {
+        std::ofstream file(path);
+        if (!file.is_open()) {
+            std::cerr << "Failed to write memory report: " << path << std::endl;
+            return false;
+        }
+        WriteReport(file);
+        std::cout << "Memory report written to: " << path << std::endl;
+        return true;
+    }
+};
+
+#if defined(J_BBOX_TRACK_ALLOCATIONS)
+
+#include <opencv2/opencv.hpp>
+
+// cv::Mat allocator that delegates to OpenCV's standard allocator and records
+// buffer sizes under the allocating thread's tag. The tag is kept in the
+// UMatData's allocator flags so the release is attributed to the same subsystem.
+class TrackingMatAllocator : public cv::MatAllocator {
+private:
+    const cv::MatAllocator* base;
+
+public:
+    TrackingMatAllocator() : base(cv::Mat::getStdAllocator()) {}
+
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step, cv::AccessFlag flags,
+                           cv::UMatUsageFlags usageFlags) const override {
+        cv::UMatData* u = base->allocate(dims, sizes, type, data, step, flags, usageFlags);
+        if (u == nullptr) return u;
+        u->currAllocator = this;
+        u->prevAllocator = this;
+        u->allocatorFlags_ = (int)CurrentAllocationTag();
+        if (data == nullptr) {
+            AllocationTracker::Record(CurrentAllocationTag(), (int64_t)u->size);
+        }
+        return u;
+    }
+
+    bool allocate(cv::UMatData* u, cv::AccessFlag accessFlags, cv::UMatUsageFlags usageFlags) const override {
+        return base->allocate(u, accessFlags, usageFlags);
+    }
+
+    void deallocate(cv::UMatData* u) const override {
+        if (u == nullptr) return;
+        if (u->origdata != nullptr && !(u->flags & cv::UMatData::USER_ALLOCATED)) {
+            AllocationTracker::Record((AllocationTag)u->allocatorFlags_, -(int64_t)u->size);
+        }
+        base->deallocate(u);
+    }
+
+    static TrackingMatAllocator& Shared() {
+        static TrackingMatAllocator allocator;
+        return allocator;
+    }
+};
+
+// Global operator new/delete replacements. This header must be included by
+// exactly one translation unit of the executable (main.cpp).
+void* operator new(size_t size) {
+    void* pointer = AllocationTracker::Allocate(size, alignof(std::max_align_t));
+    if (pointer == nullptr) throw std::bad_alloc();
+    return pointer;
+}
+void* operator new[](size_t size) {
+    void* pointer = AllocationTracker::Allocate(size, alignof(std::max_align_t));
+    if (pointer == nullptr) throw std::bad_alloc();
+    return pointer;
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return AllocationTracker::Allocate(size, alignof(std::max_align_t));
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return AllocationTracker::Allocate(size, alignof(std::max_align_t));
+}
+void* operator new(size_t size, std::align_val_t alignment) {
+    void* pointer = AllocationTracker::Allocate(size, (size_t)alignment);
+    if (pointer == nullptr) throw std::bad_alloc();
+    return pointer;
+}
+void* operator new[](size_t size, std::align_val_t alignment) {
+    void* pointer = AllocationTracker::Allocate(size, (size_t)alignment);
+    if (pointer == nullptr) throw std::bad_alloc();
+    return pointer;
+}
+void operator delete(void* pointer) noexcept { AllocationTracker::Free(pointer); }
+void operator delete[](void* pointer) noexcept { AllocationTracker::Free(pointer); }
+void operator delete(void* pointer, size_t) noexcept { AllocationTracker::Free(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { AllocationTracker::Free(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { AllocationTracker::Free(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { AllocationTracker::Free(pointer); }
+void operator delete(void* pointer, std::align_val_t) noexcept { AllocationTracker::Free(pointer); }
+void operator delete[](void* pointer, std::align_val_t) noexcept { AllocationTracker::Free(pointer); }
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept { AllocationTracker::Free(pointer); }
+void operator delete[](void* pointer, size_t, std::align_val_t) noexcept { AllocationTracker::Free(pointer); }
+
+#endif
@@ -0,0 +1,449 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "annotation_index.h"
+#include "thread_pool.h"
+
+struct AnchorOptions {
+    int anchorCount = 9;
+    int imageSize = 640;            // training resolution boxes are rescaled to (long side)
+    float anchorThreshold = 4.0f;   // YOLOv5 anchor_t: max allowed w/h ratio between box and anchor
+    int kmeansIterations = 30;      // Lloyd iterations on the sample
+    int fullDataIterations = 3;     // Lloyd iterations over every box afterwards
+    int generations = 1000;
+    float mutationProbability = 0.9f;
+    float mutationSigma = 0.1f;
+    size_t sampleSize = 100000;     // boxes used for seeding and the genetic step
+    uint32_t seed = 0;
+};
+
+struct AnchorResult {
+    std::vector<float> widths;
+    std::vector<float> heights;
+    float meanIoU = 0.0f;
+    float bestPossibleRecall = 0.0f;  // fraction of boxes with an anchor inside the ratio threshold
+    float fitness = 0.0f;
+    size_t boxCount = 0;
+    double seconds = 0.0;
+
+    // Anchors in the yaml layout YOLOv5 model configs use, three per output layer
+    std::string ToYaml() const {
+        std::ostringstream out;
+        out << "anchors:" << std::endl;
+        size_t perLayer = widths.size() % 3 == 0 ? 3 : widths.size();
+        for (size_t i = 0; i < widths.size(); i += perLayer) {
+            out << "  - [";
+            for (size_t j = i; j < std::min(widths.size(), i + perLayer); j++) {
+                out << (j > i ? ", " : "") << std::lround(widths[j]) << "," << std::lround(heights[j]);
+            }
+            out << "]" << std::endl;
+        }
+        return out.str();
+    }
+};
+
+// Generates YOLO anchors from every box in an AnnotationIndex.
+//
+// Boxes are rescaled the way YOLOv5's autoanchor does (long image side to
+// imageSize), seeded with k-means++ on a random sample, clustered with Lloyd
+// iterations using 1 - IoU as the distance (first on the sample, then a few
+// passes over all boxes), then evolved with the autoanchor genetic step. All
+// passes are split across the thread pool and compare four boxes per SSE
+// instruction; only the final passes touch the full data, so the cost stays
+// a small multiple of one scan of the box columns.
+class AnchorGenerator {
+private:
+    std::vector<float> boxW;
+    std::vector<float> boxH;
+    AnchorOptions options;
+    ThreadPool& pool;
+
+public:
+    AnchorGenerator(const AnchorOptions& anchorOptions, ThreadPool& threadPool = ThreadPool::Shared())
+        : options(anchorOptions), pool(threadPool) {}
+
+    // Gathers rescaled width/height pairs; boxes of images with unknown size or zero area are skipped
+    void CollectBoxes(const AnnotationIndex& index) {
+        boxW.clear();
+        boxH.clear();
+        boxW.reserve(index.BoxCount());
+        boxH.reserve(index.BoxCount());
+
+        const auto& ids = index.ImageIds();
+        for (size_t row = 0; row < ids.size(); row++) {
+            if (ids[row] == AnnotationIndex::kDeadRow) continue;
+            int longSide = std::max(index.ImageWidth(ids[row]), index.ImageHeight(ids[row]));
+            if (longSide <= 0) continue;
+            float scale = (float)options.imageSize / longSide;
+            float w = (index.XMax()[row] - index.XMin()[row]) * scale;
+            float h = (index.YMax()[row] - index.YMin()[row]) * scale;
+            // YOLOv5 drops boxes smaller than 2 px after rescaling
+            if (w >= 2.0f && h >= 2.0f) {
+                boxW.push_back(w);
+                boxH.push_back(h);
+            }
+        }
+    }
+
+    // Direct input for callers that already have width/height pairs
+    void SetBoxes(std::vector<float> widths, std::vector<float> heights) {
+        boxW = std::move(widths);
+        boxH = std::move(heights);
+    }
+
+    AnchorResult Run() {
+        AnchorResult result;
+        result.boxCount = boxW.size();
+        const int k = options.anchorCount;
+        if ((int)boxW.size() < k || k <= 0) {
+            std::cerr << "Not enough boxes for " << k << " anchors (" << boxW.size() << " usable)" << std::endl;
+            return result;
+        }
+
+        auto startTime = std::chrono::steady_clock::now();
+        std::mt19937 rng(options.seed);
+
+        // Random sample for seeding and evolution
+        std::vector<uint32_t> sample;
+        if (boxW.size() <= options.sampleSize) {
+            sample.resize(boxW.size());
+            for (size_t i = 0; i < sample.size(); i++) sample[i] = (uint32_t)i;
+        } else {
+            std::uniform_int_distribution<uint32_t> pick(0, (uint32_t)boxW.size() - 1);
+            sample.resize(options.sampleSize);
+            for (auto& index : sample) index = pick(rng);
+        }
+
+        std::vector<float> sampleW(sample.size()), sampleH(sample.size());
+        for (size_t i = 0; i < sample.size(); i++) {
+            sampleW[i] = boxW[sample[i]];
+            sampleH[i] = boxH[sample[i]];
+        }
+
+        std::vector<float> anchorW, anchorH;
+        SeedKMeansPlusPlus(sampleW, sampleH, rng, anchorW, anchorH);
+
+        for (int iteration = 0; iteration < options.kmeansIterations; iteration++) {
+            if (!LloydStep(sampleW, sampleH, anchorW, anchorH)) break;
+        }
+        for (int iteration = 0; iteration < options.fullDataIterations; iteration++) {
+            if (!LloydStep(boxW, boxH, anchorW, anchorH)) break;
+        }
+
+        Evolve(sampleW, sampleH, rng, anchorW, anchorH);
+
+        // Sort by area, smallest first
+        std::vector<int> order(k);
+        for (int i = 0; i < k; i++) order[i] = i;
+        std::sort(order.begin(), order.end(), [&](int a, int b) {
+            return anchorW[a] * anchorH[a] < anchorW[b] * anchorH[b];
+        });
+        for (int i : order) {
+            result.widths.push_back(anchorW[i]);
+            result.heights.push_back(anchorH[i]);
+        }
+
+        Evaluate(result);
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        return result;
+    }
+
+private:
+    static float IoU(float w1, float h1, float w2, float h2) {
+        float inter = std::min(w1, w2) * std::min(h1, h2);
+        return inter / (w1 * h1 + w2 * h2 - inter);
+    }
+
+    // Autoanchor match metric: worst of the w and h ratios, 1 for a perfect match
+    static float RatioMetric(float w1, float h1, float w2, float h2) {
+        float rw = w1 / w2;
+        float rh = h1 / h2;
+        return std::min(std::min(rw, 1.0f / rw), std::min(rh, 1.0f / rh));
+    }
+
+    void SeedKMeansPlusPlus(const std::vector<float>& sampleW, const std::vector<float>& sampleH, std::mt19937& rng,
+                            std::vector<float>& anchorW, std::vector<float>& anchorH) {
+        std::uniform_int_distribution<size_t> first(0, sampleW.size() - 1);
+        size_t chosen = first(rng);
+        anchorW.assign(1, sampleW[chosen]);
+        anchorH.assign(1, sampleH[chosen]);
+
+        std::vector<float> distance(sampleW.size(), 1.0f);
+        while ((int)anchorW.size() < options.anchorCount) {
+            double total = 0.0;
+            for (size_t i = 0; i < sampleW.size(); i++) {
+                float d = 1.0f - IoU(sampleW[i], sampleH[i], anchorW.back(), anchorH.back());
+                distance[i] = std::min(distance[i], d);
+                total += (double)distance[i] * distance[i];
+            }
+
+            std::uniform_real_distribution<double> pick(0.0, total);
+            double target = pick(rng);
+            size_t next = sampleW.size() - 1;
+            for (size_t i = 0; i < sampleW.size(); i++) {
+                target -= (double)distance[i] * distance[i];
+                if (target <= 0.0) {
+                    next = i;
+                    break;
+                }
+            }
+            anchorW.push_back(sampleW[next]);
+            anchorH.push_back(sampleH[next]);
+        }
+    }
+
+    // Assigns every box to its highest-IoU anchor and moves anchors to the mean
+    // of their members. Returns false once the assignment has converged.
+    bool LloydStep(const std::vector<float>& w, const std::vector<float>& h,
+                   std::vector<float>& anchorW, std::vector<float>& anchorH) {
+        const int k = options.anchorCount;
+        struct Sums {
+            std::vector<double> w, h;
+            std::vector<int64_t> count;
+        };
+        std::vector<Sums> partials(pool.MaxChunks());
+
+        size_t used = pool.ParallelFor(0, w.size(), [&](size_t begin, size_t end, size_t chunk) {
+            Sums& sums = partials[chunk];
+            sums.w.assign(k, 0.0);
+            sums.h.assign(k, 0.0);
+            sums.count.assign(k, 0);
+            int32_t best[256];
+            for (size_t block = begin; block < end; block += 256) {
+                size_t n = std::min<size_t>(256, end - block);
+                AssignNearest(&w[block], &h[block], n, anchorW, anchorH, best);
+                for (size_t i = 0; i < n; i++) {
+                    sums.w[best[i]] += w[block + i];
+                    sums.h[best[i]] += h[block + i];
+                    sums.count[best[i]]++;
+                }
+            }
+        }, 16 * 1024);
+
+        bool moved = false;
+        for (int c = 0; c < k; c++) {
+            double w = 0.0, h = 0.0;
+            int64_t count = 0;
+            for (size_t p = 0; p < used; p++) {
+                w += partials[p].w[c];
+                h += partials[p].h[c];
+                count += partials[p].count[c];
+            }
+            if (count == 0) continue;  // keep empty clusters where they are
+            float newW = (float)(w / count);
+            float newH = (float)(h / count);
+            if (std::abs(newW - anchorW[c]) > 1e-3f || std::abs(newH - anchorH[c]) > 1e-3f) moved = true;
+            anchorW[c] = newW;
+            anchorH[c] = newH;
+        }
+        return moved;
+    }
+
+    // Picks the highest-IoU anchor per box. IoUs are compared by cross-multiplying
+    // inter/union pairs, so the inner loop has no divisions.
+    static void AssignNearest(const float* boxW, const float* boxH, size_t count, const std::vector<float>& anchorW,
+                              const std::vector<float>& anchorH, int32_t* best) {
+        const int k = (int)anchorW.size();
+        size_t i = 0;
+#if defined(__SSE2__)
+        for (; i + 4 <= count; i += 4) {
+            __m128 w = _mm_loadu_ps(boxW + i);
+            __m128 h = _mm_loadu_ps(boxH + i);
+            __m128 area = _mm_mul_ps(w, h);
+            __m128 bestInter = _mm_setzero_ps();
+            __m128 bestUnion = _mm_set1_ps(1.0f);
+            __m128i bestIndex = _mm_setzero_si128();
+            for (int c = 0; c < k; c++) {
+                __m128 aw = _mm_set1_ps(anchorW[c]);
+                __m128 ah = _mm_set1_ps(anchorH[c]);
+                __m128 inter = _mm_mul_ps(_mm_min_ps(w, aw), _mm_min_ps(h, ah));
+                __m128 unionArea = _mm_sub_ps(_mm_add_ps(area, _mm_mul_ps(aw, ah)), inter);
+                __m128 better = _mm_cmpgt_ps(_mm_mul_ps(inter, bestUnion), _mm_mul_ps(bestInter, unionArea));
+                bestInter = _mm_or_ps(_mm_and_ps(better, inter), _mm_andnot_ps(better, bestInter));
+                bestUnion = _mm_or_ps(_mm_and_ps(better, unionArea), _mm_andnot_ps(better, bestUnion));
+                __m128i mask = _mm_castps_si128(better);
+                bestIndex = _mm_or_si128(_mm_and_si128(mask, _mm_set1_epi32(c)), _mm_andnot_si128(mask, bestIndex));
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(best + i), bestIndex);
+        }
+#endif
+        for (; i < count; i++) {
+            float area = boxW[i] * boxH[i];
+            float bestInter = 0.0f, bestUnion = 1.0f;
+            int bestIndex = 0;
+            for (int c = 0; c < k; c++) {
+                float inter = std::min(boxW[i], anchorW[c]) * std::min(boxH[i], anchorH[c]);
+                float unionArea = area + anchorW[c] * anchorH[c] - inter;
+                if (inter * bestUnion > bestInter * unionArea) {
+                    bestInter = inter;
+                    bestUnion = unionArea;
+                    bestIndex = c;
+                }
+            }
+            best[i] = bestIndex;
+        }
+    }
+
+    // Best autoanchor ratio metric (and optionally best IoU) of each box against
+    // the anchors. Box reciprocals are computed once per box so the per-anchor
+    // work is multiplies and min/max only.
+    static void MatchBoxes(const float* w, const float* h, size_t count, const std::vector<float>& anchorW,
+                           const std::vector<float>& anchorH, float* bestRatio, float* bestIoU) {
+        const size_t k = anchorW.size();
+        std::vector<float> invAnchorW(k), invAnchorH(k), anchorArea(k);
+        for (size_t c = 0; c < k; c++) {
+            invAnchorW[c] = 1.0f / anchorW[c];
+            invAnchorH[c] = 1.0f / anchorH[c];
+            anchorArea[c] = anchorW[c] * anchorH[c];
+        }
+
+        size_t i = 0;
+#if defined(__SSE2__)
+        const __m128 one = _mm_set1_ps(1.0f);
+        for (; i + 4 <= count; i += 4) {
+            __m128 bw = _mm_loadu_ps(w + i);
+            __m128 bh = _mm_loadu_ps(h + i);
+            __m128 invW = _mm_div_ps(one, bw);
+            __m128 invH = _mm_div_ps(one, bh);
+            __m128 area = _mm_mul_ps(bw, bh);
+            __m128 ratio = _mm_setzero_ps();
+            __m128 bestInter = _mm_setzero_ps();
+            __m128 bestUnion = one;
+            for (size_t c = 0; c < k; c++) {
+                __m128 aw = _mm_set1_ps(anchorW[c]);
+                __m128 ah = _mm_set1_ps(anchorH[c]);
+                __m128 rw = _mm_min_ps(_mm_mul_ps(bw, _mm_set1_ps(invAnchorW[c])), _mm_mul_ps(aw, invW));
+                __m128 rh = _mm_min_ps(_mm_mul_ps(bh, _mm_set1_ps(invAnchorH[c])), _mm_mul_ps(ah, invH));
+                ratio = _mm_max_ps(ratio, _mm_min_ps(rw, rh));
+                if (bestIoU) {
+                    __m128 inter = _mm_mul_ps(_mm_min_ps(bw, aw), _mm_min_ps(bh, ah));
+                    __m128 unionArea = _mm_sub_ps(_mm_add_ps(area, _mm_set1_ps(anchorArea[c])), inter);
+                    __m128 better = _mm_cmpgt_ps(_mm_mul_ps(inter, bestUnion), _mm_mul_ps(bestInter, unionArea));
+                    bestInter = _mm_or_ps(_mm_and_ps(better, inter), _mm_andnot_ps(better, bestInter));
+                    bestUnion = _mm_or_ps(_mm_and_ps(better, unionArea), _mm_andnot_ps(better, bestUnion));
+                }
+            }
+            _mm_storeu_ps(bestRatio + i, ratio);
+            if (bestIoU) _mm_storeu_ps(bestIoU + i, _mm_div_ps(bestInter, bestUnion));
+        }
+#endif
+        for (; i < count; i++) {
+            float ratio = 0.0f, iou = 0.0f;
+            for (size_t c = 0; c < k; c++) {
+                ratio = std::max(ratio, RatioMetric(w[i], h[i], anchorW[c], anchorH[c]));
+                iou = std::max(iou, IoU(w[i], h[i], anchorW[c], anchorH[c]));
+            }
+            bestRatio[i] = ratio;
+            if (bestIoU) bestIoU[i] = iou;
+        }
+    }
+
+    // YOLOv5 autoanchor fitness: mean best-anchor ratio metric over boxes that pass the threshold
+    float Fitness(const std::vector<float>& sampleW, const std::vector<float>& sampleH,
+                  const std::vector<float>& anchorW, const std::vector<float>& anchorH) {
+        const float threshold = 1.0f / options.anchorThreshold;
+        std::vector<double> partials(pool.MaxChunks(), 0.0);
+        size_t used = pool.ParallelFor(0, sampleW.size(), [&](size_t begin, size_t end, size_t chunk) {
+            float ratio[256];
+            double total = 0.0;
+            for (size_t block = begin; block < end; block += 256) {
+                size_t n = std::min<size_t>(256, end - block);
+                MatchBoxes(&sampleW[block], &sampleH[block], n, anchorW, anchorH, ratio, nullptr);
+                for (size_t i = 0; i < n; i++) {
+                    total += ratio[i] > threshold ? ratio[i] : 0.0f;
+                }
+            }
+            partials[chunk] = total;
+        }, 16 * 1024);
+
+        double total = 0.0;
+        for (size_t p = 0; p < used; p++) total += partials[p];
+        return (float)(total / sampleW.size());
+    }
+
+    void Evolve(const std::vector<float>& sampleW, const std::vector<float>& sampleH, std::mt19937& rng,
+                std::vector<float>& anchorW, std::vector<float>& anchorH) {
+        std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+        std::normal_distribution<float> normal(0.0f, 1.0f);
+        float bestFitness = Fitness(sampleW, sampleH, anchorW, anchorH);
+        const size_t dims = anchorW.size() * 2;
+
+        for (int generation = 0; generation < options.generations; generation++) {
+            // Mutate until at least one gene changes, as autoanchor does
+            std::vector<float> factor(dims, 1.0f);
+            bool changed = false;
+            while (!changed) {
+                float scale = uniform(rng);  // one random step size per generation
+                for (size_t d = 0; d < dims; d++) {
+                    bool mutate = uniform(rng) < options.mutationProbability;
+                    float value = mutate ? (scale * normal(rng) * options.mutationSigma + 1.0f) : 1.0f;
+                    factor[d] = std::clamp(value, 0.3f, 3.0f);
+                    changed |= factor[d] != 1.0f;
+                }
+            }
+
+            std::vector<float> candidateW(anchorW.size()), candidateH(anchorH.size());
+            for (size_t c = 0; c < anchorW.size(); c++) {
+                candidateW[c] = std::max(anchorW[c] * factor[c * 2], 2.0f);
+                candidateH[c] = std::max(anchorH[c] * factor[c * 2 + 1], 2.0f);
+            }
+
+            float fitness = Fitness(sampleW, sampleH, candidateW, candidateH);
+            if (fitness > bestFitness) {
+                bestFitness = fitness;
+                anchorW.swap(candidateW);
+                anchorH.swap(candidateH);
+            }
+        }
+    }
+
+    // Full-data metrics for the final anchors
+    void Evaluate(AnchorResult& result) {
+        const float threshold = 1.0f / options.anchorThreshold;
+        struct Totals {
+            double iou = 0.0, fitness = 0.0;
+            int64_t recalled = 0;
+        };
+        std::vector<Totals> partials(pool.MaxChunks());
+
+        size_t used = pool.ParallelFor(0, boxW.size(), [&](size_t begin, size_t end, size_t chunk) {
+            Totals totals;
+            float ratio[256], iou[256];
+            for (size_t block = begin; block < end; block += 256) {
+                size_t n = std::min<size_t>(256, end - block);
+                MatchBoxes(&boxW[block], &boxH[block], n, result.widths, result.heights, ratio, iou);
+                for (size_t i = 0; i < n; i++) {
+                    totals.iou += iou[i];
+                    if (ratio[i] > threshold) {
+                        totals.recalled++;
+                        totals.fitness += ratio[i];
+                    }
+                }
+            }
+            partials[chunk] = totals;
+        }, 64 * 1024);
+
+        Totals sum;
+        for (size_t p = 0; p < used; p++) {
+            sum.iou += partials[p].iou;
+            sum.fitness += partials[p].fitness;
+            sum.recalled += partials[p].recalled;
+        }
+        result.meanIoU = (float)(sum.iou / boxW.size());
+        result.fitness = (float)(sum.fitness / boxW.size());
+        result.bestPossibleRecall = (float)sum.recalled / boxW.size();
+    }
+};
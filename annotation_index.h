@@ -0,0 +1,541 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "batch_reader.h"
+#include "image_header.h"
+#include "thread_pool.h"
+
+// Bounding box in original image pixel coordinates, as stored in the sidecar CSV.
+// An oriented box is the rectangle rotated about its center by angle degrees,
+// clockwise on screen (image y points down); axis-aligned boxes have angle 0.
+struct BoxRecord {
+    float xmin, ymin, xmax, ymax;
+    uint16_t classId = 0;  // row of the class table; 4-column sidecars load as class 0
+    float angle = 0.0f;    // degrees in (-180, 180]; sidecars without the column load as 0
+};
+
+constexpr long kMaxClassId = 0xFFFF;
+
+// Header written to sidecars. Readers also accept the older 4-column form.
+constexpr const char* kSidecarHeader = "x_min,y_min,x_max,y_max,class_id";
+// Header of sidecars holding at least one rotated box; the angle column is
+// only written then, so axis-aligned sidecars keep the 5-column form
+constexpr const char* kOrientedSidecarHeader = "x_min,y_min,x_max,y_max,class_id,angle";
+
+// Maps any finite angle in degrees to (-180, 180]
+inline float NormalizeAngle(float degrees) {
+    float angle = std::fmod(degrees, 360.0f);
+    if (angle > 180.0f) angle -= 360.0f;
+    if (angle <= -180.0f) angle += 360.0f;
+    return angle;
+}
+
+inline bool HasOrientedBoxes(const std::vector<BoxRecord>& boxes) {
+    return std::any_of(boxes.begin(), boxes.end(), [](const BoxRecord& box) { return box.angle != 0.0f; });
+}
+
+// Writes a sidecar: header, then one row per box in whole pixels
+inline void WriteBoxCsvText(std::ostream& out, const std::vector<BoxRecord>& boxes) {
+    bool oriented = HasOrientedBoxes(boxes);
+    out << (oriented ? kOrientedSidecarHeader : kSidecarHeader) << std::endl;
+    for (const BoxRecord& box : boxes) {
+        out << (int)box.xmin << "," << (int)box.ymin << "," << (int)box.xmax << "," << (int)box.ymax << "," << box.classId;
+        if (oriented) out << "," << box.angle;
+        out << std::endl;
+    }
+}
+
+// Sidecar CSV path for an image: same path with the extension replaced by .csv
+inline std::string CsvPathForImage(const std::string& imagePath) {
+    std::string csvPath = imagePath;
+    size_t lastDot = csvPath.find_last_of('.');
+    if (lastDot != std::string::npos) {
+        csvPath = csvPath.substr(0, lastDot) + ".csv";
+    } else {
+        csvPath += ".csv";
+    }
+    return csvPath;
+}
+
+// Sorted list of the images in a directory, using the extensions ScanDirectory accepts
+inline std::vector<std::string> ListImageFiles(const std::string& directory) {
+    static const std::vector<std::string> supportedExtensions = {".jpg", ".jpeg", ".png", ".bmp", ".tiff", ".tga"};
+    std::vector<std::string> files;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+        if (!entry.is_regular_file()) continue;
+        std::string extension = entry.path().extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        if (std::find(supportedExtensions.begin(), supportedExtensions.end(), extension) != supportedExtensions.end()) {
+            files.push_back(entry.path().string());
+        }
+    }
+    if (error) {
+        std::cerr << "Error listing directory " << directory << ": " << error.message() << std::endl;
+    }
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+// Parses one x_min,y_min,x_max,y_max[,class_id[,angle]] sidecar row. The
+// coordinates are read as decimals and truncated to whole pixels, as
+// LoadBoundingBoxFromCSV always did and the label validator does; rows with
+// fewer than four numbers or a non-finite one are rejected. A missing or
+// invalid class column leaves the box in class 0, and a missing or invalid
+// angle leaves it axis-aligned.
+inline bool ParseBoxCsvRow(const std::string& line, BoxRecord& box) {
+    double values[4];
+    const char* cursor = line.c_str();
+    for (int parsed = 0; parsed < 4; parsed++) {
+        char* end = nullptr;
+        values[parsed] = std::strtod(cursor, &end);
+        if (end == cursor || !std::isfinite(values[parsed])) return false;
+        cursor = end;
+        while (*cursor == ' ' || *cursor == '\t') cursor++;
+        if (parsed < 3) {
+            if (*cursor != ',') return false;
+            cursor++;
+        }
+    }
+    if (*cursor != ',' && *cursor != '\r' && *cursor != '\0') return false;
+    auto toPixel = [](double v) { return (float)(int)std::max(-1e9, std::min(1e9, v)); };
+    box = {toPixel(values[0]), toPixel(values[1]), toPixel(values[2]), toPixel(values[3])};
+    if (*cursor == ',') {
+        char* end = nullptr;
+        double classId = std::strtod(cursor + 1, &end);
+        if (end != cursor + 1 && classId >= 0.0 && classId <= kMaxClassId && classId == std::floor(classId)) {
+            box.classId = (uint16_t)classId;
+        }
+        if (end != cursor + 1 && *end == ',') {
+            char* angleEnd = nullptr;
+            float angle = std::strtof(end + 1, &angleEnd);
+            if (angleEnd != end + 1 && std::isfinite(angle)) box.angle = NormalizeAngle(angle);
+        }
+    }
+    return true;
+}
+
+// Parses every row of sidecar CSV text. A first line containing letters is
+// treated as the header, matching LoadBoundingBoxFromCSV. Malformed rows are
+// skipped.
+inline void ParseBoxCsvText(const char* text, size_t size, std::vector<BoxRecord>& boxes) {
+    boxes.clear();
+    std::string line;
+    bool firstLine = true;
+    size_t lineBegin = 0;
+    while (lineBegin < size) {
+        const char* newline = static_cast<const char*>(std::memchr(text + lineBegin, '\n', size - lineBegin));
+        size_t lineEnd = newline != nullptr ? (size_t)(newline - text) : size;
+        line.assign(text + lineBegin, lineEnd - lineBegin);
+        lineBegin = lineEnd + 1;
+
+        if (firstLine) {
+            firstLine = false;
+            bool isHeader = false;
+            for (char c : line) {
+                if (std::isalpha(static_cast<unsigned char>(c))) {
+                    isHeader = true;
+                    break;
+                }
+            }
+            if (isHeader) continue;
+        }
+
+        BoxRecord box;
+        if (ParseBoxCsvRow(line, box)) boxes.push_back(box);
+    }
+}
+
+// Parses a sidecar CSV file. Returns false if the file cannot be opened.
+inline bool ParseBoxCsv(const std::string& csvPath, std::vector<BoxRecord>& boxes) {
+    boxes.clear();
+    std::ifstream csvFile(csvPath, std::ios::binary);
+    if (!csvFile.is_open()) return false;
+    std::string text((std::istreambuf_iterator<char>(csvFile)), std::istreambuf_iterator<char>());
+    ParseBoxCsvText(text.data(), text.size(), boxes);
+    return true;
+}
+
+// Writes a sidecar CSV, replacing the file. The rows go to a temporary file
+// that is renamed over the sidecar, so an interrupted write never leaves a
+// truncated one. Returns false if either step fails.
+inline bool WriteSidecar(const std::string& csvPath, const std::vector<BoxRecord>& boxes) {
+    std::string tempPath = csvPath + ".tmp";
+    {
+        std::ofstream csvFile(tempPath);
+        if (!csvFile.is_open()) return false;
+        WriteBoxCsvText(csvFile, boxes);
+        csvFile.close();
+        if (!csvFile) {
+            std::remove(tempPath.c_str());
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(tempPath, csvPath, error);
+    if (error) {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+// In-memory index of every annotation in the current image directory.
+//
+// Boxes are kept in structure-of-arrays form so whole-dataset passes
+// (statistics, anchor clustering, validation) stream through contiguous
+// float columns. Each image owns a contiguous row range [boxBegin, boxBegin + boxCount).
+// Editing an image whose box count changes appends a fresh range and marks the
+// old rows dead (imageId == kDeadRow); the columns are compacted once dead
+// rows outnumber live ones.
+//
+// Per-class box counts and a class -> image inverted index (sorted image ids
+// per class) are kept up to date by Build and SetBoxes, so class filters,
+// per-class statistics and class-based navigation never scan the columns.
+class AnnotationIndex {
+public:
+    static constexpr uint32_t kDeadRow = 0xFFFFFFFFu;
+
+    // Called after SetBoxes with the boxes that were replaced and their replacement
+    using ChangeListener = std::function<void(uint32_t imageId, const std::vector<BoxRecord>& removed,
+                                              const std::vector<BoxRecord>& added)>;
+
+private:
+    std::vector<std::string> imagePaths;
+    std::vector<int> imageWidths;
+    std::vector<int> imageHeights;
+    std::vector<uint32_t> boxBegin;
+    std::vector<uint32_t> boxCount;
+
+    // Box columns
+    std::vector<float> xmin, ymin, xmax, ymax;
+    std::vector<uint16_t> classIds;
+    std::vector<float> angles;
+    std::vector<uint32_t> imageIds;
+
+    // Indexed by class id, sized to the highest class seen + 1
+    std::vector<uint32_t> classBoxCounts;
+    std::vector<std::vector<uint32_t>> classImages;  // sorted ids of the images with the class
+    // Position in classImages of the last NextImageWithClass result, per class
+    mutable std::vector<size_t> classCursor;
+
+    size_t liveRows = 0;
+    size_t deadRows = 0;
+    uint64_t version = 0;
+    std::vector<ChangeListener> listeners;
+
+public:
+    // Probes all image headers in parallel and reads all sidecars in one
+    // batched pass (io_uring where available)
+    void Build(const std::vector<std::string>& files, ThreadPool& pool = ThreadPool::Shared(),
+               ReadBackend backend = BatchFileReader::DefaultBackend()) {
+        imagePaths = files;
+        size_t imageCount = files.size();
+        imageWidths.assign(imageCount, 0);
+        imageHeights.assign(imageCount, 0);
+        boxBegin.assign(imageCount, 0);
+        boxCount.assign(imageCount, 0);
+
+        std::vector<std::vector<BoxRecord>> perImage(imageCount);
+        pool.ParallelFor(0, imageCount, [&](size_t begin, size_t end, size_t) {
+            for (size_t i = begin; i < end; i++) {
+                ProbeImageSize(imagePaths[i], imageWidths[i], imageHeights[i]);
+            }
+        }, 16);
+
+        // Most images of a fresh dataset have no sidecar; those reads fail
+        // with ENOENT and leave the image without boxes
+        std::vector<std::string> csvPaths(imageCount);
+        for (size_t i = 0; i < imageCount; i++) {
+            csvPaths[i] = CsvPathForImage(imagePaths[i]);
+        }
+        BatchFileReader reader(backend, 64, pool);
+        reader.ReadAll(csvPaths, 0, [&](size_t i, const char* data, size_t size, int error) {
+            if (error == 0) ParseBoxCsvText(data, size, perImage[i]);
+        });
+
+        size_t total = 0;
+        for (size_t i = 0; i < imageCount; i++) {
+            boxBegin[i] = (uint32_t)total;
+            boxCount[i] = (uint32_t)perImage[i].size();
+            total += perImage[i].size();
+        }
+
+        xmin.resize(total);
+        ymin.resize(total);
+        xmax.resize(total);
+        ymax.resize(total);
+        classIds.resize(total);
+        angles.resize(total);
+        imageIds.resize(total);
+        pool.ParallelFor(0, imageCount, [&](size_t begin, size_t end, size_t) {
+            for (size_t i = begin; i < end; i++) {
+                WriteRows(boxBegin[i], (uint32_t)i, perImage[i]);
+            }
+        }, 256);
+
+        // Images are visited in id order, so every posting list is built sorted by appending
+        classBoxCounts.clear();
+        classImages.clear();
+        classCursor.clear();
+        for (size_t i = 0; i < imageCount; i++) {
+            UpdateClassCounts((uint32_t)i, {}, perImage[i]);
+        }
+
+        liveRows = total;
+        deadRows = 0;
+        version++;
+
+        const BatchFileReader::Stats& readStats = reader.LastStats();
+        std::cout << "Annotation index built: " << imageCount << " images, " << total << " boxes ("
+                  << readStats.files - readStats.failed << " sidecars read with "
+                  << (reader.LastBackend() == ReadBackend::IoUring ? "io_uring" : "the thread pool") << ")" << std::endl;
+    }
+
+    void Clear() {
+        Build({});
+    }
+
+    size_t ImageCount() const { return imagePaths.size(); }
+    size_t BoxCount() const { return liveRows; }
+    // Number of rows in the columns, including dead rows
+    size_t RowCount() const { return imageIds.size(); }
+    uint64_t Version() const { return version; }
+
+    const std::vector<std::string>& ImagePaths() const { return imagePaths; }
+    int ImageWidth(uint32_t imageId) const { return imageWidths[imageId]; }
+    int ImageHeight(uint32_t imageId) const { return imageHeights[imageId]; }
+    uint32_t ImageBoxCount(uint32_t imageId) const { return boxCount[imageId]; }
+    uint32_t ImageBoxBegin(uint32_t imageId) const { return boxBegin[imageId]; }
+
+    const std::vector<float>& XMin() const { return xmin; }
+    const std::vector<float>& YMin() const { return ymin; }
+    const std::vector<float>& XMax() const { return xmax; }
+    const std::vector<float>& YMax() const { return ymax; }
+    const std::vector<uint16_t>& ClassIds() const { return classIds; }
+    const std::vector<float>& Angles() const { return angles; }
+    const std::vector<uint32_t>& ImageIds() const { return imageIds; }
+
+    // Highest class id in the index + 1 (it may be larger than the class table)
+    size_t ClassCount() const { return classBoxCounts.size(); }
+    uint32_t ClassBoxCount(uint16_t classId) const {
+        return classId < classBoxCounts.size() ? classBoxCounts[classId] : 0;
+    }
+    uint32_t ClassImageCount(uint16_t classId) const {
+        return classId < classImages.size() ? (uint32_t)classImages[classId].size() : 0;
+    }
+
+    // Sorted ids of the images that contain at least one box of the class
+    const std::vector<uint32_t>& ImagesWithClass(uint16_t classId) const {
+        static const std::vector<uint32_t> none;
+        return classId < classImages.size() ? classImages[classId] : none;
+    }
+
+    // The closest image after (or before) fromImage that contains the class,
+    // or -1. Stepping on from the previous result is O(1) through a per-class
+    // cursor; a jump from anywhere else costs one binary search.
+    int NextImageWithClass(uint16_t classId, uint32_t fromImage, bool forward = true) const {
+        if (classId >= classImages.size()) return -1;
+        const std::vector<uint32_t>& images = classImages[classId];
+        size_t& cursor = classCursor[classId];
+        size_t position;
+        if (cursor < images.size() && images[cursor] == fromImage) {
+            position = forward ? cursor + 1 : cursor - 1;  // wraps past the front to an invalid position
+        } else if (forward) {
+            position = (size_t)(std::upper_bound(images.begin(), images.end(), fromImage) - images.begin());
+        } else {
+            position = (size_t)(std::lower_bound(images.begin(), images.end(), fromImage) - images.begin()) - 1;
+        }
+        if (position >= images.size()) return -1;
+        cursor = position;
+        return (int)images[position];
+    }
+
+    std::vector<BoxRecord> GetBoxes(uint32_t imageId) const {
+        std::vector<BoxRecord> boxes;
+        if (imageId >= imagePaths.size()) return boxes;
+        uint32_t begin = boxBegin[imageId];
+        boxes.reserve(boxCount[imageId]);
+        for (uint32_t row = begin; row < begin + boxCount[imageId]; row++) {
+            boxes.push_back({xmin[row], ymin[row], xmax[row], ymax[row], classIds[row], angles[row]});
+        }
+        return boxes;
+    }
+
+    void SetBoxes(uint32_t imageId, const std::vector<BoxRecord>& boxes) {
+        if (imageId >= imagePaths.size()) return;
+
+        std::vector<BoxRecord> removed = GetBoxes(imageId);
+        uint32_t oldCount = boxCount[imageId];
+
+        if (boxes.size() == oldCount) {
+            WriteRows(boxBegin[imageId], imageId, boxes);
+        } else {
+            // Retire the old range and append the new one at the end of the columns
+            for (uint32_t row = boxBegin[imageId]; row < boxBegin[imageId] + oldCount; row++) {
+                imageIds[row] = kDeadRow;
+            }
+            deadRows += oldCount;
+            liveRows = liveRows - oldCount + boxes.size();
+
+            size_t newBegin = imageIds.size();
+            xmin.resize(newBegin + boxes.size());
+            ymin.resize(newBegin + boxes.size());
+            xmax.resize(newBegin + boxes.size());
+            ymax.resize(newBegin + boxes.size());
+            classIds.resize(newBegin + boxes.size());
+            angles.resize(newBegin + boxes.size());
+            imageIds.resize(newBegin + boxes.size());
+            boxBegin[imageId] = (uint32_t)newBegin;
+            boxCount[imageId] = (uint32_t)boxes.size();
+            WriteRows((uint32_t)newBegin, imageId, boxes);
+
+            if (deadRows > 1024 && deadRows > liveRows) {
+                Compact();
+            }
+        }
+        UpdateClassCounts(imageId, removed, boxes);
+        version++;
+
+        for (const auto& listener : listeners) {
+            listener(imageId, removed, boxes);
+        }
+    }
+
+    // Replaces one box of an image, or appends it if the image has no box at
+    // that position; the image's other boxes are kept
+    void SetBox(uint32_t imageId, uint32_t position, const BoxRecord& box) {
+        if (imageId >= imagePaths.size()) return;
+        std::vector<BoxRecord> boxes = GetBoxes(imageId);
+        if (position < boxes.size()) {
+            boxes[position] = box;
+        } else {
+            boxes.push_back(box);
+        }
+        SetBoxes(imageId, boxes);
+    }
+
+    // Writes every box of an image to its sidecar
+    bool SaveSidecar(uint32_t imageId) const {
+        if (imageId >= imagePaths.size()) return false;
+        return WriteSidecar(CsvPathForImage(imagePaths[imageId]), GetBoxes(imageId));
+    }
+
+    // Re-reads one image's sidecar from disk into the index
+    void ReloadSidecar(uint32_t imageId) {
+        if (imageId >= imagePaths.size()) return;
+        std::vector<BoxRecord> boxes;
+        ParseBoxCsv(CsvPathForImage(imagePaths[imageId]), boxes);
+        SetBoxes(imageId, boxes);
+    }
+
+    void AddChangeListener(ChangeListener listener) {
+        listeners.push_back(std::move(listener));
+    }
+
+    // Drops dead rows, keeping each image's rows contiguous and in image order
+    void Compact() {
+        std::vector<float> newXMin, newYMin, newXMax, newYMax;
+        std::vector<uint16_t> newClassIds;
+        std::vector<float> newAngles;
+        std::vector<uint32_t> newImageIds;
+        newXMin.reserve(liveRows);
+        newYMin.reserve(liveRows);
+        newXMax.reserve(liveRows);
+        newYMax.reserve(liveRows);
+        newClassIds.reserve(liveRows);
+        newAngles.reserve(liveRows);
+        newImageIds.reserve(liveRows);
+
+        for (uint32_t image = 0; image < imagePaths.size(); image++) {
+            uint32_t begin = boxBegin[image];
+            boxBegin[image] = (uint32_t)newImageIds.size();
+            for (uint32_t row = begin; row < begin + boxCount[image]; row++) {
+                newXMin.push_back(xmin[row]);
+                newYMin.push_back(ymin[row]);
+                newXMax.push_back(xmax[row]);
+                newYMax.push_back(ymax[row]);
+                newClassIds.push_back(classIds[row]);
+                newAngles.push_back(angles[row]);
+                newImageIds.push_back(image);
+            }
+        }
+
+        xmin.swap(newXMin);
+        ymin.swap(newYMin);
+        xmax.swap(newXMax);
+        ymax.swap(newYMax);
+        classIds.swap(newClassIds);
+        angles.swap(newAngles);
+        imageIds.swap(newImageIds);
+        deadRows = 0;
+    }
+
+private:
+    void WriteRows(uint32_t firstRow, uint32_t imageId, const std::vector<BoxRecord>& boxes) {
+        for (size_t i = 0; i < boxes.size(); i++) {
+            size_t row = firstRow + i;
+            xmin[row] = boxes[i].xmin;
+            ymin[row] = boxes[i].ymin;
+            xmax[row] = boxes[i].xmax;
+            ymax[row] = boxes[i].ymax;
+            classIds[row] = boxes[i].classId;
+            angles[row] = boxes[i].angle;
+            imageIds[row] = imageId;
+        }
+    }
+
+    // Moves one image's contribution to the class counts and the inverted
+    // index from removed to added
+    void UpdateClassCounts(uint32_t imageId, const std::vector<BoxRecord>& removed, const std::vector<BoxRecord>& added) {
+        std::vector<uint16_t> before = DistinctClasses(removed);
+        std::vector<uint16_t> after = DistinctClasses(added);
+        if (!after.empty() && after.back() >= classBoxCounts.size()) {
+            classBoxCounts.resize((size_t)after.back() + 1, 0);
+            classImages.resize((size_t)after.back() + 1);
+            classCursor.resize((size_t)after.back() + 1, 0);
+        }
+        for (const BoxRecord& box : removed) classBoxCounts[box.classId]--;
+        for (const BoxRecord& box : added) classBoxCounts[box.classId]++;
+        for (uint16_t classId : before) {
+            if (std::binary_search(after.begin(), after.end(), classId)) continue;
+            std::vector<uint32_t>& images = classImages[classId];
+            auto it = std::lower_bound(images.begin(), images.end(), imageId);
+            if (it != images.end() && *it == imageId) images.erase(it);
+        }
+        for (uint16_t classId : after) {
+            if (std::binary_search(before.begin(), before.end(), classId)) continue;
+            std::vector<uint32_t>& images = classImages[classId];
+            // Appending is the common case: Build and edits at the end of the list
+            if (images.empty() || images.back() < imageId) {
+                images.push_back(imageId);
+            } else {
+                images.insert(std::lower_bound(images.begin(), images.end(), imageId), imageId);
+            }
+        }
+    }
+
+    static std::vector<uint16_t> DistinctClasses(const std::vector<BoxRecord>& boxes) {
+        std::vector<uint16_t> classes;
+        classes.reserve(boxes.size());
+        for (const BoxRecord& box : boxes) classes.push_back(box.classId);
+        std::sort(classes.begin(), classes.end());
+        classes.erase(std::unique(classes.begin(), classes.end()), classes.end());
+        return classes;
+    }
+};
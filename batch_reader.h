@@ -0,0 +1,503 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#include "thread_pool.h"
+
+// Openat, statx and the opcode probe arrived together in Linux 5.6, the same
+// release that added IORING_FEAT_CUR_PERSONALITY
+#if defined(__NR_io_uring_setup) && defined(IORING_FEAT_CUR_PERSONALITY)
+#define J_BBOX_HAVE_IO_URING 1
+#endif
+
+#if defined(J_BBOX_HAVE_IO_URING)
+
+// Minimal io_uring over the raw system calls (no liburing dependency): one
+// submission and one completion ring, used from a single thread.
+class IoUring {
+private:
+    int ringFd = -1;
+    void* sqRing = MAP_FAILED;
+    void* cqRing = MAP_FAILED;
+    size_t sqRingSize = 0;
+    size_t cqRingSize = 0;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t sqesSize = 0;
+
+    unsigned* sqHead = nullptr;
+    unsigned* sqTail = nullptr;
+    unsigned sqMask = 0;
+    unsigned sqEntries = 0;
+    unsigned* sqArray = nullptr;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned cqMask = 0;
+    io_uring_cqe* cqes = nullptr;
+
+    unsigned unsubmitted = 0;
+    uint64_t queued = 0;
+
+public:
+    IoUring() = default;
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    ~IoUring() {
+        if (sqes != MAP_FAILED) munmap(sqes, sqesSize);
+        if (cqRing != MAP_FAILED && cqRing != sqRing) munmap(cqRing, cqRingSize);
+        if (sqRing != MAP_FAILED) munmap(sqRing, sqRingSize);
+        if (ringFd >= 0) close(ringFd);
+    }
+
+    // Fails on kernels without io_uring, when it is disabled (seccomp,
+    // io_uring_disabled sysctl) or when an operation the reader needs is missing
+    bool Init(unsigned entries) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        ringFd = (int)syscall(__NR_io_uring_setup, entries, &params);
+        if (ringFd < 0) return false;
+
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (singleMmap) sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+
+        sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+        if (sqRing == MAP_FAILED) return false;
+        cqRing = singleMmap ? sqRing
+                            : mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED) return false;
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe*>(
+            mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES));
+        if (sqes == MAP_FAILED) return false;
+
+        char* sq = static_cast<char*>(sqRing);
+        sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqEntries = params.sq_entries;
+        sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        char* cq = static_cast<char*>(cqRing);
+        cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+        return Supports({IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ, IORING_OP_CLOSE});
+    }
+
+    // Next free submission entry, zeroed, or nullptr if the ring is full
+    io_uring_sqe* NextSqe() {
+        unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+        unsigned tail = *sqTail;
+        if (tail - head >= sqEntries) return nullptr;
+        unsigned index = tail & sqMask;
+        io_uring_sqe* sqe = &sqes[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqArray[index] = index;
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+        unsubmitted++;
+        queued++;
+        return sqe;
+    }
+
+    // Entries the kernel has taken so far; entry n (0-based, in NextSqe()
+    // order) has been submitted once this exceeds n
+    uint64_t Taken() const { return queued - unsubmitted; }
+    // Number the next NextSqe() entry will have
+    uint64_t Queued() const { return queued; }
+
+    // Submits queued entries and waits for at least waitFor completions
+    bool Submit(unsigned waitFor) {
+        while (true) {
+            int result = (int)syscall(__NR_io_uring_enter, ringFd, unsubmitted, waitFor,
+                                      waitFor > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+            if (result >= 0) {
+                unsubmitted -= std::min<unsigned>(unsubmitted, (unsigned)result);
+                return true;
+            }
+            if (errno != EINTR) return false;
+        }
+    }
+
+    // Calls fn(userData, result) for every available completion
+    template <typename Fn>
+    unsigned DrainCompletions(Fn&& fn) {
+        unsigned head = *cqHead;
+        unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        unsigned count = 0;
+        for (; head != tail; head++, count++) {
+            const io_uring_cqe& cqe = cqes[head & cqMask];
+            fn(cqe.user_data, cqe.res);
+        }
+        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+        return count;
+    }
+
+private:
+    bool Supports(std::initializer_list<int> ops) {
+        size_t size = sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+        io_uring_probe* probe = static_cast<io_uring_probe*>(std::calloc(1, size));
+        bool supported = probe != nullptr && syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_PROBE, probe, 256) == 0;
+        for (int op : ops) {
+            supported = supported && op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+        }
+        std::free(probe);
+        return supported;
+    }
+};
+
+#endif
+
+enum class ReadBackend {
+    Auto,        // io_uring when the kernel allows it, otherwise the thread pool
+    IoUring,
+    ThreadPool
+};
+
+inline const char* ReadBackendName(ReadBackend backend) {
+    switch (backend) {
+        case ReadBackend::Auto: return "auto";
+        case ReadBackend::IoUring: return "uring";
+        case ReadBackend::ThreadPool: return "threads";
+        default: return "unknown";
+    }
+}
+
+inline bool ParseReadBackend(const std::string& name, ReadBackend& backend) {
+    for (ReadBackend candidate : {ReadBackend::Auto, ReadBackend::IoUring, ReadBackend::ThreadPool}) {
+        if (name == ReadBackendName(candidate)) {
+            backend = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Reads many small files (sidecars, header prefixes) for bulk dataset passes.
+//
+// With io_uring, every file's openat and statx are submitted together in
+// batches, followed by one read of the whole file (or its first maxBytes) and
+// a close, so a scan costs a handful of io_uring_enter calls per batch instead
+// of four syscalls per file. At most `depth` files are in flight, which bounds
+// both ring size and buffer memory. The thread-pool backend does the same work
+// with plain blocking syscalls on the worker threads.
+class BatchFileReader {
+public:
+    // error is 0 or an errno value; data is only valid during the call. With
+    // the thread-pool backend the callback runs concurrently on workers.
+    using FileCallback = std::function<void(size_t index, const char* data, size_t size, int error)>;
+
+    struct Stats {
+        size_t files = 0;
+        size_t failed = 0;
+        uint64_t bytes = 0;
+        uint64_t submitCalls = 0;  // io_uring_enter calls (io_uring backend only)
+    };
+
+private:
+    ReadBackend preferred;
+    size_t depth;
+    ThreadPool& pool;
+    Stats stats;
+    ReadBackend lastBackend = ReadBackend::ThreadPool;
+
+public:
+    // Backend used when none is given (set from --io at startup)
+    static ReadBackend& DefaultBackend() {
+        static ReadBackend backend = ReadBackend::Auto;
+        return backend;
+    }
+
+    explicit BatchFileReader(ReadBackend backend = DefaultBackend(), size_t maxInFlight = 64,
+                             ThreadPool& threadPool = ThreadPool::Shared())
+        : preferred(backend), depth(std::min<size_t>(std::max<size_t>(maxInFlight, 1), 2048)), pool(threadPool) {}
+
+    // Reads every path (at most maxBytes of each; 0 reads whole files)
+    void ReadAll(const std::vector<std::string>& paths, size_t maxBytes, const FileCallback& callback) {
+        stats = Stats();
+#if defined(J_BBOX_HAVE_IO_URING)
+        if (preferred != ReadBackend::ThreadPool && ReadWithIoUring(paths, maxBytes, callback)) {
+            lastBackend = ReadBackend::IoUring;
+            return;
+        }
+        if (preferred == ReadBackend::IoUring) {
+            std::cerr << "io_uring is unavailable, reading with the thread pool" << std::endl;
+        }
+#endif
+        lastBackend = ReadBackend::ThreadPool;
+        ReadWithThreadPool(paths, maxBytes, callback);
+    }
+
+    const Stats& LastStats() const { return stats; }
+    ReadBackend LastBackend() const { return lastBackend; }
+
+private:
+    void ReadWithThreadPool(const std::vector<std::string>& paths, size_t maxBytes, const FileCallback& callback) {
+        std::atomic<size_t> failed{0};
+        std::atomic<uint64_t> bytes{0};
+        pool.ParallelFor(0, paths.size(), [&](size_t begin, size_t end, size_t) {
+            std::vector<char> buffer;
+            for (size_t i = begin; i < end; i++) {
+                int error = ReadFile(paths[i], maxBytes, buffer);
+                if (error != 0) failed++;
+                bytes += buffer.size();
+                callback(i, buffer.data(), buffer.size(), error);
+            }
+        }, 64);
+        stats.files = paths.size();
+        stats.failed = failed.load();
+        stats.bytes = bytes.load();
+    }
+
+    static int ReadFile(const std::string& path, size_t maxBytes, std::vector<char>& buffer) {
+        buffer.clear();
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return errno;
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            int error = errno;
+            close(fd);
+            return error;
+        }
+        size_t size = (size_t)std::max<off_t>(info.st_size, 0);
+        if (maxBytes > 0) size = std::min(size, maxBytes);
+        buffer.resize(size);
+        size_t done = 0;
+        int error = 0;
+        while (done < size) {
+            ssize_t count = pread(fd, buffer.data() + done, size - done, (off_t)done);
+            if (count < 0 && errno == EINTR) continue;
+            if (count < 0) error = errno;
+            if (count <= 0) break;
+            done += (size_t)count;
+        }
+        buffer.resize(done);
+        close(fd);
+        return error;
+    }
+
+#if defined(J_BBOX_HAVE_IO_URING)
+    struct Slot {
+        size_t index = 0;
+        int fd = -1;
+        int pending = 0;  // operations in flight
+        int error = 0;
+        bool opened = false;
+        bool statted = false;
+        bool finished = false;
+        struct statx info;
+        std::vector<char> buffer;
+        size_t wanted = 0;
+        size_t done = 0;
+    };
+
+    enum Op : uint64_t { OpOpen = 0, OpStatx = 1, OpRead = 2, OpClose = 3 };
+
+    bool ReadWithIoUring(const std::vector<std::string>& paths, size_t maxBytes, const FileCallback& callback) {
+        IoUring ring;
+        if (!ring.Init((unsigned)std::min<size_t>(depth * 2, 4096))) return false;
+
+        std::vector<Slot> slots(depth);
+        std::vector<size_t> freeSlots;
+        for (size_t i = depth; i > 0; i--) {
+            freeSlots.push_back(i - 1);
+        }
+        size_t next = 0;
+        size_t active = 0;
+        // Closes queued but not yet taken by the kernel: entry number and descriptor
+        std::deque<std::pair<uint64_t, int>> unsubmittedCloses;
+
+        auto userData = [](size_t slot, Op op) { return (uint64_t)slot << 2 | op; };
+
+        auto finish = [&](Slot& slot) {
+            slot.finished = true;
+            stats.files++;
+            if (slot.error != 0) stats.failed++;
+            stats.bytes += slot.done;
+            callback(slot.index, slot.buffer.data(), slot.done, slot.error);
+        };
+
+        // Queues the next read of a file, or its close once everything was read
+        auto continueFile = [&](size_t slotIndex) {
+            Slot& slot = slots[slotIndex];
+            if (slot.error == 0 && slot.done < slot.wanted) {
+                io_uring_sqe* sqe = ring.NextSqe();
+                sqe->opcode = IORING_OP_READ;
+                sqe->fd = slot.fd;
+                sqe->addr = (uint64_t)(uintptr_t)(slot.buffer.data() + slot.done);
+                sqe->len = (uint32_t)std::min<size_t>(slot.wanted - slot.done, 1u << 30);
+                sqe->off = slot.done;
+                sqe->user_data = userData(slotIndex, OpRead);
+                slot.pending++;
+                return;
+            }
+            finish(slot);
+            if (slot.fd >= 0) {
+                uint64_t entry = ring.Queued();
+                io_uring_sqe* sqe = ring.NextSqe();
+                sqe->opcode = IORING_OP_CLOSE;
+                sqe->fd = slot.fd;
+                sqe->user_data = userData(slotIndex, OpClose);
+                slot.pending++;
+                unsubmittedCloses.emplace_back(entry, slot.fd);
+                slot.fd = -1;
+            }
+        };
+
+        bool ok = true;
+        int submitError = 0;
+        while (ok && (next < paths.size() || active > 0)) {
+            // Start open + statx for as many files as there are free slots
+            while (next < paths.size() && !freeSlots.empty()) {
+                size_t slotIndex = freeSlots.back();
+                freeSlots.pop_back();
+                Slot& slot = slots[slotIndex];
+                slot.index = next;
+                slot.fd = -1;
+                slot.error = 0;
+                slot.opened = slot.statted = slot.finished = false;
+                slot.buffer.clear();
+                slot.wanted = slot.done = 0;
+                const char* path = paths[next].c_str();
+
+                io_uring_sqe* open = ring.NextSqe();
+                open->opcode = IORING_OP_OPENAT;
+                open->fd = AT_FDCWD;
+                open->addr = (uint64_t)(uintptr_t)path;
+                open->open_flags = O_RDONLY | O_CLOEXEC;
+                open->user_data = userData(slotIndex, OpOpen);
+
+                io_uring_sqe* stat = ring.NextSqe();
+                stat->opcode = IORING_OP_STATX;
+                stat->fd = AT_FDCWD;
+                stat->addr = (uint64_t)(uintptr_t)path;
+                stat->len = STATX_SIZE;
+                stat->off = (uint64_t)(uintptr_t)&slot.info;
+                stat->user_data = userData(slotIndex, OpStatx);
+
+                slot.pending = 2;
+                active++;
+                next++;
+            }
+
+            stats.submitCalls++;
+            if (!ring.Submit(1)) {
+                submitError = errno;
+                ok = false;
+                break;
+            }
+            while (!unsubmittedCloses.empty() && unsubmittedCloses.front().first < ring.Taken()) {
+                unsubmittedCloses.pop_front();
+            }
+
+            ring.DrainCompletions([&](uint64_t data, int result) {
+                size_t slotIndex = (size_t)(data >> 2);
+                Slot& slot = slots[slotIndex];
+                slot.pending--;
+                switch ((Op)(data & 3)) {
+                    case OpOpen:
+                        if (result >= 0) {
+                            slot.fd = result;
+                        } else if (slot.error == 0) {
+                            slot.error = -result;
+                        }
+                        slot.opened = true;
+                        break;
+                    case OpStatx:
+                        if (result < 0 && slot.error == 0) slot.error = -result;
+                        slot.statted = true;
+                        break;
+                    case OpRead:
+                        if (result < 0) {
+                            slot.error = -result;
+                        } else if (result == 0) {
+                            slot.wanted = slot.done;  // file shrank since statx
+                        } else {
+                            slot.done += (size_t)result;
+                        }
+                        continueFile(slotIndex);
+                        break;
+                    case OpClose:
+                        break;
+                }
+
+                // Both open and statx are back: size the buffer and start reading
+                if ((data & 3) <= OpStatx && slot.opened && slot.statted && slot.pending == 0) {
+                    if (slot.error == 0) {
+                        slot.wanted = (size_t)slot.info.stx_size;
+                        if (maxBytes > 0) slot.wanted = std::min(slot.wanted, maxBytes);
+                        slot.buffer.resize(slot.wanted);
+                    }
+                    continueFile(slotIndex);
+                }
+
+                if (slot.pending == 0 && slot.fd < 0 && slot.opened && slot.statted) {
+                    freeSlots.push_back(slotIndex);
+                    active--;
+                }
+            });
+        }
+
+        if (!ok) {
+            // The ring is unusable. Files whose open already completed are
+            // closed here, then the files still in flight and the ones never
+            // started are finished with blocking reads.
+            std::cerr << "io_uring submission failed: " << std::strerror(submitError) << std::endl;
+            ring.DrainCompletions([&](uint64_t data, int result) {
+                if ((data & 3) == OpOpen && result >= 0) slots[(size_t)(data >> 2)].fd = result;
+            });
+            for (Slot& slot : slots) {
+                if (slot.fd >= 0) close(slot.fd);
+                slot.fd = -1;
+            }
+            for (const auto& pending : unsubmittedCloses) {
+                close(pending.second);
+            }
+            std::vector<size_t> unfinished;
+            std::vector<bool> idle(slots.size(), false);
+            for (size_t slotIndex : freeSlots) {
+                idle[slotIndex] = true;
+            }
+            for (size_t slotIndex = 0; slotIndex < slots.size(); slotIndex++) {
+                if (!idle[slotIndex] && !slots[slotIndex].finished) unfinished.push_back(slots[slotIndex].index);
+            }
+            for (size_t i = next; i < paths.size(); i++) {
+                unfinished.push_back(i);
+            }
+            std::vector<char> buffer;
+            for (size_t index : unfinished) {
+                int error = ReadFile(paths[index], maxBytes, buffer);
+                stats.files++;
+                if (error != 0) stats.failed++;
+                stats.bytes += buffer.size();
+                callback(index, buffer.data(), buffer.size(), error);
+            }
+        }
+        return true;
+    }
+#endif
+};
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "annotation_index.h"
+
+// Names of the annotation classes, read from a classes file with one name per
+// line (the classes.txt / obj.names convention of YOLO tooling): line N names
+// class id N. Sidecars store only the id, so the table can be renamed or
+// extended without touching them. Ids past the end of the table are still
+// valid and shown as "class N".
+class ClassTable {
+private:
+    std::vector<std::string> names;
+    std::string sourcePath;
+    uint64_t revision = 0;
+
+    // Revisions are unique across tables, so a copied table never shares a
+    // revision with different names
+    void Touch() {
+        static std::atomic<uint64_t> counter{0};
+        revision = ++counter;
+    }
+
+public:
+    // Replaces the table with the names in path. Returns false (leaving the
+    // table empty) if the file cannot be opened or has too many lines.
+    bool Load(const std::string& path) {
+        names.clear();
+        sourcePath.clear();
+        Touch();
+        std::ifstream file(path);
+        if (!file.is_open()) return false;
+
+        std::string line;
+        while (std::getline(file, line)) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            size_t begin = line.find_first_not_of(" \t");
+            size_t end = line.find_last_not_of(" \t");
+            names.push_back(begin == std::string::npos ? std::string() : line.substr(begin, end - begin + 1));
+        }
+        // Trailing blank lines do not define classes
+        while (!names.empty() && names.back().empty()) names.pop_back();
+        if (names.size() > (size_t)kMaxClassId + 1) {
+            std::cerr << "Class file has more than " << kMaxClassId + 1 << " classes: " << path << std::endl;
+            names.clear();
+            return false;
+        }
+        sourcePath = path;
+        std::cout << "Loaded " << names.size() << " classes from " << path << std::endl;
+        return true;
+    }
+
+    // The classes file conventionally kept next to the images, or empty
+    static std::string FindForDirectory(const std::string& directory) {
+        for (const char* name : {"classes.txt", "obj.names", "classes.names"}) {
+            std::filesystem::path candidate = std::filesystem::path(directory) / name;
+            std::error_code error;
+            if (std::filesystem::is_regular_file(candidate, error)) return candidate.string();
+        }
+        return std::string();
+    }
+
+    void Clear() {
+        names.clear();
+        sourcePath.clear();
+        Touch();
+    }
+
+    size_t Count() const { return names.size(); }
+    bool Empty() const { return names.empty(); }
+    const std::string& SourcePath() const { return sourcePath; }
+    // Changes whenever the names change, for caches of drawn labels
+    uint64_t Revision() const { return revision; }
+
+    std::string Name(uint16_t classId) const {
+        if (classId < names.size() && !names[classId].empty()) return names[classId];
+        return "class " + std::to_string(classId);
+    }
+
+    // Class id for a name, or -1
+    int Find(const std::string& name) const {
+        auto it = std::find(names.begin(), names.end(), name);
+        return it != names.end() ? (int)(it - names.begin()) : -1;
+    }
+
+    // Class id for a name, appending it to the table if it is new; -1 if the table is full
+    int FindOrAdd(const std::string& name) {
+        int classId = Find(name);
+        if (classId >= 0) return classId;
+        if (names.size() > (size_t)kMaxClassId) return -1;
+        names.push_back(name);
+        Touch();
+        return (int)names.size() - 1;
+    }
+
+    bool Save(const std::string& path) const {
+        std::ofstream file(path);
+        if (!file.is_open()) {
+            std::cerr << "Failed to write class file: " << path << std::endl;
+            return false;
+        }
+        for (const std::string& name : names) {
+            file << name << std::endl;
+        }
+        return true;
+    }
+};
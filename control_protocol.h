@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cmath>
+#include <cstdlib>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "annotation_index.h"
+
+// Box lists of the control protocol: "<n>" followed by n boxes of
+// xmin ymin xmax ymax class_id angle, coordinates in image pixels and the
+// angle in degrees (0 for axis-aligned boxes), all separated by spaces.
+// get-boxes replies, set-boxes arguments and "event box" lines share the
+// format. set-boxes also takes boxes of four values (class 0, axis-aligned)
+// or five (axis-aligned); the number of values per box follows from the total.
+constexpr size_t kControlBoxFields = 6;
+
+inline void FormatControlBoxes(std::ostream& out, const std::vector<BoxRecord>& boxes) {
+    out << boxes.size();
+    for (const BoxRecord& box : boxes) {
+        out << " " << box.xmin << " " << box.ymin << " " << box.xmax << " " << box.ymax << " " << box.classId << " " << box.angle;
+    }
+}
+
+// Parses a box list. The count comes from the client, so it is checked
+// against the values actually present before anything is allocated. Returns
+// false with a message for the "error ..." reply.
+inline bool ParseControlBoxes(const std::string& text, std::vector<BoxRecord>& boxes, std::string& error) {
+    boxes.clear();
+    std::istringstream input(text);
+    std::vector<std::string> words;
+    std::string word;
+    while (input >> word) words.push_back(word);
+
+    char* end = nullptr;
+    unsigned long long count = words.empty() || words[0][0] == '-' ? 0 : std::strtoull(words[0].c_str(), &end, 10);
+    if (end == nullptr || *end != '\0') {
+        error = "missing box count";
+        return false;
+    }
+    size_t values = words.size() - 1;
+    size_t fields = count > 0 && values % count == 0 ? values / count : 0;
+    if (count == 0 ? values != 0 : fields < 4 || fields > kControlBoxFields) {
+        error = "expected xmin ymin xmax ymax [class_id [angle]] for " + words[0] + " boxes, got " + std::to_string(values) + " values";
+        return false;
+    }
+
+    boxes.resize(count);
+    for (size_t i = 0; i < values; i++) {
+        const char* begin = words[i + 1].c_str();
+        BoxRecord& box = boxes[i / fields];
+        size_t field = i % fields;
+        if (field == 4) {
+            long classId = std::strtol(begin, &end, 10);
+            if (end == begin || *end != '\0' || classId < 0 || classId > kMaxClassId) {
+                error = "invalid class id: " + words[i + 1];
+                boxes.clear();
+                return false;
+            }
+            box.classId = (uint16_t)classId;
+            continue;
+        }
+        float value = std::strtof(begin, &end);
+        if (end == begin || *end != '\0' || !std::isfinite(value)) {
+            error = (field == 5 ? "invalid angle: " : "invalid coordinate: ") + words[i + 1];
+            boxes.clear();
+            return false;
+        }
+        if (field == 5) {
+            box.angle = NormalizeAngle(value);
+            continue;
+        }
+        (field == 0 ? box.xmin : field == 1 ? box.ymin : field == 2 ? box.xmax : box.ymax) = value;
+    }
+    return true;
+}
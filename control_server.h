@@ -0,0 +1,254 @@
+#pragma once
+
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Line-oriented control socket for pipeline integration.
+//
+// Clients connect to a Unix domain socket and send one command per line; each
+// command gets exactly one reply line starting with "ok" or "error".
+// Subscribed clients additionally receive asynchronous "event ..." lines.
+// All socket I/O is non-blocking: Poll() is called once per frame from the
+// main loop, accepts pending connections, reads whatever is available,
+// dispatches complete lines to the handler and flushes queued output.
+class ControlServer {
+public:
+    // Returns the reply line (without newline). Setting subscribe to true
+    // registers the calling client for events. An empty reply means the
+    // command is still running: the line is dispatched again on the next
+    // Poll(), and the client's later lines wait behind it.
+    using CommandHandler = std::function<std::string(const std::string& line, bool& subscribe)>;
+
+private:
+    struct Client {
+        int fd = -1;
+        std::string input;
+        std::string output;
+        bool subscribed = false;
+        bool closing = false;
+    };
+
+    int listenFd = -1;
+    std::string socketPath;
+    std::vector<Client> clients;
+    static constexpr size_t kMaxLineLength = 1 << 20;
+    static constexpr size_t kMaxQueuedOutput = 8 << 20;
+
+public:
+    ControlServer() = default;
+    ControlServer(const ControlServer&) = delete;
+    ControlServer& operator=(const ControlServer&) = delete;
+
+    ~ControlServer() {
+        Stop();
+    }
+
+    bool Start(const std::string& path) {
+        sockaddr_un address{};
+        if (path.size() >= sizeof(address.sun_path)) {
+            std::cerr << "Control socket path too long: " << path << std::endl;
+            return false;
+        }
+
+        address.sun_family = AF_UNIX;
+        std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+        if (!RemoveStaleSocket(path, address)) return false;
+
+        listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listenFd < 0) {
+            std::cerr << "Failed to create control socket: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+
+        // Only the owner may connect: any client can overwrite boxes or quit
+        // the viewer. The mode is set before listen(), so no connection can
+        // be accepted while the socket still has the umask's permissions.
+        bool bound = bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+        if (!bound || chmod(path.c_str(), S_IRUSR | S_IWUSR) < 0 || listen(listenFd, 8) < 0) {
+            std::cerr << "Failed to bind control socket " << path << ": " << std::strerror(errno) << std::endl;
+            close(listenFd);
+            if (bound) unlink(path.c_str());
+            listenFd = -1;
+            return false;
+        }
+
+        socketPath = path;
+        std::cout << "Control socket listening on: " << path << std::endl;
+        return true;
+    }
+
+    void Stop() {
+        for (auto& client : clients) {
+            close(client.fd);
+        }
+        clients.clear();
+        if (listenFd >= 0) {
+            close(listenFd);
+            unlink(socketPath.c_str());
+            listenFd = -1;
+        }
+    }
+
+    bool IsRunning() const { return listenFd >= 0; }
+
+    void Poll(const CommandHandler& handler) {
+        if (listenFd < 0) return;
+
+        AcceptClients();
+
+        for (size_t i = 0; i < clients.size(); i++) {
+            ReadClient(clients[i]);
+
+            // Dispatch complete lines, including ones that arrived just before the peer closed
+            size_t newline;
+            while ((newline = clients[i].input.find('\n')) != std::string::npos) {
+                std::string line = clients[i].input.substr(0, newline);
+                clients[i].input.erase(0, newline + 1);
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                if (line.empty()) continue;
+
+                bool subscribe = clients[i].subscribed;
+                std::string reply = handler(line, subscribe);
+                clients[i].subscribed = subscribe;
+                if (reply.empty()) {
+                    clients[i].input.insert(0, line + "\n");
+                    break;
+                }
+                Queue(clients[i], reply);
+            }
+            if (clients[i].input.size() > kMaxLineLength) {
+                Queue(clients[i], "error line too long");
+                clients[i].input.clear();
+                clients[i].closing = true;
+            }
+
+            FlushClient(clients[i]);
+        }
+
+        // Drop closed connections once their output is flushed
+        for (size_t i = 0; i < clients.size();) {
+            if (clients[i].closing && (clients[i].output.empty() || clients[i].fd < 0)) {
+                if (clients[i].fd >= 0) close(clients[i].fd);
+                clients.erase(clients.begin() + i);
+            } else {
+                i++;
+            }
+        }
+    }
+
+    // Sends an event line to every subscribed client
+    void Broadcast(const std::string& line) {
+        for (auto& client : clients) {
+            if (client.subscribed && !client.closing) {
+                Queue(client, line);
+                FlushClient(client);
+            }
+        }
+    }
+
+private:
+    // Removes a socket left by a previous run so bind can reuse the path. Any
+    // other file, and a socket another viewer is still listening on, is left
+    // alone and makes Start fail.
+    static bool RemoveStaleSocket(const std::string& path, const sockaddr_un& address) {
+        struct stat status;
+        if (lstat(path.c_str(), &status) < 0) {
+            if (errno == ENOENT) return true;
+            std::cerr << "Cannot use control socket path " << path << ": " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        if (!S_ISSOCK(status.st_mode)) {
+            std::cerr << "Control socket path exists and is not a socket: " << path << std::endl;
+            return false;
+        }
+
+        int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (probe < 0) {
+            std::cerr << "Failed to create control socket: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        bool live = connect(probe, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+        int connectError = errno;
+        close(probe);
+        if (live) {
+            std::cerr << "Control socket is in use by another process: " << path << std::endl;
+            return false;
+        }
+        if (connectError != ECONNREFUSED) {
+            std::cerr << "Cannot probe control socket " << path << ": " << std::strerror(connectError) << std::endl;
+            return false;
+        }
+        if (unlink(path.c_str()) < 0) {
+            std::cerr << "Failed to remove stale control socket " << path << ": " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    void AcceptClients() {
+        while (true) {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                    std::cerr << "Control socket accept failed: " << std::strerror(errno) << std::endl;
+                }
+                return;
+            }
+            Client client;
+            client.fd = fd;
+            clients.push_back(std::move(client));
+        }
+    }
+
+    void ReadClient(Client& client) {
+        char buffer[4096];
+        while (!client.closing) {
+            ssize_t n = recv(client.fd, buffer, sizeof(buffer), 0);
+            if (n > 0) {
+                client.input.append(buffer, n);
+                if (client.input.size() > kMaxLineLength) return;
+            } else if (n == 0) {
+                client.closing = true;  // peer closed; flush what is left
+            } else {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) client.closing = true;
+                return;
+            }
+        }
+    }
+
+    void Queue(Client& client, const std::string& line) {
+        // A client that stops reading must not grow our memory without bound
+        if (client.output.size() + line.size() > kMaxQueuedOutput) {
+            client.closing = true;
+            client.output.clear();
+            return;
+        }
+        client.output += line;
+        client.output += '\n';
+    }
+
+    void FlushClient(Client& client) {
+        while (!client.output.empty()) {
+            ssize_t n = send(client.fd, client.output.data(), client.output.size(), MSG_NOSIGNAL);
+            if (n > 0) {
+                client.output.erase(0, n);
+            } else {
+                if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                    client.closing = true;
+                    client.output.clear();
+                }
+                return;
+            }
+        }
+    }
+};
@@ -0,0 +1,312 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "annotation_index.h"
+#include "thread_pool.h"
+
+// Fixed-range histogram. Values outside [lower, upper) are clamped into the
+// first/last bin so that incremental add/remove stays exact.
+struct Histogram {
+    std::string name;
+    float lower = 0.0f;
+    float upper = 1.0f;
+    std::vector<int64_t> counts;
+
+    Histogram() = default;
+    Histogram(const std::string& histogramName, float lo, float hi, int bins)
+        : name(histogramName), lower(lo), upper(hi), counts(bins, 0) {}
+
+    int Bins() const { return (int)counts.size(); }
+    float BinWidth() const { return (upper - lower) / counts.size(); }
+
+    // Must produce exactly the same bin as ComputeBins for the same input
+    int Bin(float value) const {
+        float t = (value - lower) * (1.0f / BinWidth());
+        t = t > 0.0f ? t : 0.0f;  // also maps NaN to bin 0, like _mm_max_ps
+        float maxBin = (float)(counts.size() - 1);
+        t = t < maxBin ? t : maxBin;
+        return (int)t;
+    }
+};
+
+// Maps values to histogram bins four at a time. Entries whose mask is zero get
+// the sentinel bin `bins`, which callers allocate as a scratch slot and discard.
+inline void ComputeBins(const float* values, const uint8_t* mask, size_t count, const Histogram& histogram,
+                        int32_t* bins) {
+    const float lower = histogram.lower;
+    const float invWidth = 1.0f / histogram.BinWidth();
+    const float maxBin = (float)(histogram.Bins() - 1);
+    const int32_t sentinel = histogram.Bins();
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128 lowerV = _mm_set1_ps(lower);
+    const __m128 invWidthV = _mm_set1_ps(invWidth);
+    const __m128 zeroV = _mm_setzero_ps();
+    const __m128 maxBinV = _mm_set1_ps(maxBin);
+    for (; i + 4 <= count; i += 4) {
+        __m128 t = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(values + i), lowerV), invWidthV);
+        t = _mm_min_ps(_mm_max_ps(t, zeroV), maxBinV);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(bins + i), _mm_cvttps_epi32(t));
+    }
+#endif
+    for (; i < count; i++) {
+        bins[i] = histogram.Bin(values[i]);
+    }
+    for (i = 0; i < count; i++) {
+        bins[i] = mask[i] ? bins[i] : sentinel;
+    }
+}
+
+// Dataset-wide box statistics over an AnnotationIndex: box size and aspect
+// ratio distributions, per-image box counts and a normalized center heatmap.
+// Recompute() does a parallel reduction over the index columns; afterwards
+// ApplyChange() keeps the results current as individual images are edited.
+class DatasetStats {
+public:
+    static constexpr int kHeatmapSize = 64;
+
+private:
+    Histogram boxWidth{"box_width_px", 0.0f, 2048.0f, 64};
+    Histogram boxHeight{"box_height_px", 0.0f, 2048.0f, 64};
+    Histogram aspectRatio{"aspect_log2_w_over_h", -4.0f, 4.0f, 64};
+    Histogram boxesPerImage{"boxes_per_image", 0.0f, 64.0f, 64};
+    Histogram heatmapX{"center_x", 0.0f, 1.0f, kHeatmapSize};
+    Histogram heatmapY{"center_y", 0.0f, 1.0f, kHeatmapSize};
+    std::vector<int64_t> heatmap = std::vector<int64_t>(kHeatmapSize * kHeatmapSize, 0);
+
+    int64_t totalBoxes = 0;
+    int64_t emptyImages = 0;
+    double sumWidth = 0.0;
+    double sumHeight = 0.0;
+    uint64_t version = 0;
+
+    static constexpr size_t kBlock = 256;
+
+    // Per-chunk partial results merged after the parallel pass
+    struct Partial {
+        std::vector<int64_t> width, height, aspect, heat;
+        int64_t boxes = 0;
+        double sumWidth = 0.0, sumHeight = 0.0;
+    };
+
+public:
+    const Histogram& BoxWidth() const { return boxWidth; }
+    const Histogram& BoxHeight() const { return boxHeight; }
+    const Histogram& AspectRatio() const { return aspectRatio; }
+    const Histogram& BoxesPerImage() const { return boxesPerImage; }
+    const std::vector<int64_t>& Heatmap() const { return heatmap; }
+    int64_t TotalBoxes() const { return totalBoxes; }
+    int64_t EmptyImages() const { return emptyImages; }
+    double MeanWidth() const { return totalBoxes > 0 ? sumWidth / totalBoxes : 0.0; }
+    double MeanHeight() const { return totalBoxes > 0 ? sumHeight / totalBoxes : 0.0; }
+    uint64_t Version() const { return version; }
+
+    void Recompute(const AnnotationIndex& index, ThreadPool& pool = ThreadPool::Shared()) {
+        const size_t rows = index.RowCount();
+        std::vector<Partial> partials(pool.MaxChunks());
+
+        size_t used = pool.ParallelFor(0, rows, [&](size_t begin, size_t end, size_t chunk) {
+            Partial& partial = partials[chunk];
+            AccumulateRows(index, begin, end, partial);
+        }, 64 * 1024);
+        partials.resize(used);
+
+        Reset(boxWidth.counts);
+        Reset(boxHeight.counts);
+        Reset(aspectRatio.counts);
+        Reset(heatmap);
+        totalBoxes = 0;
+        sumWidth = 0.0;
+        sumHeight = 0.0;
+        for (const Partial& partial : partials) {
+            Merge(boxWidth.counts, partial.width);
+            Merge(boxHeight.counts, partial.height);
+            Merge(aspectRatio.counts, partial.aspect);
+            Merge(heatmap, partial.heat);
+            totalBoxes += partial.boxes;
+            sumWidth += partial.sumWidth;
+            sumHeight += partial.sumHeight;
+        }
+
+        // Per-image counts come straight from the index's image table
+        Reset(boxesPerImage.counts);
+        emptyImages = 0;
+        for (uint32_t image = 0; image < index.ImageCount(); image++) {
+            uint32_t count = index.ImageBoxCount(image);
+            boxesPerImage.counts[boxesPerImage.Bin((float)count)]++;
+            if (count == 0) emptyImages++;
+        }
+        version++;
+    }
+
+    // Incremental update for one edited image; wire to AnnotationIndex::AddChangeListener
+    void ApplyChange(const AnnotationIndex& index, uint32_t imageId, const std::vector<BoxRecord>& removed,
+                     const std::vector<BoxRecord>& added) {
+        int imageWidth = index.ImageWidth(imageId);
+        int imageHeight = index.ImageHeight(imageId);
+        for (const BoxRecord& box : removed) {
+            AddBox(box, imageWidth, imageHeight, -1);
+        }
+        for (const BoxRecord& box : added) {
+            AddBox(box, imageWidth, imageHeight, +1);
+        }
+
+        boxesPerImage.counts[boxesPerImage.Bin((float)removed.size())]--;
+        boxesPerImage.counts[boxesPerImage.Bin((float)added.size())]++;
+        if (removed.empty()) emptyImages--;
+        if (added.empty()) emptyImages++;
+        version++;
+    }
+
+    // Writes all distributions as one table: statistic,x_lower,x_upper,y_lower,y_upper,count.
+    // One-dimensional statistics leave the y columns empty.
+    bool ExportCSV(const std::string& path) const {
+        std::ofstream csvFile(path);
+        if (!csvFile.is_open()) {
+            std::cerr << "Failed to write statistics CSV: " << path << std::endl;
+            return false;
+        }
+
+        csvFile << "statistic,x_lower,x_upper,y_lower,y_upper,count" << std::endl;
+        for (const Histogram* histogram : {&boxWidth, &boxHeight, &aspectRatio, &boxesPerImage}) {
+            float binWidth = histogram->BinWidth();
+            for (int bin = 0; bin < histogram->Bins(); bin++) {
+                csvFile << histogram->name << "," << histogram->lower + bin * binWidth << ","
+                        << histogram->lower + (bin + 1) * binWidth << ",,," << histogram->counts[bin] << std::endl;
+            }
+        }
+        float cell = 1.0f / kHeatmapSize;
+        for (int y = 0; y < kHeatmapSize; y++) {
+            for (int x = 0; x < kHeatmapSize; x++) {
+                csvFile << "center_heatmap," << x * cell << "," << (x + 1) * cell << "," << y * cell << ","
+                        << (y + 1) * cell << "," << heatmap[y * kHeatmapSize + x] << std::endl;
+            }
+        }
+
+        std::cout << "Dataset statistics exported to: " << path << std::endl;
+        return true;
+    }
+
+private:
+    static void Reset(std::vector<int64_t>& counts) {
+        std::fill(counts.begin(), counts.end(), 0);
+    }
+
+    static void Merge(std::vector<int64_t>& into, const std::vector<int64_t>& from) {
+        for (size_t i = 0; i < into.size(); i++) {
+            into[i] += from[i];
+        }
+    }
+
+    void AddBox(const BoxRecord& box, int imageWidth, int imageHeight, int delta) {
+        float w = box.xmax - box.xmin;
+        float h = box.ymax - box.ymin;
+        boxWidth.counts[boxWidth.Bin(w)] += delta;
+        boxHeight.counts[boxHeight.Bin(h)] += delta;
+        if (w > 0.0f && h > 0.0f) {
+            aspectRatio.counts[aspectRatio.Bin(std::log2(w / h))] += delta;
+        }
+        if (imageWidth > 0 && imageHeight > 0) {
+            float cx = (box.xmin + box.xmax) * 0.5f / imageWidth;
+            float cy = (box.ymin + box.ymax) * 0.5f / imageHeight;
+            heatmap[heatmapY.Bin(cy) * kHeatmapSize + heatmapX.Bin(cx)] += delta;
+        }
+        totalBoxes += delta;
+        sumWidth += delta * (double)w;
+        sumHeight += delta * (double)h;
+    }
+
+    // Histograms one chunk of rows in blocks: derived values are computed into
+    // small column buffers, binned with ComputeBins, then scattered into four
+    // interleaved sub-histograms so consecutive increments to the same bin do
+    // not serialize on a store-to-load dependency.
+    void AccumulateRows(const AnnotationIndex& index, size_t begin, size_t end, Partial& partial) const {
+        const int lanes = 4;
+        std::vector<int64_t> widthLanes((boxWidth.Bins() + 1) * lanes, 0);
+        std::vector<int64_t> heightLanes((boxHeight.Bins() + 1) * lanes, 0);
+        std::vector<int64_t> aspectLanes((aspectRatio.Bins() + 1) * lanes, 0);
+        std::vector<int64_t> heat(kHeatmapSize * kHeatmapSize + 1, 0);
+
+        const float* x1 = index.XMin().data();
+        const float* y1 = index.YMin().data();
+        const float* x2 = index.XMax().data();
+        const float* y2 = index.YMax().data();
+        const uint32_t* ids = index.ImageIds().data();
+
+        float w[kBlock], h[kBlock], aspect[kBlock], cx[kBlock], cy[kBlock];
+        uint8_t live[kBlock], hasAspect[kBlock], hasCenter[kBlock];
+        int32_t wBin[kBlock], hBin[kBlock], aBin[kBlock], cxBin[kBlock], cyBin[kBlock];
+
+        for (size_t blockStart = begin; blockStart < end; blockStart += kBlock) {
+            size_t n = std::min(kBlock, end - blockStart);
+            for (size_t i = 0; i < n; i++) {
+                size_t row = blockStart + i;
+                w[i] = x2[row] - x1[row];
+                h[i] = y2[row] - y1[row];
+            }
+            for (size_t i = 0; i < n; i++) {
+                size_t row = blockStart + i;
+                uint32_t image = ids[row];
+                live[i] = image != AnnotationIndex::kDeadRow;
+                hasAspect[i] = live[i] && w[i] > 0.0f && h[i] > 0.0f;
+                aspect[i] = hasAspect[i] ? std::log2(w[i] / h[i]) : 0.0f;
+
+                int imageWidth = live[i] ? index.ImageWidth(image) : 0;
+                int imageHeight = live[i] ? index.ImageHeight(image) : 0;
+                hasCenter[i] = imageWidth > 0 && imageHeight > 0;
+                cx[i] = hasCenter[i] ? (x1[row] + x2[row]) * 0.5f / imageWidth : 0.0f;
+                cy[i] = hasCenter[i] ? (y1[row] + y2[row]) * 0.5f / imageHeight : 0.0f;
+
+                if (live[i]) {
+                    partial.boxes++;
+                    partial.sumWidth += w[i];
+                    partial.sumHeight += h[i];
+                }
+            }
+
+            ComputeBins(w, live, n, boxWidth, wBin);
+            ComputeBins(h, live, n, boxHeight, hBin);
+            ComputeBins(aspect, hasAspect, n, aspectRatio, aBin);
+            ComputeBins(cx, hasCenter, n, heatmapX, cxBin);
+            ComputeBins(cy, hasCenter, n, heatmapY, cyBin);
+
+            int wStride = boxWidth.Bins() + 1;
+            int hStride = boxHeight.Bins() + 1;
+            int aStride = aspectRatio.Bins() + 1;
+            for (size_t i = 0; i < n; i++) {
+                int lane = (int)(i & (lanes - 1));
+                widthLanes[lane * wStride + wBin[i]]++;
+                heightLanes[lane * hStride + hBin[i]]++;
+                aspectLanes[lane * aStride + aBin[i]]++;
+                int cell = hasCenter[i] ? cyBin[i] * kHeatmapSize + cxBin[i] : kHeatmapSize * kHeatmapSize;
+                heat[cell]++;
+            }
+        }
+
+        partial.width = FoldLanes(widthLanes, boxWidth.Bins(), lanes);
+        partial.height = FoldLanes(heightLanes, boxHeight.Bins(), lanes);
+        partial.aspect = FoldLanes(aspectLanes, aspectRatio.Bins(), lanes);
+        heat.pop_back();  // discard the sentinel cell
+        partial.heat = std::move(heat);
+    }
+
+    static std::vector<int64_t> FoldLanes(const std::vector<int64_t>& laneCounts, int bins, int lanes) {
+        std::vector<int64_t> folded(bins, 0);
+        for (int lane = 0; lane < lanes; lane++) {
+            for (int bin = 0; bin < bins; bin++) {
+                folded[bin] += laneCounts[lane * (bins + 1) + bin];
+            }
+        }
+        return folded;
+    }
+};
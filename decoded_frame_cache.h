@@ -0,0 +1,327 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#if defined(J_BBOX_HAVE_LZ4)
+#include <lz4.h>
+#endif
+
+#include "allocation_tracker.h"
+
+// In-memory cache of decoded frames with two tiers.
+//
+// The raw tier holds ready-to-upload images. When it overflows, its least
+// recently used frames are demoted: LZ4-compressed into the compressed tier,
+// which holds several times as many frames per byte and decompresses far
+// faster than a JPEG decodes. A hit in the compressed tier promotes the frame
+// back to the raw tier unless it is bigger than the whole raw tier. Frames
+// leaving the compressed tier are dropped (the spill cache, if enabled, still
+// has them). Without LZ4 only the raw tier is used.
+//
+// Lookup() and Insert() are called from decode workers and are thread-safe;
+// compression and decompression run outside the lock.
+class DecodedFrameCache {
+public:
+    struct Stats {
+        uint64_t rawHits = 0;
+        uint64_t compressedHits = 0;
+        uint64_t misses = 0;
+        uint64_t demotions = 0;
+        uint64_t promotions = 0;
+        uint64_t dropped = 0;         // frames evicted from the cache entirely
+        uint64_t incompressible = 0;  // demoted frames that LZ4 barely shrank, dropped instead
+
+        double HitRate() const {
+            uint64_t lookups = rawHits + compressedHits + misses;
+            return lookups > 0 ? (double)(rawHits + compressedHits) / lookups : 0.0;
+        }
+    };
+
+    // Share of the budget given to the raw tier; the rest holds compressed frames
+    static constexpr double kRawShare = 0.25;
+
+private:
+    struct RawFrame {
+        std::string path;
+        cv::Mat image;
+        uint64_t bytes;
+    };
+
+    struct CompressedFrame {
+        std::string path;
+        std::shared_ptr<const std::vector<char>> data;
+        int rows, cols, type;
+        uint64_t rawBytes;
+    };
+
+    uint64_t rawCapacity;
+    uint64_t compressedCapacity;
+
+    mutable std::mutex mutex;
+    // Most recently used first
+    std::list<RawFrame> raw;
+    std::list<CompressedFrame> compressed;
+    std::unordered_map<std::string, std::list<RawFrame>::iterator> rawByPath;
+    std::unordered_map<std::string, std::list<CompressedFrame>::iterator> compressedByPath;
+    uint64_t rawBytes = 0;
+    uint64_t compressedBytes = 0;
+    uint64_t representedBytes = 0;  // decompressed size of the compressed tier
+    Stats stats;
+
+public:
+    explicit DecodedFrameCache(uint64_t capacityBytes) {
+#if defined(J_BBOX_HAVE_LZ4)
+        rawCapacity = (uint64_t)(capacityBytes * kRawShare);
+        compressedCapacity = capacityBytes - rawCapacity;
+#else
+        rawCapacity = capacityBytes;
+        compressedCapacity = 0;
+#endif
+    }
+
+    DecodedFrameCache(const DecodedFrameCache&) = delete;
+    DecodedFrameCache& operator=(const DecodedFrameCache&) = delete;
+
+    static bool CompressionAvailable() {
+#if defined(J_BBOX_HAVE_LZ4)
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    bool Lookup(const std::string& path, cv::Mat& image) {
+        CompressedFrame frame;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto rawIt = rawByPath.find(path);
+            if (rawIt != rawByPath.end()) {
+                raw.splice(raw.begin(), raw, rawIt->second);
+                image = rawIt->second->image;
+                stats.rawHits++;
+                return true;
+            }
+            auto compressedIt = compressedByPath.find(path);
+            if (compressedIt == compressedByPath.end()) {
+                stats.misses++;
+                return false;
+            }
+            frame = *compressedIt->second;
+        }
+
+        if (!Decompress(frame, image)) {
+            std::lock_guard<std::mutex> lock(mutex);
+            EraseCompressedLocked(path);
+            stats.misses++;
+            return false;
+        }
+
+        // Promote: the frame moves back to the raw tier. A frame larger than
+        // the whole raw tier would be demoted again at once, so it stays
+        // compressed and the caller gets the decompressed copy.
+        std::vector<RawFrame> demoted;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stats.compressedHits++;
+            if (frame.rawBytes > rawCapacity) {
+                auto it = compressedByPath.find(path);
+                if (it != compressedByPath.end()) compressed.splice(compressed.begin(), compressed, it->second);
+                return true;
+            }
+            if (EraseCompressedLocked(path)) stats.promotions++;
+            demoted = InsertRawLocked(path, image);
+        }
+        Demote(std::move(demoted));
+        return true;
+    }
+
+    // Adds a decoded frame; shares the pixels with the caller, who must not
+    // modify them afterwards
+    void Insert(const std::string& path, const cv::Mat& image) {
+        if (image.empty() || !image.isContinuous()) return;
+        std::vector<RawFrame> demoted;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            EraseCompressedLocked(path);
+            demoted = InsertRawLocked(path, image);
+        }
+        Demote(std::move(demoted));
+    }
+
+    void Clear() {
+        std::lock_guard<std::mutex> lock(mutex);
+        raw.clear();
+        compressed.clear();
+        rawByPath.clear();
+        compressedByPath.clear();
+        rawBytes = compressedBytes = representedBytes = 0;
+    }
+
+    Stats GetStats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
+
+    size_t RawFrames() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return raw.size();
+    }
+
+    size_t CompressedFrames() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return compressed.size();
+    }
+
+    uint64_t RawBytes() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return rawBytes;
+    }
+
+    uint64_t CompressedBytes() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return compressedBytes;
+    }
+
+    // Decoded bytes held per byte of memory used (1 with the raw tier only)
+    double EffectiveRatio() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        uint64_t used = rawBytes + compressedBytes;
+        return used > 0 ? (double)(rawBytes + representedBytes) / used : 1.0;
+    }
+
+    uint64_t CapacityBytes() const { return rawCapacity + compressedCapacity; }
+
+    std::string Describe() const {
+        Stats current = GetStats();
+        std::ostringstream text;
+        text << "RAM cache: " << current.rawHits << " raw hits, " << current.compressedHits << " compressed hits, "
+             << current.misses << " misses (" << (int)(current.HitRate() * 100.0 + 0.5) << "% hit rate), "
+             << RawFrames() << " raw + " << CompressedFrames() << " compressed frames, " << current.demotions
+             << " demoted, " << current.promotions << " promoted, effective capacity x" << EffectiveRatio();
+        return text.str();
+    }
+
+private:
+    // Returns the raw frames pushed out to make room, to be demoted by the caller
+    std::vector<RawFrame> InsertRawLocked(const std::string& path, const cv::Mat& image) {
+        uint64_t bytes = (uint64_t)image.total() * image.elemSize();
+        auto existing = rawByPath.find(path);
+        if (existing != rawByPath.end()) {
+            rawBytes -= existing->second->bytes;
+            raw.erase(existing->second);
+            rawByPath.erase(existing);
+        }
+        std::vector<RawFrame> evicted;
+        if (bytes > rawCapacity) {
+            evicted.push_back({path, image, bytes});
+            return evicted;
+        }
+        raw.push_front({path, image, bytes});
+        rawByPath[path] = raw.begin();
+        rawBytes += bytes;
+        while (rawBytes > rawCapacity) {
+            RawFrame& victim = raw.back();
+            rawBytes -= victim.bytes;
+            rawByPath.erase(victim.path);
+            evicted.push_back(std::move(victim));
+            raw.pop_back();
+        }
+        return evicted;
+    }
+
+    bool EraseCompressedLocked(const std::string& path) {
+        auto it = compressedByPath.find(path);
+        if (it == compressedByPath.end()) return false;
+        compressedBytes -= it->second->data->size();
+        representedBytes -= it->second->rawBytes;
+        compressed.erase(it->second);
+        compressedByPath.erase(it);
+        return true;
+    }
+
+    void Demote(std::vector<RawFrame> frames) {
+        if (frames.empty()) return;
+        if (compressedCapacity == 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            stats.dropped += frames.size();
+            return;
+        }
+        for (RawFrame& frame : frames) {
+            CompressedFrame entry;
+            bool ok = Compress(frame, entry);
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!ok) {
+                stats.incompressible++;
+                stats.dropped++;
+                continue;
+            }
+            // Re-inserted or already demoted by another worker meanwhile
+            if (rawByPath.count(frame.path) > 0 || compressedByPath.count(frame.path) > 0) continue;
+            if (entry.data->size() > compressedCapacity) {
+                stats.dropped++;
+                continue;
+            }
+            compressed.push_front(std::move(entry));
+            compressedByPath[frame.path] = compressed.begin();
+            compressedBytes += compressed.front().data->size();
+            representedBytes += compressed.front().rawBytes;
+            stats.demotions++;
+            while (compressedBytes > compressedCapacity) {
+                EraseCompressedLocked(compressed.back().path);
+                stats.dropped++;
+            }
+        }
+    }
+
+    // Frames that LZ4 shrinks by less than 10% are not worth keeping compressed
+    static bool Compress(const RawFrame& frame, CompressedFrame& entry) {
+#if defined(J_BBOX_HAVE_LZ4)
+        if (frame.bytes > (uint64_t)LZ4_MAX_INPUT_SIZE) return false;
+        AllocationScope scope(AllocationTag::Caches);
+        auto data = std::make_shared<std::vector<char>>((size_t)LZ4_compressBound((int)frame.bytes));
+        int size = LZ4_compress_default(reinterpret_cast<const char*>(frame.image.data), data->data(), (int)frame.bytes,
+                                        (int)data->size());
+        if (size <= 0 || (uint64_t)size > frame.bytes * 9 / 10) return false;
+        data->resize((size_t)size);
+        data->shrink_to_fit();
+        entry.path = frame.path;
+        entry.data = std::move(data);
+        entry.rows = frame.image.rows;
+        entry.cols = frame.image.cols;
+        entry.type = frame.image.type();
+        entry.rawBytes = frame.bytes;
+        return true;
+#else
+        (void)frame;
+        (void)entry;
+        return false;
+#endif
+    }
+
+    static bool Decompress(const CompressedFrame& frame, cv::Mat& image) {
+#if defined(J_BBOX_HAVE_LZ4)
+        AllocationScope scope(AllocationTag::ImageDecode);
+        image.create(frame.rows, frame.cols, frame.type);
+        int size = LZ4_decompress_safe(frame.data->data(), reinterpret_cast<char*>(image.data), (int)frame.data->size(),
+                                       (int)frame.rawBytes);
+        if (size == (int)frame.rawBytes) return true;
+        image.release();
+#else
+        (void)frame;
+        (void)image;
+#endif
+        return false;
+    }
+};
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "annotation_index.h"
+#include "class_table.h"
+#include "oriented_box.h"
+
+// DOTA label files, the format of the DOTA aerial dataset and most oriented
+// detection tooling: one labelTxt/<image stem>.txt per image holding
+//
+//   imagesource:GoogleEarth                  optional header lines
+//   gsd:0.146343590398
+//   x1 y1 x2 y2 x3 y3 x4 y4 category difficult
+//
+// with the four points clockwise on screen from the object's top-left corner.
+// Import fits the closest oriented rectangle to each quadrilateral and writes
+// the image's sidecar; export writes the corners of every sidecar box. Category
+// names map to class ids through the class table, with spaces written as '-'
+// because DOTA fields are space-separated. The conversion is lossy: sidecars
+// hold whole pixels and have no difficult column, so imported boxes are
+// rounded, the flag is only counted, and export marks every object 0.
+
+struct DotaStats {
+    size_t images = 0;      // images with a label file (import) or a sidecar (export)
+    size_t boxes = 0;
+    size_t difficult = 0;   // objects flagged difficult, imported as ordinary boxes
+    size_t skipped = 0;     // malformed lines
+    size_t newClasses = 0;  // categories added to the class table
+};
+
+inline std::string DotaCategory(const ClassTable& classes, uint16_t classId) {
+    std::string name = classes.Name(classId);
+    std::replace(name.begin(), name.end(), ' ', '-');
+    return name;
+}
+
+// Class id of a category: a table name (with '-' read as a space too), the
+// "class-N" name export uses for classes the table does not name, or a new
+// entry appended to the table. -1 if the table is full.
+inline int DotaClassId(ClassTable& classes, const std::string& category) {
+    int classId = classes.Find(category);
+    if (classId >= 0) return classId;
+    std::string spaced = category;
+    std::replace(spaced.begin(), spaced.end(), '-', ' ');
+    classId = classes.Find(spaced);
+    if (classId >= 0) return classId;
+    if (category.compare(0, 6, "class-") == 0 && category.size() > 6) {
+        char* end = nullptr;
+        long id = std::strtol(category.c_str() + 6, &end, 10);
+        if (*end == '\0' && id >= 0 && id <= kMaxClassId && classes.Name((uint16_t)id) == spaced) return (int)id;
+    }
+    return classes.FindOrAdd(category);
+}
+
+// Parses one label file's text; categories missing from the table are added to it
+inline void ParseDotaText(const std::string& text, ClassTable& classes, std::vector<BoxRecord>& boxes, DotaStats& stats) {
+    boxes.clear();
+    std::istringstream lines(text);
+    std::string line;
+    while (std::getline(lines, line)) {
+        std::istringstream fields(line);
+        std::vector<std::string> tokens;
+        std::string token;
+        while (fields >> token) tokens.push_back(token);
+        if (tokens.empty()) continue;
+        if (tokens.size() < 9) {
+            // imagesource: and gsd: headers
+            if (line.find(':') == std::string::npos) stats.skipped++;
+            continue;
+        }
+
+        float x[4], y[4];
+        bool numeric = true;
+        for (int k = 0; k < 8 && numeric; k++) {
+            char* end = nullptr;
+            float value = std::strtof(tokens[k].c_str(), &end);
+            numeric = end != tokens[k].c_str() && *end == '\0' && std::isfinite(value);
+            (k % 2 == 0 ? x : y)[k / 2] = value;
+        }
+        if (!numeric) {
+            stats.skipped++;
+            continue;
+        }
+        size_t before = classes.Count();
+        int classId = DotaClassId(classes, tokens[8]);
+        if (classId < 0) {
+            stats.skipped++;
+            continue;
+        }
+        stats.newClasses += classes.Count() - before;
+        if (tokens.size() > 9 && tokens[9] == "1") stats.difficult++;
+
+        // Sidecars hold whole pixels
+        BoxRecord box = BoxFromCorners(x, y, (uint16_t)classId);
+        box.xmin = std::round(box.xmin);
+        box.ymin = std::round(box.ymin);
+        box.xmax = std::round(box.xmax);
+        box.ymax = std::round(box.ymax);
+        boxes.push_back(box);
+    }
+}
+
+inline void WriteDotaText(std::ostream& out, const std::vector<BoxRecord>& boxes, const ClassTable& classes) {
+    for (const BoxRecord& box : boxes) {
+        BoxCorners corners = OrientedCorners(box);
+        for (int k = 0; k < 4; k++) {
+            out << corners.x[k] << " " << corners.y[k] << " ";
+        }
+        // Sidecars do not record difficulty
+        out << DotaCategory(classes, box.classId) << " 0" << std::endl;
+    }
+}
+
+// Writes the sidecar of every image in imageDirectory that has a label file in
+// labelDirectory, replacing any existing one. New categories are appended to
+// the class table, which is then saved to its file (classes.txt next to the
+// images if it was not loaded from one).
+inline DotaStats ImportDota(const std::string& labelDirectory, const std::string& imageDirectory, ClassTable& classes) {
+    DotaStats stats;
+    std::vector<BoxRecord> boxes;
+    for (const std::string& imagePath : ListImageFiles(imageDirectory)) {
+        std::filesystem::path labelPath =
+            std::filesystem::path(labelDirectory) / (std::filesystem::path(imagePath).stem().string() + ".txt");
+        std::ifstream labelFile(labelPath, std::ios::binary);
+        if (!labelFile.is_open()) continue;
+        std::string text((std::istreambuf_iterator<char>(labelFile)), std::istreambuf_iterator<char>());
+        ParseDotaText(text, classes, boxes, stats);
+
+        std::string csvPath = CsvPathForImage(imagePath);
+        if (!WriteSidecar(csvPath, boxes)) {
+            std::cerr << "Failed to write sidecar: " << csvPath << std::endl;
+            continue;
+        }
+        stats.images++;
+        stats.boxes += boxes.size();
+    }
+
+    if (stats.newClasses > 0) {
+        std::string classesPath = classes.SourcePath();
+        if (classesPath.empty()) classesPath = (std::filesystem::path(imageDirectory) / "classes.txt").string();
+        if (classes.Save(classesPath)) {
+            std::cout << "Added " << stats.newClasses << " classes to " << classesPath << std::endl;
+        }
+    }
+    return stats;
+}
+
+// Writes outputDirectory/<image stem>.txt for every image with a sidecar
+inline DotaStats ExportDota(const std::string& imageDirectory, const std::string& outputDirectory, const ClassTable& classes) {
+    DotaStats stats;
+    std::error_code error;
+    std::filesystem::create_directories(outputDirectory, error);
+    if (error) {
+        std::cerr << "Failed to create " << outputDirectory << ": " << error.message() << std::endl;
+        return stats;
+    }
+    std::vector<BoxRecord> boxes;
+    for (const std::string& imagePath : ListImageFiles(imageDirectory)) {
+        if (!ParseBoxCsv(CsvPathForImage(imagePath), boxes)) continue;
+        std::filesystem::path labelPath =
+            std::filesystem::path(outputDirectory) / (std::filesystem::path(imagePath).stem().string() + ".txt");
+        std::ofstream labelFile(labelPath);
+        if (!labelFile.is_open()) {
+            std::cerr << "Failed to write label file: " << labelPath.string() << std::endl;
+            continue;
+        }
+        WriteDotaText(labelFile, boxes, classes);
+        stats.images++;
+        stats.boxes += boxes.size();
+    }
+    return stats;
+}
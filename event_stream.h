@@ -0,0 +1,187 @@
+#pragma once
+
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "json_escape.h"
+#include "viewer_event.h"
+
+// Machine-readable event stream: one JSON object per line (NDJSON) for every
+// box commit, navigation and save.
+//
+// Events are copied into a queue on the UI thread and formatted and written by
+// a background thread, so a slow reader (or a FIFO nobody has opened yet)
+// never stalls a frame. If the queue fills up, new events are dropped and a
+// "dropped" record reports how many were lost once the writer catches up.
+// The process must ignore SIGPIPE, so that a FIFO reader going away ends the
+// stream instead of killing the viewer.
+class EventStream {
+private:
+    struct QueuedEvent {
+        ViewerEvent event;
+        double timestamp;
+        uint64_t sequence;
+    };
+
+    std::string path;
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<QueuedEvent> queue;
+    bool stopping = false;
+    uint64_t nextSequence = 0;
+    uint64_t dropped = 0;
+    static constexpr size_t kMaxQueued = 65536;
+
+public:
+    EventStream() = default;
+    EventStream(const EventStream&) = delete;
+    EventStream& operator=(const EventStream&) = delete;
+
+    ~EventStream() {
+        Close();
+    }
+
+    // "-" writes to stdout; anything else is opened for appending (regular file or FIFO)
+    void Open(const std::string& streamPath) {
+        path = streamPath;
+        writer = std::thread([this]() { WriterLoop(); });
+    }
+
+    void Close() {
+        if (!writer.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        condition.notify_one();
+        writer.join();
+    }
+
+    bool IsOpen() const { return !path.empty(); }
+
+    void Publish(const ViewerEvent& event) {
+        double timestamp = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (queue.size() >= kMaxQueued) {
+                dropped++;
+                return;
+            }
+            queue.push_back({event, timestamp, nextSequence++});
+        }
+        condition.notify_one();
+    }
+
+    static std::string FormatRecord(const ViewerEvent& event, double timestamp, uint64_t sequence) {
+        std::ostringstream out;
+        out.precision(17);
+        out << "{\"seq\":" << sequence << ",\"ts\":" << timestamp << ",\"event\":\"" << ViewerEventName(event.type)
+            << "\",\"index\":" << event.imageIndex << ",\"count\":" << event.imageCount << ",\"path\":\""
+            << JsonEscape(event.imagePath) << "\",\"width\":" << event.imageWidth << ",\"height\":" << event.imageHeight
+            << ",\"boxes\":[";
+        out.precision(6);
+        for (size_t i = 0; i < event.boxes.size(); i++) {
+            const BoxRecord& box = event.boxes[i];
+            out << (i ? "," : "") << "{\"xmin\":" << box.xmin << ",\"ymin\":" << box.ymin << ",\"xmax\":" << box.xmax
+                << ",\"ymax\":" << box.ymax << ",\"class\":" << box.classId;
+            // YOLOv5 normalized form, as printed by OutputBoundingBox; it has no
+            // rotation, so rotated boxes carry their angle instead
+            if (box.angle != 0.0f) {
+                out << ",\"angle\":" << box.angle;
+            } else if (event.imageWidth > 0 && event.imageHeight > 0) {
+                out << ",\"yolo\":[" << box.classId << "," << (box.xmin + box.xmax) / 2.0f / event.imageWidth << ","
+                    << (box.ymin + box.ymax) / 2.0f / event.imageHeight << ","
+                    << (box.xmax - box.xmin) / event.imageWidth << "," << (box.ymax - box.ymin) / event.imageHeight
+                    << "]";
+            }
+            out << "}";
+        }
+        out << "]}\n";
+        return out.str();
+    }
+
+private:
+    void WriterLoop() {
+        int fd = OpenOutput();
+
+        std::deque<QueuedEvent> batch;
+        std::string buffer;
+        while (true) {
+            uint64_t droppedNow = 0;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [this]() { return stopping || !queue.empty(); });
+                if (queue.empty() && stopping) break;
+                batch.swap(queue);
+                droppedNow = dropped;
+                dropped = 0;
+            }
+
+            buffer.clear();
+            if (droppedNow > 0) {
+                buffer += "{\"event\":\"dropped\",\"count\":" + std::to_string(droppedNow) + "}\n";
+            }
+            for (const QueuedEvent& queued : batch) {
+                buffer += FormatRecord(queued.event, queued.timestamp, queued.sequence);
+            }
+            batch.clear();
+
+            if (fd >= 0 && !WriteAll(fd, buffer)) {
+                std::cerr << "Event stream write failed, closing: " << std::strerror(errno) << std::endl;
+                close(fd);
+                fd = -1;
+            }
+        }
+
+        if (fd >= 0) close(fd);
+    }
+
+    // Opening a FIFO without a reader would block, so it is retried in
+    // non-blocking mode until a reader appears or the stream is closed.
+    int OpenOutput() {
+        if (path == "-") return dup(STDOUT_FILENO);
+
+        while (true) {
+            int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC | O_NONBLOCK, 0644);
+            if (fd >= 0) {
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+                return fd;
+            }
+            if (errno != ENXIO) {
+                std::cerr << "Failed to open event stream " << path << ": " << std::strerror(errno) << std::endl;
+                return -1;
+            }
+
+            std::unique_lock<std::mutex> lock(mutex);
+            if (condition.wait_for(lock, std::chrono::milliseconds(100), [this]() { return stopping; })) {
+                return -1;
+            }
+        }
+    }
+
+    static bool WriteAll(int fd, const std::string& data) {
+        size_t written = 0;
+        while (written < data.size()) {
+            ssize_t n = write(fd, data.data() + written, data.size() - written);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            written += n;
+        }
+        return true;
+    }
+};
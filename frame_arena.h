@@ -0,0 +1,164 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// Linear allocator for data that lives for one UI frame.
+//
+// Reset() is called once per frame right before ImGui::NewFrame; everything
+// allocated since the previous reset becomes invalid at that point. Memory is
+// never returned to the heap: when a frame overflows the current block a new
+// one is chained, and the next Reset() merges all blocks into one large enough
+// for that frame, so a steady-state frame takes no new blocks from the heap.
+// Only the UI thread may use the shared arena.
+class FrameArena {
+public:
+    struct FrameStats {
+        uint64_t allocations = 0;      // Allocate() calls
+        uint64_t bytes = 0;            // bytes requested
+        uint64_t refills = 0;          // blocks the arena had to add from the heap
+    };
+
+private:
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t size = 0;
+    };
+
+    std::vector<Block> blocks;
+    size_t currentBlock = 0;
+    size_t offset = 0;
+
+    FrameStats frame;
+    FrameStats lastFrame;
+    uint64_t peakBytes = 0;
+
+    static constexpr size_t kDefaultBlockSize = 64 << 10;
+
+public:
+    explicit FrameArena(size_t initialSize = kDefaultBlockSize) {
+        AddBlock(initialSize);
+        frame = FrameStats();
+    }
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    static FrameArena& Shared() {
+        static FrameArena arena;
+        return arena;
+    }
+
+    void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+        frame.allocations++;
+        frame.bytes += size;
+
+        while (true) {
+            Block& block = blocks[currentBlock];
+            uintptr_t base = reinterpret_cast<uintptr_t>(block.data.get());
+            size_t aligned = (size_t)(((base + offset + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base);
+            if (aligned + size <= block.size) {
+                offset = aligned + size;
+                return block.data.get() + aligned;
+            }
+            if (currentBlock + 1 < blocks.size()) {
+                currentBlock++;
+            } else {
+                AddBlock(std::max(size + alignment, block.size * 2));
+                currentBlock = blocks.size() - 1;
+            }
+            offset = 0;
+        }
+    }
+
+    // Uninitialized storage for count objects of a trivially destructible type
+    template <typename T>
+    T* AllocateArray(size_t count) {
+        static_assert(std::is_trivially_destructible<T>::value, "arena memory is released without running destructors");
+        return static_cast<T*>(Allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    // printf-style formatting into arena memory
+    const char* Format(const char* format, ...) {
+        va_list args;
+        va_start(args, format);
+        va_list copy;
+        va_copy(copy, args);
+        int length = std::vsnprintf(nullptr, 0, format, copy);
+        va_end(copy);
+        char* text = AllocateArray<char>(length > 0 ? length + 1 : 1);
+        std::vsnprintf(text, length > 0 ? length + 1 : 1, format, args);
+        va_end(args);
+        return text;
+    }
+
+    void Reset() {
+        // Merge chained blocks so the same workload fits in one block next frame
+        if (blocks.size() > 1) {
+            size_t total = 0;
+            for (const Block& block : blocks) {
+                total += block.size;
+            }
+            blocks.clear();
+            AddBlock(total);
+        }
+        currentBlock = 0;
+        offset = 0;
+
+        peakBytes = std::max(peakBytes, frame.bytes);
+        lastFrame = frame;
+        frame = FrameStats();
+    }
+
+    // Counters of the frame in progress and of the last completed frame
+    const FrameStats& CurrentFrame() const { return frame; }
+    const FrameStats& LastFrame() const { return lastFrame; }
+    uint64_t PeakBytes() const { return peakBytes; }
+
+    size_t Capacity() const {
+        size_t total = 0;
+        for (const Block& block : blocks) {
+            total += block.size;
+        }
+        return total;
+    }
+
+private:
+    void AddBlock(size_t size) {
+        Block block;
+        block.data.reset(new char[size]);
+        block.size = size;
+        blocks.push_back(std::move(block));
+        frame.refills++;
+    }
+};
+
+// Standard allocator over a FrameArena, for frame-local containers.
+// Deallocation is a no-op; the memory is reclaimed by FrameArena::Reset().
+template <typename T>
+struct ArenaAllocator {
+    using value_type = T;
+
+    FrameArena* arena;
+
+    explicit ArenaAllocator(FrameArena& frameArena = FrameArena::Shared()) : arena(&frameArena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t count) { return static_cast<T*>(arena->Allocate(sizeof(T) * count, alignof(T))); }
+    void deallocate(T*, size_t) {}
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include <GLFW/glfw3.h>
+
+enum class PacingMode {
+    Vsync,        // swap interval 1
+    Adaptive,     // late swaps tear instead of waiting a whole refresh (swap interval -1)
+    Capped,       // no vsync, frame rate limited by sleeping to a deadline
+    EventDriven,  // render only after input, a few settle frames, or an idle timeout
+    Unthrottled   // no vsync, no cap (replay benchmarks)
+};
+
+inline const char* PacingModeName(PacingMode mode) {
+    switch (mode) {
+        case PacingMode::Vsync: return "vsync";
+        case PacingMode::Adaptive: return "adaptive";
+        case PacingMode::Capped: return "cap";
+        case PacingMode::EventDriven: return "events";
+        case PacingMode::Unthrottled: return "unthrottled";
+        default: return "unknown";
+    }
+}
+
+inline bool ParsePacingMode(const std::string& name, PacingMode& mode) {
+    for (PacingMode candidate : {PacingMode::Vsync, PacingMode::Adaptive, PacingMode::Capped, PacingMode::EventDriven,
+                                 PacingMode::Unthrottled}) {
+        if (name == PacingModeName(candidate)) {
+            mode = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Decides when the main loop starts a frame and how buffer swaps wait.
+//
+// WaitForFrame() replaces glfwPollEvents() at the top of the loop and
+// EndFrame() follows glfwSwapBuffers(). In capped mode frames are released on a
+// fixed schedule: the thread sleeps until shortly before the deadline and
+// yields for the remainder, since sleep_until alone overshoots by the
+// scheduler's timer slack. A frame that misses its deadline by more than a
+// period restarts the schedule instead of rendering a burst to catch up.
+class FramePacer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Frames rendered after an event before waiting again, so ImGui can settle
+    // hover and animation state that lags input by a frame
+    static constexpr int kSettleFrames = 3;
+
+private:
+    PacingMode mode;
+    double maxFps;
+    double idleTimeoutSeconds;
+    Clock::duration period;
+    Clock::time_point deadline;
+    int settleFrames = kSettleFrames;
+
+    static constexpr std::chrono::microseconds kSpinMargin{1000};
+
+public:
+    explicit FramePacer(PacingMode pacingMode = PacingMode::Vsync, double fpsCap = 60.0, double idleTimeout = 0.25)
+        : mode(pacingMode), maxFps(fpsCap > 0.0 ? fpsCap : 60.0), idleTimeoutSeconds(idleTimeout) {
+        period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / maxFps));
+    }
+
+    // Sets the swap interval; the window's context must be current
+    void Apply() {
+        if (mode == PacingMode::Adaptive && !glfwExtensionSupported("GLX_EXT_swap_control_tear") &&
+            !glfwExtensionSupported("WGL_EXT_swap_control_tear")) {
+            std::cerr << "Adaptive vsync (swap_control_tear) is not supported, using vsync" << std::endl;
+            mode = PacingMode::Vsync;
+        }
+
+        switch (mode) {
+            case PacingMode::Vsync:
+            case PacingMode::EventDriven:
+                glfwSwapInterval(1);
+                break;
+            case PacingMode::Adaptive:
+                glfwSwapInterval(-1);
+                break;
+            case PacingMode::Capped:
+            case PacingMode::Unthrottled:
+                glfwSwapInterval(0);
+                break;
+        }
+        deadline = Clock::now();
+        std::cout << "Frame pacing: " << Describe() << std::endl;
+    }
+
+    // Processes window events, blocking in event-driven mode until there is
+    // something to draw
+    void WaitForFrame() {
+        if (mode != PacingMode::EventDriven) {
+            glfwPollEvents();
+            return;
+        }
+        if (settleFrames > 0) {
+            settleFrames--;
+            glfwPollEvents();
+            return;
+        }
+        // Wakes on input or after the timeout, so control commands and
+        // background jobs still reach the screen while idle. Only an early
+        // wake-up (an event) earns settle frames; an idle tick draws one frame.
+        Clock::time_point start = Clock::now();
+        glfwWaitEventsTimeout(idleTimeoutSeconds);
+        double waited = std::chrono::duration<double>(Clock::now() - start).count();
+        if (waited < idleTimeoutSeconds * 0.9) settleFrames = kSettleFrames;
+    }
+
+    void EndFrame() {
+        if (mode != PacingMode::Capped) return;
+
+        deadline += period;
+        Clock::time_point now = Clock::now();
+        if (now > deadline + period) {
+            deadline = now;
+            return;
+        }
+        if (deadline - now > kSpinMargin) {
+            std::this_thread::sleep_until(deadline - kSpinMargin);
+        }
+        while (Clock::now() < deadline) {
+            std::this_thread::yield();
+        }
+    }
+
+    PacingMode Mode() const { return mode; }
+
+    // Intended frame interval, or 0 when frames are not paced to a rate
+    double TargetFrameMs() const {
+        switch (mode) {
+            case PacingMode::Capped:
+                return 1000.0 / maxFps;
+            case PacingMode::Vsync:
+            case PacingMode::Adaptive: {
+                const GLFWvidmode* video = glfwGetVideoMode(glfwGetPrimaryMonitor());
+                return video != nullptr && video->refreshRate > 0 ? 1000.0 / video->refreshRate : 0.0;
+            }
+            default:
+                return 0.0;
+        }
+    }
+
+    std::string Describe() const {
+        std::string description = PacingModeName(mode);
+        if (mode == PacingMode::Capped) description += " " + std::to_string((int)maxFps) + " fps";
+        return description;
+    }
+};
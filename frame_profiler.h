@@ -0,0 +1,278 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "allocation_tracker.h"
+
+// Per-frame timing for replay benchmarks.
+//
+// Each frame records the CPU time spent building and submitting it (excluding
+// the buffer swap, which only measures vsync), the time spent uploading
+// textures, and the wall-clock time since the previous frame started, plus
+// the frame arena's usage and, when built with J_BBOX_TRACK_ALLOCATIONS, the
+// heap allocations the UI thread made during the frame. GPU timer results
+// arrive a few frames late and are filled into their frame's sample by
+// SetGpuTimes(). Summaries report mean and p50/p90/p99/max so runs can be
+// compared in CI.
+struct FrameSample {
+    double cpuMs = 0.0;
+    double uploadMs = 0.0;
+    double frameMs = 0.0;
+    double arenaBytes = 0.0;
+    uint64_t arenaRefills = 0;
+    uint64_t heapAllocations = 0;  // by the UI thread; 0 unless allocations are tracked
+    bool gpuValid = false;
+    double gpuUploadMs = 0.0;
+    double gpuImageMs = 0.0;
+    double gpuOverlayMs = 0.0;
+    double gpuRenderMs = 0.0;
+};
+
+struct TimingSummary {
+    double mean = 0.0, p50 = 0.0, p90 = 0.0, p99 = 0.0, max = 0.0, total = 0.0, stddev = 0.0;
+};
+
+class FrameProfiler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+private:
+    std::vector<FrameSample> samples;
+    Clock::time_point frameStart;
+    Clock::time_point previousFrameStart;
+    uint64_t frameStartAllocations = 0;
+    bool inFrame = false;
+
+    std::string pacing;
+    double targetFrameMs = 0.0;
+
+public:
+    void BeginFrame() {
+        previousFrameStart = frameStart;
+        frameStart = Clock::now();
+        frameStartAllocations = AllocationTracker::ThreadAllocations();
+        inFrame = true;
+    }
+
+    // Number of initial frames excluded from the steady-state arena refill and
+    // heap allocation counts
+    static constexpr size_t kWarmupFrames = 10;
+
+    // Ends the CPU part of the frame; uploadMs is the texture upload time spent in it
+    void EndFrame(double uploadMs, uint64_t arenaBytes = 0, uint64_t arenaRefills = 0) {
+        if (!inFrame) return;
+        inFrame = false;
+
+        FrameSample sample;
+        sample.cpuMs = std::chrono::duration<double, std::milli>(Clock::now() - frameStart).count();
+        sample.uploadMs = uploadMs;
+        sample.arenaBytes = (double)arenaBytes;
+        sample.arenaRefills = arenaRefills;
+        sample.heapAllocations = AllocationTracker::ThreadAllocations() - frameStartAllocations;
+        if (!samples.empty()) {
+            sample.frameMs = std::chrono::duration<double, std::milli>(frameStart - previousFrameStart).count();
+        }
+        samples.push_back(sample);
+    }
+
+    // GPU times of an earlier frame, counted from the first BeginFrame()
+    void SetGpuTimes(size_t frame, double uploadMs, double imageMs, double overlayMs, double renderMs) {
+        if (frame >= samples.size()) return;
+        FrameSample& sample = samples[frame];
+        sample.gpuValid = true;
+        sample.gpuUploadMs = uploadMs;
+        sample.gpuImageMs = imageMs;
+        sample.gpuOverlayMs = overlayMs;
+        sample.gpuRenderMs = renderMs;
+    }
+
+    size_t GpuFrames() const {
+        size_t frames = 0;
+        for (const FrameSample& sample : samples) {
+            if (sample.gpuValid) frames++;
+        }
+        return frames;
+    }
+
+    // Frame pacing in effect, for the report; targetMs 0 means no fixed rate
+    void SetPacing(const std::string& description, double targetMs) {
+        pacing = description;
+        targetFrameMs = targetMs;
+    }
+
+    // Frames whose interval exceeded the pacing target by more than half a period
+    size_t LateFrames() const {
+        if (targetFrameMs <= 0.0) return 0;
+        size_t frames = 0;
+        for (size_t i = 1; i < samples.size(); i++) {
+            if (samples[i].frameMs > targetFrameMs * 1.5) frames++;
+        }
+        return frames;
+    }
+
+    void Clear() { samples.clear(); }
+    const std::vector<FrameSample>& Samples() const { return samples; }
+
+    // The first frame has no predecessor and is excluded from the frame-time
+    // summary; GPU summaries only cover frames whose queries were read back
+    TimingSummary Summarize(double FrameSample::*field) const {
+        bool gpuField = field == &FrameSample::gpuUploadMs || field == &FrameSample::gpuImageMs ||
+                        field == &FrameSample::gpuOverlayMs || field == &FrameSample::gpuRenderMs;
+        std::vector<double> values;
+        values.reserve(samples.size());
+        for (size_t i = field == &FrameSample::frameMs ? 1 : 0; i < samples.size(); i++) {
+            if (gpuField && !samples[i].gpuValid) continue;
+            values.push_back(samples[i].*field);
+        }
+
+        TimingSummary summary;
+        if (values.empty()) return summary;
+        std::sort(values.begin(), values.end());
+        for (double value : values) {
+            summary.total += value;
+        }
+        summary.mean = summary.total / values.size();
+        double variance = 0.0;
+        for (double value : values) {
+            variance += (value - summary.mean) * (value - summary.mean);
+        }
+        summary.stddev = std::sqrt(variance / values.size());
+        summary.p50 = Percentile(values, 0.50);
+        summary.p90 = Percentile(values, 0.90);
+        summary.p99 = Percentile(values, 0.99);
+        summary.max = values.back();
+        return summary;
+    }
+
+    // Frames after the warm-up in which the frame arena had to add a block
+    size_t SteadyStateRefillFrames() const {
+        size_t frames = 0;
+        for (size_t i = kWarmupFrames; i < samples.size(); i++) {
+            if (samples[i].arenaRefills > 0) frames++;
+        }
+        return frames;
+    }
+
+    // Frames after the warm-up in which the UI thread allocated from the heap;
+    // only meaningful when AllocationTracker::Enabled()
+    size_t SteadyStateHeapFrames() const {
+        size_t frames = 0;
+        for (size_t i = kWarmupFrames; i < samples.size(); i++) {
+            if (samples[i].heapAllocations > 0) frames++;
+        }
+        return frames;
+    }
+
+    void PrintSummary(std::ostream& out) const {
+        out << "Frames: " << samples.size() << std::endl;
+        PrintLine(out, "CPU time", Summarize(&FrameSample::cpuMs));
+        PrintLine(out, "Upload time", Summarize(&FrameSample::uploadMs));
+        PrintLine(out, "Frame time", Summarize(&FrameSample::frameMs));
+        if (!pacing.empty()) {
+            out << "Pacing: " << pacing;
+            if (targetFrameMs > 0.0) out << ", target " << targetFrameMs << " ms, " << LateFrames() << " late frames";
+            out << std::endl;
+        }
+        if (GpuFrames() > 0) {
+            PrintLine(out, "GPU upload", Summarize(&FrameSample::gpuUploadMs));
+            PrintLine(out, "GPU image", Summarize(&FrameSample::gpuImageMs));
+            PrintLine(out, "GPU overlay", Summarize(&FrameSample::gpuOverlayMs));
+            PrintLine(out, "GPU render", Summarize(&FrameSample::gpuRenderMs));
+        }
+        TimingSummary arena = Summarize(&FrameSample::arenaBytes);
+        out << "Frame arena: mean " << (uint64_t)arena.mean << " B, max " << (uint64_t)arena.max << " B, "
+            << SteadyStateRefillFrames() << " steady-state frames refilled the arena" << std::endl;
+        if (AllocationTracker::Enabled()) {
+            out << "Heap: " << SteadyStateHeapFrames() << " steady-state frames allocated on the UI thread" << std::endl;
+        } else {
+            out << "Heap: allocations not tracked (build with J_BBOX_TRACK_ALLOCATIONS)" << std::endl;
+        }
+    }
+
+    // JSON summary plus per-frame samples: [cpu_ms, upload_ms, frame_ms, arena_bytes,
+    // arena_refills, heap_allocations, gpu_upload_ms, gpu_image_ms, gpu_overlay_ms,
+    // gpu_render_ms], with null GPU times for frames that have none and null heap
+    // allocations unless they are tracked
+    bool WriteReport(const std::string& path) const {
+        std::ofstream file(path);
+        if (!file.is_open()) {
+            std::cerr << "Failed to write frame report: " << path << std::endl;
+            return false;
+        }
+
+        file << "{\n  \"frames\": " << samples.size() << ",\n";
+        if (!pacing.empty()) {
+            file << "  \"pacing\": \"" << pacing << "\",\n";
+            file << "  \"target_frame_ms\": " << targetFrameMs << ",\n";
+            file << "  \"late_frames\": " << LateFrames() << ",\n";
+        }
+        WriteSummary(file, "cpu_ms", Summarize(&FrameSample::cpuMs));
+        WriteSummary(file, "upload_ms", Summarize(&FrameSample::uploadMs));
+        WriteSummary(file, "frame_ms", Summarize(&FrameSample::frameMs));
+        WriteSummary(file, "arena_bytes", Summarize(&FrameSample::arenaBytes));
+        WriteSummary(file, "gpu_upload_ms", Summarize(&FrameSample::gpuUploadMs));
+        WriteSummary(file, "gpu_image_ms", Summarize(&FrameSample::gpuImageMs));
+        WriteSummary(file, "gpu_overlay_ms", Summarize(&FrameSample::gpuOverlayMs));
+        WriteSummary(file, "gpu_render_ms", Summarize(&FrameSample::gpuRenderMs));
+        file << "  \"gpu_frames\": " << GpuFrames() << ",\n";
+        file << "  \"arena_steady_state_refill_frames\": " << SteadyStateRefillFrames() << ",\n";
+        if (AllocationTracker::Enabled()) {
+            file << "  \"steady_state_heap_frames\": " << SteadyStateHeapFrames() << ",\n";
+        } else {
+            file << "  \"steady_state_heap_frames\": null,\n";
+        }
+        file << "  \"samples\": [";
+        char buffer[256];
+        for (size_t i = 0; i < samples.size(); i++) {
+            const FrameSample& sample = samples[i];
+            std::snprintf(buffer, sizeof(buffer), "%s\n    [%.4f, %.4f, %.4f, %.0f, %llu, ", i ? "," : "", sample.cpuMs,
+                          sample.uploadMs, sample.frameMs, sample.arenaBytes, (unsigned long long)sample.arenaRefills);
+            file << buffer;
+            if (AllocationTracker::Enabled()) {
+                file << sample.heapAllocations << ", ";
+            } else {
+                file << "null, ";
+            }
+            if (sample.gpuValid) {
+                std::snprintf(buffer, sizeof(buffer), "%.4f, %.4f, %.4f, %.4f]", sample.gpuUploadMs, sample.gpuImageMs,
+                              sample.gpuOverlayMs, sample.gpuRenderMs);
+                file << buffer;
+            } else {
+                file << "null, null, null, null]";
+            }
+        }
+        file << "\n  ]\n}\n";
+        std::cout << "Frame report written to: " << path << std::endl;
+        return true;
+    }
+
+private:
+    // Nearest-rank percentile of sorted values
+    static double Percentile(const std::vector<double>& sorted, double fraction) {
+        size_t rank = (size_t)std::ceil(fraction * sorted.size());
+        return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+    }
+
+    static void PrintLine(std::ostream& out, const char* label, const TimingSummary& summary) {
+        char buffer[192];
+        std::snprintf(buffer, sizeof(buffer), "%-12s mean %8.3f  sd %8.3f  p50 %8.3f  p90 %8.3f  p99 %8.3f  max %8.3f ms",
+                      label, summary.mean, summary.stddev, summary.p50, summary.p90, summary.p99, summary.max);
+        out << buffer << std::endl;
+    }
+
+    static void WriteSummary(std::ostream& out, const char* name, const TimingSummary& summary) {
+        char buffer[256];
+        std::snprintf(buffer, sizeof(buffer),
+                      "  \"%s\": {\"mean\": %.4f, \"stddev\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, \"max\": %.4f, \"total\": %.4f},\n",
+                      name, summary.mean, summary.stddev, summary.p50, summary.p90, summary.p99, summary.max, summary.total);
+        out << buffer;
+    }
+};
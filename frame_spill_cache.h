@@ -0,0 +1,557 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <opencv2/opencv.hpp>
+
+#if defined(J_BBOX_HAVE_LZ4)
+#include <lz4.h>
+#endif
+
+#include "allocation_tracker.h"
+#include "thread_pool.h"
+
+enum class SpillCompression : uint32_t {
+    Raw = 0,  // pixels as decoded; loads map the file and upload straight from the mapping
+    Lz4 = 1   // smaller files for NVMe; loads decompress from the mapping
+};
+
+inline bool SpillCompressionAvailable(SpillCompression compression) {
+#if defined(J_BBOX_HAVE_LZ4)
+    return compression == SpillCompression::Raw || compression == SpillCompression::Lz4;
+#else
+    return compression == SpillCompression::Raw;
+#endif
+}
+
+// Backs a cv::Mat with a private file mapping so a cached raw frame is never
+// copied: the mapping is released when the last Mat referencing it goes away.
+// Mat::create() only allocates from a mapping handed over through Adopt() on
+// the same thread; any other allocation falls through to the standard allocator.
+class MappedFrameAllocator : public cv::MatAllocator {
+private:
+    struct Pending {
+        unsigned char* mapping = nullptr;
+        size_t length = 0;
+        size_t offset = 0;
+    };
+
+    static Pending& PendingMapping() {
+        static thread_local Pending pending;
+        return pending;
+    }
+
+public:
+    // Wraps rows x cols pixels at mapping + offset in image; takes ownership of
+    // the mapping, which is unmapped on failure
+    bool Adopt(unsigned char* mapping, size_t length, size_t offset, int rows, int cols, int type, cv::Mat& image) {
+        Pending& pending = PendingMapping();
+        pending = {mapping, length, offset};
+        image.release();
+        image.allocator = this;
+        image.create(rows, cols, type);
+        bool adopted = pending.mapping == nullptr;
+        pending = Pending();
+        image.allocator = nullptr;  // later reallocations of this header use the default allocator
+        if (!adopted) {
+            munmap(mapping, length);
+            image.release();
+        }
+        return adopted;
+    }
+
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step, cv::AccessFlag flags,
+                           cv::UMatUsageFlags usageFlags) const override {
+        Pending& pending = PendingMapping();
+        if (data != nullptr || pending.mapping == nullptr) {
+            return cv::Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usageFlags);
+        }
+
+        size_t total = CV_ELEM_SIZE(type);
+        for (int i = dims - 1; i >= 0; i--) {
+            if (step) step[i] = total;
+            total *= (size_t)sizes[i];
+        }
+        if (pending.offset + total > pending.length) {
+            return cv::Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usageFlags);
+        }
+
+        cv::UMatData* u = new cv::UMatData(this);
+        u->origdata = pending.mapping;
+        u->data = pending.mapping + pending.offset;
+        u->size = total;
+        u->userdata = reinterpret_cast<void*>(pending.length);
+        pending.mapping = nullptr;
+        return u;
+    }
+
+    bool allocate(cv::UMatData*, cv::AccessFlag, cv::UMatUsageFlags) const override {
+        return false;
+    }
+
+    void deallocate(cv::UMatData* u) const override {
+        if (u == nullptr) return;
+        munmap(u->origdata, reinterpret_cast<size_t>(u->userdata));
+        delete u;
+    }
+
+    static MappedFrameAllocator& Shared() {
+        static MappedFrameAllocator allocator;
+        return allocator;
+    }
+};
+
+// Disk tier for decoded frames, for repeat review passes over the same folder.
+//
+// Every decoded image is written, raw or LZ4-compressed, to one file in a
+// cache directory, ideally on tmpfs (/dev/shm) or local NVMe. Later loads of
+// the image map that file instead of decoding the JPEG again; raw frames are
+// uploaded straight from the mapping. Entries are keyed by the image path and
+// the decode variant (the display size limit frames were reduced for), and
+// validated against the source file's size and modification time, so edited
+// images are decoded afresh and a session never gets frames decoded for
+// another texture limit. The directory is capped in bytes and the least
+// recently used frames are evicted first; it persists across sessions.
+//
+// Load() and Store() are called from decode workers and are thread-safe.
+// Stores run as separate pool tasks so writing never delays a decode result.
+class FrameSpillCache {
+public:
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t stale = 0;      // entry found but the source image changed since
+        uint64_t stores = 0;
+        uint64_t skipped = 0;    // stores dropped because too many were pending
+        uint64_t evictions = 0;
+        uint64_t bytesLoaded = 0;
+        uint64_t bytesStored = 0;
+
+        double HitRate() const {
+            uint64_t lookups = hits + misses;
+            return lookups > 0 ? (double)hits / lookups : 0.0;
+        }
+    };
+
+private:
+    // Fixed 64-byte file header, followed by the pixel payload
+    struct FileHeader {
+        char magic[8];
+        uint64_t pathHash;
+        int64_t sourceSize;
+        int64_t sourceMtime;  // nanoseconds
+        int32_t rows;
+        int32_t cols;
+        int32_t type;
+        uint32_t compression;
+        uint64_t payloadBytes;
+        uint64_t rawBytes;
+    };
+    static_assert(sizeof(FileHeader) == 64, "spill cache header layout");
+    // Version 2 keys entries by variant; version 1 files are discarded as stale
+    static constexpr char kMagic[8] = {'J', 'B', 'B', 'X', 'S', 'P', 'L', '2'};
+    // Temporary files are named <key>.frame.tmp.<pid>.<thread>
+    static constexpr const char* kTemporaryMarker = ".frame.tmp.";
+
+    struct Entry {
+        uint64_t bytes = 0;
+        uint64_t lastUse = 0;
+    };
+
+    std::string directory;
+    uint64_t variantHash;
+    uint64_t capacityBytes;
+    SpillCompression compression;
+    ThreadPool& pool;
+    bool enabled = false;
+
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, Entry> entries;  // cache file name -> entry
+    uint64_t totalBytes = 0;
+    uint64_t useCounter = 0;
+    Stats stats;
+
+    std::mutex storeMutex;
+    std::condition_variable storeDone;
+    size_t pendingStores = 0;
+    size_t maxPendingStores;
+
+public:
+    // variant names the decode settings the stored frames depend on, such as
+    // the texture limit; frames stored under another variant are never loaded
+    FrameSpillCache(const std::string& cacheDirectory, uint64_t capacity, SpillCompression spillCompression,
+                    const std::string& variant = std::string(), ThreadPool& threadPool = ThreadPool::Shared())
+        : directory(cacheDirectory), variantHash(HashPath(variant)), capacityBytes(capacity), compression(spillCompression), pool(threadPool),
+          maxPendingStores(std::max<size_t>(threadPool.Size(), 1)) {
+        if (!SpillCompressionAvailable(compression)) {
+            std::cerr << "Built without LZ4, the spill cache stores raw frames" << std::endl;
+            compression = SpillCompression::Raw;
+        }
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        if (error) {
+            std::cerr << "Cannot create spill cache directory " << directory << ": " << error.message() << std::endl;
+            return;
+        }
+        enabled = true;
+        ScanDirectory();
+        std::cout << "Spill cache: " << directory << ", " << entries.size() << " frames, "
+                  << totalBytes / (1024 * 1024) << " / " << capacityBytes / (1024 * 1024) << " MB ("
+                  << (compression == SpillCompression::Lz4 ? "lz4" : "raw") << ")" << std::endl;
+    }
+
+    ~FrameSpillCache() {
+        std::unique_lock<std::mutex> lock(storeMutex);
+        storeDone.wait(lock, [this]() { return pendingStores == 0; });
+    }
+
+    FrameSpillCache(const FrameSpillCache&) = delete;
+    FrameSpillCache& operator=(const FrameSpillCache&) = delete;
+
+    bool Enabled() const { return enabled; }
+
+    // Loads the cached frame of an image; false on a miss
+    bool Load(const std::string& imagePath, cv::Mat& image) {
+        if (!enabled) return false;
+        int64_t sourceSize, sourceMtime;
+        uint64_t key = KeyOf(imagePath);
+        std::string name = FileName(key);
+        if (!StatSource(imagePath, sourceSize, sourceMtime) || !Contains(name)) {
+            CountMiss(false);
+            return false;
+        }
+
+        std::string cachePath = directory + "/" + name;
+        int fd = open(cachePath.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat info;
+        if (fd < 0 || fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(FileHeader)) {
+            if (fd >= 0) close(fd);
+            Forget(name, false);
+            CountMiss(false);
+            return false;
+        }
+        size_t length = (size_t)info.st_size;
+        // Private and writable, so in-place edits of the image copy pages
+        // instead of modifying the cache file
+        void* mapping = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED) {
+            CountMiss(false);
+            return false;
+        }
+        madvise(mapping, length, MADV_WILLNEED);
+
+        FileHeader header;
+        std::memcpy(&header, mapping, sizeof(header));
+        bool valid = std::memcmp(header.magic, kMagic, sizeof(kMagic)) == 0 && header.pathHash == key &&
+                     header.sourceSize == sourceSize && header.sourceMtime == sourceMtime && header.rows > 0 &&
+                     header.cols > 0 && sizeof(FileHeader) + header.payloadBytes == length &&
+                     header.rawBytes == (uint64_t)header.rows * header.cols * CV_ELEM_SIZE(header.type);
+        if (!valid) {
+            munmap(mapping, length);
+            Forget(name, true);
+            CountMiss(true);
+            return false;
+        }
+
+        unsigned char* bytes = static_cast<unsigned char*>(mapping);
+        bool loaded = false;
+        if (header.compression == (uint32_t)SpillCompression::Raw && header.payloadBytes == header.rawBytes) {
+            loaded = MappedFrameAllocator::Shared().Adopt(bytes, length, sizeof(FileHeader), header.rows, header.cols,
+                                                          header.type, image);
+        } else if (header.compression == (uint32_t)SpillCompression::Lz4) {
+#if defined(J_BBOX_HAVE_LZ4)
+            AllocationScope scope(AllocationTag::ImageDecode);
+            image.create(header.rows, header.cols, header.type);
+            int written = LZ4_decompress_safe(reinterpret_cast<const char*>(bytes + sizeof(FileHeader)),
+                                              reinterpret_cast<char*>(image.data), (int)header.payloadBytes,
+                                              (int)header.rawBytes);
+            loaded = written == (int)header.rawBytes;
+#endif
+            munmap(mapping, length);
+        } else {
+            munmap(mapping, length);
+        }
+        if (!loaded) {
+            image.release();
+            Forget(name, true);
+            CountMiss(true);
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.hits++;
+        stats.bytesLoaded += header.rawBytes;
+        auto it = entries.find(name);
+        if (it != entries.end()) it->second.lastUse = ++useCounter;
+        return true;
+    }
+
+    // Writes a decoded frame in the background. The Mat shares its pixels
+    // with the caller, who must not modify them afterwards.
+    void Store(const std::string& imagePath, const cv::Mat& image) {
+        if (!enabled || image.empty() || !image.isContinuous()) return;
+        {
+            std::lock_guard<std::mutex> lock(storeMutex);
+            if (pendingStores >= maxPendingStores) {
+                std::lock_guard<std::mutex> statsLock(mutex);
+                stats.skipped++;  // stored on a later pass instead
+                return;
+            }
+            pendingStores++;
+        }
+        pool.Submit([this, imagePath, image]() {
+            AllocationScope scope(AllocationTag::Caches);
+            Write(imagePath, image);
+            std::lock_guard<std::mutex> lock(storeMutex);
+            pendingStores--;
+            storeDone.notify_all();
+        });
+    }
+
+    Stats GetStats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stats;
+    }
+
+    uint64_t TotalBytes() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return totalBytes;
+    }
+
+    size_t FrameCount() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return entries.size();
+    }
+
+    uint64_t CapacityBytes() const { return capacityBytes; }
+    const std::string& Directory() const { return directory; }
+
+    std::string Describe() const {
+        Stats current = GetStats();
+        std::ostringstream text;
+        text << "Spill cache: " << current.hits << " hits, " << current.misses << " misses ("
+             << (int)(current.HitRate() * 100.0 + 0.5) << "% hit rate, " << current.stale << " stale), "
+             << current.stores << " stored, " << current.evictions << " evicted, "
+             << current.bytesLoaded / (1024 * 1024) << " MB loaded";
+        return text.str();
+    }
+
+private:
+    static uint64_t HashPath(const std::string& path) {
+        uint64_t hash = 1469598103934665603ull;  // FNV-1a
+        for (unsigned char c : path) {
+            hash = (hash ^ c) * 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // Entries are keyed by absolute path, so relative and absolute opens of
+    // an image share one frame, mixed with the variant so differently reduced
+    // frames of one image get different files
+    uint64_t KeyOf(const std::string& imagePath) const {
+        std::error_code error;
+        std::filesystem::path absolute = std::filesystem::absolute(imagePath, error);
+        uint64_t pathHash = HashPath(error ? imagePath : absolute.lexically_normal().string());
+        return (pathHash ^ variantHash) * 1099511628211ull;
+    }
+
+    static std::string FileName(uint64_t key) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.frame", (unsigned long long)key);
+        return name;
+    }
+
+    static bool StatSource(const std::string& imagePath, int64_t& size, int64_t& mtime) {
+        struct stat info;
+        if (stat(imagePath.c_str(), &info) != 0) return false;
+        size = (int64_t)info.st_size;
+        mtime = (int64_t)info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+        return true;
+    }
+
+    bool Contains(const std::string& name) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return entries.count(name) > 0;
+    }
+
+    void CountMiss(bool stale) {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.misses++;
+        if (stale) stats.stale++;
+    }
+
+    void Forget(const std::string& name, bool removeFile) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = entries.find(name);
+            if (it == entries.end()) return;
+            totalBytes -= it->second.bytes;
+            entries.erase(it);
+        }
+        if (removeFile) unlink((directory + "/" + name).c_str());
+    }
+
+    void Write(const std::string& imagePath, const cv::Mat& image) {
+        int64_t sourceSize, sourceMtime;
+        if (!StatSource(imagePath, sourceSize, sourceMtime)) return;
+        uint64_t rawBytes = (uint64_t)image.total() * image.elemSize();
+        if (sizeof(FileHeader) + rawBytes > capacityBytes) return;
+
+        uint64_t key = KeyOf(imagePath);
+        FileHeader header;
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.pathHash = key;
+        header.sourceSize = sourceSize;
+        header.sourceMtime = sourceMtime;
+        header.rows = image.rows;
+        header.cols = image.cols;
+        header.type = image.type();
+        header.compression = (uint32_t)SpillCompression::Raw;
+        header.rawBytes = rawBytes;
+
+        const char* payload = reinterpret_cast<const char*>(image.data);
+        header.payloadBytes = rawBytes;
+#if defined(J_BBOX_HAVE_LZ4)
+        std::vector<char> compressed;
+        if (compression == SpillCompression::Lz4 && rawBytes <= (uint64_t)LZ4_MAX_INPUT_SIZE) {
+            compressed.resize((size_t)LZ4_compressBound((int)rawBytes));
+            int size = LZ4_compress_default(payload, compressed.data(), (int)rawBytes, (int)compressed.size());
+            if (size > 0) {
+                header.compression = (uint32_t)SpillCompression::Lz4;
+                header.payloadBytes = (uint64_t)size;
+                payload = compressed.data();
+            }
+        }
+#endif
+
+        // Written under a temporary name and renamed, so readers never map a
+        // partial file. The name carries the writer's PID so another session
+        // sharing the directory can tell whether the write is still running.
+        std::string name = FileName(key);
+        std::ostringstream temporary;
+        temporary << directory << "/" << name << kTemporaryMarker << getpid() << "." << std::this_thread::get_id();
+        std::string temporaryPath = temporary.str();
+        int fd = open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) return;
+        bool ok = WriteAll(fd, reinterpret_cast<const char*>(&header), sizeof(header)) &&
+                  WriteAll(fd, payload, (size_t)header.payloadBytes);
+        ok = close(fd) == 0 && ok;
+        if (!ok || std::rename(temporaryPath.c_str(), (directory + "/" + name).c_str()) != 0) {
+            unlink(temporaryPath.c_str());
+            return;
+        }
+
+        uint64_t fileBytes = sizeof(header) + header.payloadBytes;
+        std::vector<std::string> evicted;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            Entry& entry = entries[name];
+            totalBytes = totalBytes - entry.bytes + fileBytes;
+            entry.bytes = fileBytes;
+            entry.lastUse = ++useCounter;
+            stats.stores++;
+            stats.bytesStored += fileBytes;
+            evicted = EvictLocked(name);
+        }
+        for (const std::string& victim : evicted) {
+            unlink((directory + "/" + victim).c_str());
+        }
+    }
+
+    static bool WriteAll(int fd, const char* data, size_t size) {
+        while (size > 0) {
+            ssize_t count = write(fd, data, size);
+            if (count < 0 && errno == EINTR) continue;
+            if (count <= 0) return false;
+            data += count;
+            size -= (size_t)count;
+        }
+        return true;
+    }
+
+    // Drops least recently used entries until the cache fits its capacity.
+    // A linear scan per victim is fine: the cache holds at most a few
+    // thousand full-resolution frames.
+    std::vector<std::string> EvictLocked(const std::string& keep) {
+        std::vector<std::string> evicted;
+        while (totalBytes > capacityBytes && entries.size() > 1) {
+            auto victim = entries.end();
+            for (auto it = entries.begin(); it != entries.end(); ++it) {
+                if (it->first == keep) continue;
+                if (victim == entries.end() || it->second.lastUse < victim->second.lastUse) victim = it;
+            }
+            if (victim == entries.end()) break;
+            totalBytes -= victim->second.bytes;
+            evicted.push_back(victim->first);
+            entries.erase(victim);
+            stats.evictions++;
+        }
+        return evicted;
+    }
+
+    // True if a temporary file was written by a process that is still
+    // running, such as another viewer session sharing the directory
+    static bool WriterRunning(const std::string& name) {
+        size_t marker = name.find(kTemporaryMarker);
+        if (marker == std::string::npos) return false;
+        const char* digits = name.c_str() + marker + std::strlen(kTemporaryMarker);
+        char* end = nullptr;
+        long pid = std::strtol(digits, &end, 10);
+        if (end == digits || *end != '.' || pid <= 0) return false;
+        return kill((pid_t)pid, 0) == 0 || errno == EPERM;
+    }
+
+    // Picks up frames from earlier sessions, oldest first, and removes
+    // temporaries left by an interrupted write
+    void ScanDirectory() {
+        std::vector<std::pair<int64_t, std::pair<std::string, uint64_t>>> found;
+        std::error_code error;
+        for (const auto& item : std::filesystem::directory_iterator(directory, error)) {
+            std::string name = item.path().filename().string();
+            struct stat info;
+            if (stat(item.path().c_str(), &info) != 0 || !S_ISREG(info.st_mode)) continue;
+            if (name.find(kTemporaryMarker) != std::string::npos) {
+                if (!WriterRunning(name)) unlink(item.path().c_str());
+            } else if (item.path().extension() == ".frame") {
+                int64_t mtime = (int64_t)info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+                found.push_back({mtime, {name, (uint64_t)info.st_size}});
+            }
+        }
+        std::sort(found.begin(), found.end());
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& file : found) {
+            Entry& entry = entries[file.second.first];
+            entry.bytes = file.second.second;
+            entry.lastUse = ++useCounter;
+            totalBytes += entry.bytes;
+        }
+        std::vector<std::string> evicted = EvictLocked(std::string());
+        for (const std::string& victim : evicted) {
+            unlink((directory + "/" + victim).c_str());
+        }
+        stats.evictions = 0;  // trimming to a smaller capacity is not an eviction of this session
+    }
+};
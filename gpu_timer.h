@@ -0,0 +1,202 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <GL/glew.h>
+#include <imgui.h>
+
+// GPU-side durations of one frame, in milliseconds. Regions that did not run
+// in the frame (no texture upload) are 0.
+struct GpuFrameTimes {
+    int64_t frame = -1;
+    double uploadMs = 0.0;   // glTexImage2D of the current image
+    double imageMs = 0.0;    // drawing the image quad
+    double overlayMs = 0.0;  // boxes, crosshair and file path overlay
+    double renderMs = 0.0;   // all of ImGui_ImplOpenGL3_RenderDrawData
+};
+
+// GL timer queries around texture upload and draw-list rendering.
+//
+// Markers are GL_TIMESTAMP queries (glQueryCounter) rather than
+// GL_TIME_ELAPSED ranges, so adjacent regions can share a boundary and
+// regions may nest inside the whole-frame range. Markers inside the ImGui draw
+// data are inserted as draw-list callbacks and fire when the backend reaches
+// them. Each frame uses its own set of queries from a ring of kLatency sets;
+// a set is read back when its slot comes round again, by which time the GPU
+// has normally finished it, so reading never stalls the pipeline. A set whose
+// results are still not available is dropped.
+class GpuTimer {
+public:
+    enum Marker {
+        UploadBegin,
+        UploadEnd,
+        ImageBegin,
+        ImageEnd,  // also the start of the overlay
+        OverlayEnd,
+        RenderBegin,
+        RenderEnd,
+        MarkerCount
+    };
+
+    static constexpr size_t kLatency = 4;
+
+private:
+    struct Slot {
+        GLuint queries[MarkerCount] = {};
+        bool written[MarkerCount] = {};
+        int64_t frame = -1;
+        bool pending = false;
+    };
+
+    struct MarkerRef {
+        GpuTimer* timer;
+        Marker marker;
+    };
+
+    Slot slots[kLatency];
+    MarkerRef refs[MarkerCount];
+    Slot* current = nullptr;
+    bool initialized = false;
+    bool supported = false;
+
+    std::vector<GpuFrameTimes> completed;
+    GpuFrameTimes latest;
+    uint64_t dropped = 0;
+
+public:
+    GpuTimer() {
+        for (int i = 0; i < MarkerCount; i++) {
+            refs[i] = {this, (Marker)i};
+        }
+    }
+
+    GpuTimer(const GpuTimer&) = delete;
+    GpuTimer& operator=(const GpuTimer&) = delete;
+
+    ~GpuTimer() {
+        Release();
+    }
+
+    // Starts recording markers for a frame. Collects the results of the frame
+    // that used this slot kLatency frames ago.
+    void BeginFrame(int64_t frame) {
+        if (!initialized) Initialize();
+        if (!supported) return;
+
+        Slot& slot = slots[frame % kLatency];
+        if (slot.pending) Collect(slot, false);
+        for (bool& written : slot.written) {
+            written = false;
+        }
+        slot.frame = frame;
+        slot.pending = true;
+        current = &slot;
+    }
+
+    void EndFrame() {
+        current = nullptr;
+    }
+
+    // Writes a timestamp now. Outside a frame this is ignored; a begin marker
+    // written twice in one frame keeps the first timestamp, an end marker the last.
+    void Mark(Marker marker) {
+        if (current == nullptr) return;
+        bool isBegin = marker == UploadBegin || marker == ImageBegin || marker == RenderBegin;
+        if (isBegin && current->written[marker]) return;
+        glQueryCounter(current->queries[marker], GL_TIMESTAMP);
+        current->written[marker] = true;
+    }
+
+    // Writes a timestamp when the backend renders this point of the draw list
+    void AddMarker(ImDrawList* drawList, Marker marker) {
+        if (!supported) return;
+        drawList->AddCallback(&GpuTimer::DrawCallback, &refs[marker]);
+    }
+
+    // Blocks until every pending frame is available; call before shutdown
+    void Finish() {
+        current = nullptr;
+        if (!supported) return;
+        while (true) {
+            Slot* oldest = nullptr;
+            for (Slot& slot : slots) {
+                if (slot.pending && (oldest == nullptr || slot.frame < oldest->frame)) oldest = &slot;
+            }
+            if (oldest == nullptr) break;
+            Collect(*oldest, true);
+        }
+    }
+
+    // Frames whose results arrived since the last call, oldest first
+    std::vector<GpuFrameTimes> TakeCompleted() {
+        std::vector<GpuFrameTimes> result;
+        result.swap(completed);
+        return result;
+    }
+
+    const GpuFrameTimes& Latest() const { return latest; }
+    uint64_t Dropped() const { return dropped; }
+    bool Supported() const { return supported; }
+
+    void Release() {
+        if (!initialized) return;
+        for (Slot& slot : slots) {
+            if (slot.queries[0] != 0) glDeleteQueries(MarkerCount, slot.queries);
+            slot = Slot();
+        }
+        current = nullptr;
+        initialized = false;
+        supported = false;
+    }
+
+private:
+    void Initialize() {
+        initialized = true;
+        // Timer queries are core since OpenGL 3.3
+        supported = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+        if (!supported) return;
+        for (Slot& slot : slots) {
+            glGenQueries(MarkerCount, slot.queries);
+        }
+    }
+
+    static void DrawCallback(const ImDrawList*, const ImDrawCmd* command) {
+        const MarkerRef* ref = static_cast<const MarkerRef*>(command->UserCallbackData);
+        ref->timer->Mark(ref->marker);
+    }
+
+    void Collect(Slot& slot, bool wait) {
+        slot.pending = false;
+        if (!wait) {
+            for (int i = 0; i < MarkerCount; i++) {
+                if (!slot.written[i]) continue;
+                GLuint available = 0;
+                glGetQueryObjectuiv(slot.queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+                if (!available) {
+                    dropped++;
+                    return;
+                }
+            }
+        }
+
+        GLuint64 stamps[MarkerCount] = {};
+        for (int i = 0; i < MarkerCount; i++) {
+            if (slot.written[i]) glGetQueryObjectui64v(slot.queries[i], GL_QUERY_RESULT, &stamps[i]);
+        }
+
+        GpuFrameTimes times;
+        times.frame = slot.frame;
+        times.uploadMs = Elapsed(slot, stamps, UploadBegin, UploadEnd);
+        times.imageMs = Elapsed(slot, stamps, ImageBegin, ImageEnd);
+        times.overlayMs = Elapsed(slot, stamps, ImageEnd, OverlayEnd);
+        times.renderMs = Elapsed(slot, stamps, RenderBegin, RenderEnd);
+        completed.push_back(times);
+        latest = times;
+    }
+
+    static double Elapsed(const Slot& slot, const GLuint64* stamps, Marker begin, Marker end) {
+        if (!slot.written[begin] || !slot.written[end] || stamps[end] < stamps[begin]) return 0.0;
+        return (double)(stamps[end] - stamps[begin]) / 1.0e6;
+    }
+};
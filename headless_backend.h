@@ -0,0 +1,298 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+#include <opencv2/opencv.hpp>
+
+#if defined(J_BBOX_HAVE_EGL)
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+// Offscreen OpenGL context for running the viewer without a display.
+//
+// Uses EGL on Mesa's surfaceless platform when available (llvmpipe works on
+// machines without a GPU or X server), falling back to the default EGL
+// display. The viewer renders into a framebuffer object that replaces the
+// window's default framebuffer; Bind() resizes it to the current display size.
+class HeadlessContext {
+private:
+#if defined(J_BBOX_HAVE_EGL)
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext context = EGL_NO_CONTEXT;
+    EGLSurface surface = EGL_NO_SURFACE;
+#endif
+    GLuint framebuffer = 0;
+    GLuint colorBuffer = 0;
+    int width = 0;
+    int height = 0;
+
+public:
+    HeadlessContext() = default;
+    HeadlessContext(const HeadlessContext&) = delete;
+    HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+    ~HeadlessContext() {
+        Destroy();
+    }
+
+    // Creates an OpenGL 3.3 core context and makes it current. GL entry points
+    // must be loaded (glewInit) before calling Bind().
+    bool Create() {
+#if defined(J_BBOX_HAVE_EGL)
+        display = OpenDisplay();
+        if (display == EGL_NO_DISPLAY) {
+            std::cerr << "Failed to open an EGL display" << std::endl;
+            return false;
+        }
+
+        EGLint major = 0, minor = 0;
+        if (!eglInitialize(display, &major, &minor)) {
+            std::cerr << "Failed to initialize EGL: 0x" << std::hex << eglGetError() << std::dec << std::endl;
+            display = EGL_NO_DISPLAY;
+            return false;
+        }
+        if (!eglBindAPI(EGL_OPENGL_API)) {
+            std::cerr << "EGL display does not support desktop OpenGL" << std::endl;
+            Destroy();
+            return false;
+        }
+
+        const EGLint configAttributes[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+            EGL_NONE
+        };
+        EGLConfig config = nullptr;
+        EGLint configCount = 0;
+        if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0) {
+            std::cerr << "No suitable EGL config" << std::endl;
+            Destroy();
+            return false;
+        }
+
+        const EGLint contextAttributes[] = {
+            EGL_CONTEXT_MAJOR_VERSION, 3,
+            EGL_CONTEXT_MINOR_VERSION, 3,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+        };
+        context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+        if (context == EGL_NO_CONTEXT) {
+            std::cerr << "Failed to create EGL context: 0x" << std::hex << eglGetError() << std::dec << std::endl;
+            Destroy();
+            return false;
+        }
+
+        // Rendering goes to our own framebuffer, so no surface is needed where surfaceless contexts are supported
+        if (!HasExtension(eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context")) {
+            const EGLint surfaceAttributes[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+            surface = eglCreatePbufferSurface(display, config, surfaceAttributes);
+        }
+        if (!eglMakeCurrent(display, surface, surface, context)) {
+            std::cerr << "Failed to make EGL context current: 0x" << std::hex << eglGetError() << std::dec << std::endl;
+            Destroy();
+            return false;
+        }
+
+        std::cout << "Headless EGL " << major << "." << minor << " context: " << eglQueryString(display, EGL_VENDOR)
+                  << std::endl;
+        return true;
+#else
+        std::cerr << "Headless rendering is not available: built without EGL" << std::endl;
+        return false;
+#endif
+    }
+
+    // Binds the offscreen framebuffer, (re)allocating it at the given size
+    void Bind(int newWidth, int newHeight) {
+        newWidth = std::max(newWidth, 1);
+        newHeight = std::max(newHeight, 1);
+        if (framebuffer == 0) {
+            glGenFramebuffers(1, &framebuffer);
+            glGenRenderbuffers(1, &colorBuffer);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        if (newWidth != width || newHeight != height) {
+            width = newWidth;
+            height = newHeight;
+            glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+            glBindRenderbuffer(GL_RENDERBUFFER, 0);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+                std::cerr << "Offscreen framebuffer is incomplete" << std::endl;
+            }
+        }
+    }
+
+    int Width() const { return width; }
+    int Height() const { return height; }
+
+    void Destroy() {
+#if defined(J_BBOX_HAVE_EGL)
+        if (display == EGL_NO_DISPLAY) return;
+        if (context != EGL_NO_CONTEXT && framebuffer != 0) {
+            glDeleteRenderbuffers(1, &colorBuffer);
+            glDeleteFramebuffers(1, &framebuffer);
+        }
+        framebuffer = colorBuffer = 0;
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (surface != EGL_NO_SURFACE) eglDestroySurface(display, surface);
+        if (context != EGL_NO_CONTEXT) eglDestroyContext(display, context);
+        eglTerminate(display);
+        display = EGL_NO_DISPLAY;
+        context = EGL_NO_CONTEXT;
+        surface = EGL_NO_SURFACE;
+#endif
+    }
+
+private:
+    static bool HasExtension(const char* extensions, const char* name) {
+        if (extensions == nullptr) return false;
+        size_t length = std::strlen(name);
+        for (const char* cursor = std::strstr(extensions, name); cursor != nullptr; cursor = std::strstr(cursor + length, name)) {
+            bool startsWord = cursor == extensions || cursor[-1] == ' ';
+            bool endsWord = cursor[length] == ' ' || cursor[length] == '\0';
+            if (startsWord && endsWord) return true;
+        }
+        return false;
+    }
+
+#if defined(J_BBOX_HAVE_EGL)
+    static EGLDisplay OpenDisplay() {
+        const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+        if (HasExtension(clientExtensions, "EGL_MESA_platform_surfaceless")) {
+            auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+            if (getPlatformDisplay != nullptr) {
+                EGLDisplay surfaceless = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+                if (surfaceless != EGL_NO_DISPLAY) return surfaceless;
+            }
+        }
+        return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+#endif
+};
+
+// Asynchronous framebuffer readback through a ring of pixel buffer objects.
+//
+// Queue() starts a glReadPixels into the next PBO and returns immediately; the
+// copy completes on the GPU while later frames are rendered. Completed frames
+// are delivered in order by Poll() (non-blocking) or Finish() (waits for all).
+// Only when every PBO is still in flight does Queue() wait for the oldest.
+class PboReadback {
+public:
+    // Receives a top-down RGBA image that the callback may keep
+    using FrameCallback = std::function<void(int64_t frame, const cv::Mat& rgba)>;
+
+private:
+    struct Slot {
+        GLuint buffer = 0;
+        GLsync fence = nullptr;
+        size_t capacity = 0;
+        int width = 0;
+        int height = 0;
+        int64_t frame = -1;
+    };
+
+    std::vector<Slot> slots;
+    size_t oldest = 0;
+    size_t pending = 0;
+    FrameCallback callback;
+
+public:
+    explicit PboReadback(FrameCallback frameCallback, size_t depth = 3)
+        : slots(std::max<size_t>(depth, 1)), callback(std::move(frameCallback)) {}
+
+    PboReadback(const PboReadback&) = delete;
+    PboReadback& operator=(const PboReadback&) = delete;
+
+    ~PboReadback() {
+        Release();
+    }
+
+    // Reads the currently bound read framebuffer
+    void Queue(int64_t frame, int width, int height) {
+        if (pending == slots.size()) {
+            Complete(slots[oldest], GL_TIMEOUT_IGNORED);
+        }
+
+        Slot& slot = slots[(oldest + pending) % slots.size()];
+        size_t size = (size_t)width * height * 4;
+        if (slot.buffer == 0) glGenBuffers(1, &slot.buffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        if (slot.capacity < size) {
+            glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+            slot.capacity = size;
+        }
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        slot.width = width;
+        slot.height = height;
+        slot.frame = frame;
+        pending++;
+    }
+
+    // Delivers every frame whose copy has already finished
+    void Poll() {
+        while (pending > 0 && Complete(slots[oldest], 0)) {
+        }
+    }
+
+    void Finish() {
+        while (pending > 0) {
+            Complete(slots[oldest], GL_TIMEOUT_IGNORED);
+        }
+    }
+
+    size_t Pending() const { return pending; }
+
+    // Delivers outstanding frames and frees the buffers; call while the context is still current
+    void Release() {
+        Finish();
+        for (Slot& slot : slots) {
+            if (slot.buffer != 0) glDeleteBuffers(1, &slot.buffer);
+            slot.buffer = 0;
+            slot.capacity = 0;
+        }
+    }
+
+private:
+    bool Complete(Slot& slot, GLuint64 timeout) {
+        GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+        if (status == GL_TIMEOUT_EXPIRED) return false;
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        size_t size = (size_t)slot.width * slot.height * 4;
+        void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+        if (data != nullptr && status != GL_WAIT_FAILED) {
+            // OpenGL rows start at the bottom
+            cv::Mat rgba;
+            cv::flip(cv::Mat(slot.height, slot.width, CV_8UC4, data), rgba, 0);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            if (callback) callback(slot.frame, rgba);
+        } else {
+            if (data != nullptr) glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            std::cerr << "Frame readback failed for frame " << slot.frame << std::endl;
+        }
+
+        oldest = (oldest + 1) % slots.size();
+        pending--;
+        return true;
+    }
+};
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+// Reads image dimensions from the file header without decoding pixels.
+// Supports the formats ScanDirectory picks up: JPEG, PNG, BMP, TIFF and TGA.
+// Returns false if the header is truncated or the format is not recognised.
+inline bool ProbeImageSize(const std::string& path, int& width, int& height) {
+    width = 0;
+    height = 0;
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) return false;
+
+    unsigned char header[32] = {0};
+    file.read(reinterpret_cast<char*>(header), sizeof(header));
+    std::streamsize headerLength = file.gcount();
+    if (headerLength < 18) return false;
+
+    auto readBE16 = [](const unsigned char* p) { return (p[0] << 8) | p[1]; };
+    auto readBE32 = [](const unsigned char* p) {
+        return (int)(((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3]);
+    };
+    auto readLE16 = [](const unsigned char* p) { return p[0] | (p[1] << 8); };
+    auto readLE32 = [](const unsigned char* p) {
+        return (int32_t)((uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+    };
+
+    // PNG: signature followed by the IHDR chunk
+    static const unsigned char pngSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    if (headerLength >= 24 && std::memcmp(header, pngSignature, 8) == 0 && std::memcmp(header + 12, "IHDR", 4) == 0) {
+        width = readBE32(header + 16);
+        height = readBE32(header + 20);
+        return width > 0 && height > 0;
+    }
+
+    // BMP: BITMAPINFOHEADER width/height (height is negative for top-down bitmaps)
+    if (header[0] == 'B' && header[1] == 'M' && headerLength >= 26) {
+        width = readLE32(header + 18);
+        height = readLE32(header + 22);
+        if (height < 0) height = -height;
+        return width > 0 && height > 0;
+    }
+
+    // JPEG: walk the marker segments until a start-of-frame marker
+    if (header[0] == 0xFF && header[1] == 0xD8) {
+        file.clear();
+        file.seekg(2);
+        unsigned char marker[2];
+        while (file.read(reinterpret_cast<char*>(marker), 2)) {
+            if (marker[0] != 0xFF) return false;
+            // Skip fill bytes
+            while (marker[1] == 0xFF) {
+                if (!file.read(reinterpret_cast<char*>(&marker[1]), 1)) return false;
+            }
+            unsigned char type = marker[1];
+            // Standalone markers have no length field
+            if (type == 0xD8 || type == 0x01 || (type >= 0xD0 && type <= 0xD7)) continue;
+            if (type == 0xD9 || type == 0xDA) return false;  // end of image / start of scan before any SOF
+
+            unsigned char lengthBytes[2];
+            if (!file.read(reinterpret_cast<char*>(lengthBytes), 2)) return false;
+            int segmentLength = readBE16(lengthBytes);
+            if (segmentLength < 2) return false;
+
+            bool isStartOfFrame = type >= 0xC0 && type <= 0xCF && type != 0xC4 && type != 0xC8 && type != 0xCC;
+            if (isStartOfFrame) {
+                unsigned char frame[5];
+                if (!file.read(reinterpret_cast<char*>(frame), 5)) return false;
+                height = readBE16(frame + 1);
+                width = readBE16(frame + 3);
+                return width > 0 && height > 0;
+            }
+            file.seekg(segmentLength - 2, std::ios::cur);
+        }
+        return false;
+    }
+
+    // TIFF: scan the first IFD for ImageWidth (256) and ImageLength (257)
+    bool tiffLittle = header[0] == 'I' && header[1] == 'I' && header[2] == 42 && header[3] == 0;
+    bool tiffBig = header[0] == 'M' && header[1] == 'M' && header[2] == 0 && header[3] == 42;
+    if (tiffLittle || tiffBig) {
+        auto read16 = [&](const unsigned char* p) { return tiffLittle ? readLE16(p) : readBE16(p); };
+        auto read32 = [&](const unsigned char* p) { return tiffLittle ? readLE32(p) : readBE32(p); };
+
+        int ifdOffset = read32(header + 4);
+        file.clear();
+        file.seekg(ifdOffset);
+        unsigned char countBytes[2];
+        if (!file.read(reinterpret_cast<char*>(countBytes), 2)) return false;
+        int entryCount = read16(countBytes);
+        for (int i = 0; i < entryCount && (width == 0 || height == 0); i++) {
+            unsigned char entry[12];
+            if (!file.read(reinterpret_cast<char*>(entry), 12)) return false;
+            int tag = read16(entry);
+            int fieldType = read16(entry + 2);
+            int value = fieldType == 3 ? read16(entry + 8) : read32(entry + 8);  // SHORT or LONG
+            if (tag == 256) width = value;
+            if (tag == 257) height = value;
+        }
+        return width > 0 && height > 0;
+    }
+
+    // TGA has no magic number; accept it only for uncompressed/RLE true-color or grayscale images
+    int tgaImageType = header[2];
+    bool tgaKnownType = tgaImageType == 2 || tgaImageType == 3 || tgaImageType == 10 || tgaImageType == 11;
+    if (tgaKnownType && header[1] == 0) {
+        width = readLE16(header + 12);
+        height = readLE16(header + 14);
+        return width > 0 && height > 0;
+    }
+
+    return false;
+}
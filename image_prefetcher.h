@@ -0,0 +1,146 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "allocation_tracker.h"
+#include "thread_pool.h"
+
+// Decodes images on the shared thread pool ahead of navigation.
+//
+// Request() starts decoding a file in the background; Acquire() returns the
+// decoded image, waiting only for whatever part of the decode is still
+// running. Requesting several files before acquiring any of them decodes them
+// in parallel. Entries stay cached until Retain() is called with a set that
+// no longer contains them. Only the UI thread may call into the prefetcher;
+// workers only write the image of the entry they were started for. The
+// destructor waits for every decode it started, including dropped ones, so
+// whatever the decode function uses only has to outlive the prefetcher.
+class ImagePrefetcher {
+public:
+    // Decodes path into an image ready for display; must be thread-safe
+    using DecodeFn = std::function<bool(const std::string& path, cv::Mat& image)>;
+
+private:
+    struct Result {
+        cv::Mat image;
+        bool ok = false;
+    };
+
+    struct Entry {
+        std::shared_ptr<Result> result;
+        std::shared_future<void> done;
+    };
+
+    DecodeFn decode;
+    ThreadPool& pool;
+    std::unordered_map<std::string, Entry> entries;
+    std::vector<std::shared_future<void>> retired;  // dropped by Retain() while still decoding
+
+    uint64_t hits = 0;    // Acquire() found the decode already finished
+    uint64_t waits = 0;   // Acquire() had to wait for a running decode
+    uint64_t misses = 0;  // Acquire() of a file that was never requested
+
+public:
+    explicit ImagePrefetcher(DecodeFn decodeFn, ThreadPool& threadPool = ThreadPool::Shared())
+        : decode(std::move(decodeFn)), pool(threadPool) {}
+
+    ImagePrefetcher(const ImagePrefetcher&) = delete;
+    ImagePrefetcher& operator=(const ImagePrefetcher&) = delete;
+
+    ~ImagePrefetcher() {
+        for (auto& entry : entries) {
+            entry.second.done.wait();
+        }
+        for (auto& done : retired) {
+            done.wait();
+        }
+    }
+
+    void Request(const std::string& path) {
+        if (path.empty() || entries.count(path) > 0) return;
+        Entry entry;
+        entry.result = std::make_shared<Result>();
+        DecodeFn decodeFn = decode;
+        std::shared_ptr<Result> result = entry.result;
+        entry.done = pool.Submit([decodeFn, path, result]() {
+            AllocationScope scope(AllocationTag::ImageDecode);
+            result->ok = decodeFn(path, result->image);
+        }).share();
+        entries.emplace(path, std::move(entry));
+    }
+
+    bool Acquire(const std::string& path, cv::Mat& image) {
+        auto it = entries.find(path);
+        if (it == entries.end()) {
+            misses++;
+            Request(path);
+            it = entries.find(path);
+        } else if (Finished(it->second.done)) {
+            hits++;
+        } else {
+            waits++;
+        }
+        it->second.done.wait();
+        if (!it->second.result->ok) {
+            entries.erase(it);  // retried on the next request
+            return false;
+        }
+        image = it->second.result->image;
+        return true;
+    }
+
+    // True once the decode of a requested path has finished, so Acquire()
+    // returns without waiting
+    bool Ready(const std::string& path) const {
+        auto it = entries.find(path);
+        return it != entries.end() && Finished(it->second.done);
+    }
+
+    // Drops every entry not in keep. Decodes still running finish in the
+    // background and their results are discarded.
+    void Retain(const std::vector<std::string>& keep) {
+        retired.erase(std::remove_if(retired.begin(), retired.end(), Finished), retired.end());
+
+        std::unordered_set<std::string> wanted(keep.begin(), keep.end());
+        for (auto it = entries.begin(); it != entries.end();) {
+            if (wanted.count(it->first) == 0) {
+                it = Drop(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    // Drops the entry of one file, e.g. after acquiring it when nothing is
+    // prefetched and Retain() is never called
+    void Release(const std::string& path) {
+        auto it = entries.find(path);
+        if (it != entries.end()) Drop(it);
+    }
+
+    size_t Size() const { return entries.size(); }
+    uint64_t Hits() const { return hits; }
+    uint64_t Waits() const { return waits; }
+    uint64_t Misses() const { return misses; }
+
+private:
+    static bool Finished(const std::shared_future<void>& done) {
+        return done.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    std::unordered_map<std::string, Entry>::iterator Drop(std::unordered_map<std::string, Entry>::iterator it) {
+        if (!Finished(it->second.done)) retired.push_back(it->second.done);
+        return entries.erase(it);
+    }
+};
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <imgui.h>
+#include <imgui_internal.h>
+
+// Input recording and deterministic replay.
+//
+// Recording copies ImGui's input event queue once per frame, after the
+// platform backend has translated GLFW callbacks and before ImGui::NewFrame
+// consumes them, together with the frame's delta time and display size.
+// Replay discards live input and feeds the recorded events back through the
+// public io.Add*Event API with the recorded timing, so every frame sees the
+// same input, clicks and key repeats regardless of how fast it renders.
+//
+// File format (text, one record per line):
+//   j_bbox_input 1
+//   dataset <path>
+//   frame <delta_time> <display_w> <display_h> <framebuffer_scale_x> <framebuffer_scale_y>
+//   m <x> <y>            mouse position
+//   b <button> <0|1>     mouse button
+//   w <dx> <dy>          mouse wheel
+//   k <imgui_key> <0|1>  key or modifier
+//   c <codepoint>        text input
+//   f <0|1>              window focus
+struct RecordedInput {
+    char type = 0;
+    float x = 0.0f, y = 0.0f;
+    int code = 0;
+    bool down = false;
+};
+
+struct RecordedFrame {
+    float deltaTime = 1.0f / 60.0f;
+    ImVec2 displaySize;
+    ImVec2 framebufferScale = ImVec2(1.0f, 1.0f);
+    std::vector<RecordedInput> inputs;
+};
+
+class InputRecorder {
+private:
+    std::ofstream file;
+    size_t frames = 0;
+
+public:
+    bool Open(const std::string& path, const std::string& datasetPath) {
+        file.open(path);
+        if (!file.is_open()) {
+            std::cerr << "Failed to open input recording: " << path << std::endl;
+            return false;
+        }
+        file << "j_bbox_input 1\n";
+        file << "dataset " << datasetPath << "\n";
+        std::cout << "Recording input to: " << path << std::endl;
+        return true;
+    }
+
+    bool IsOpen() const { return file.is_open(); }
+    size_t FrameCount() const { return frames; }
+
+    // Call after the platform backend's NewFrame and before ImGui::NewFrame
+    void CaptureFrame() {
+        if (!file.is_open()) return;
+
+        ImGuiIO& io = ImGui::GetIO();
+        char line[160];
+        std::snprintf(line, sizeof(line), "frame %.9g %.9g %.9g %.9g %.9g\n", io.DeltaTime, io.DisplaySize.x,
+                      io.DisplaySize.y, io.DisplayFramebufferScale.x, io.DisplayFramebufferScale.y);
+        file << line;
+
+        for (const ImGuiInputEvent& event : GImGui->InputEventsQueue) {
+            switch (event.Type) {
+                case ImGuiInputEventType_MousePos:
+                    std::snprintf(line, sizeof(line), "m %.9g %.9g\n", event.MousePos.PosX, event.MousePos.PosY);
+                    break;
+                case ImGuiInputEventType_MouseButton:
+                    std::snprintf(line, sizeof(line), "b %d %d\n", event.MouseButton.Button, (int)event.MouseButton.Down);
+                    break;
+                case ImGuiInputEventType_MouseWheel:
+                    std::snprintf(line, sizeof(line), "w %.9g %.9g\n", event.MouseWheel.WheelX, event.MouseWheel.WheelY);
+                    break;
+                case ImGuiInputEventType_Key:
+                    std::snprintf(line, sizeof(line), "k %d %d\n", (int)event.Key.Key, (int)event.Key.Down);
+                    break;
+                case ImGuiInputEventType_Text:
+                    std::snprintf(line, sizeof(line), "c %u\n", event.Text.Char);
+                    break;
+                case ImGuiInputEventType_Focus:
+                    std::snprintf(line, sizeof(line), "f %d\n", (int)event.AppFocused.Focused);
+                    break;
+                default:
+                    continue;
+            }
+            file << line;
+        }
+        frames++;
+    }
+
+    void Close() {
+        if (!file.is_open()) return;
+        file.close();
+        std::cout << "Recorded " << frames << " frames of input" << std::endl;
+    }
+};
+
+class InputReplayer {
+private:
+    std::string datasetPath;
+    std::vector<RecordedFrame> frames;
+    size_t nextFrame = 0;
+
+public:
+    bool Load(const std::string& path) {
+        std::ifstream file(path);
+        if (!file.is_open()) {
+            std::cerr << "Failed to open input recording: " << path << std::endl;
+            return false;
+        }
+
+        std::string line;
+        if (!std::getline(file, line) || line != "j_bbox_input 1") {
+            std::cerr << "Not an input recording: " << path << std::endl;
+            return false;
+        }
+
+        frames.clear();
+        nextFrame = 0;
+        int lineNumber = 1;
+        while (std::getline(file, line)) {
+            lineNumber++;
+            if (line.empty()) continue;
+            if (line.rfind("dataset ", 0) == 0) {
+                datasetPath = line.substr(8);
+                continue;
+            }
+
+            std::istringstream fields(line);
+            std::string tag;
+            fields >> tag;
+            if (tag == "frame") {
+                RecordedFrame frame;
+                fields >> frame.deltaTime >> frame.displaySize.x >> frame.displaySize.y >> frame.framebufferScale.x >>
+                    frame.framebufferScale.y;
+                frames.push_back(frame);
+            } else if (tag.size() == 1 && !frames.empty()) {
+                RecordedInput input;
+                input.type = tag[0];
+                int down = 0;
+                switch (input.type) {
+                    case 'm':
+                    case 'w': fields >> input.x >> input.y; break;
+                    case 'b':
+                    case 'k': fields >> input.code >> down; break;
+                    case 'c': fields >> input.code; break;
+                    case 'f': fields >> down; break;
+                    default: fields.setstate(std::ios::failbit); break;
+                }
+                input.down = down != 0;
+                if (fields.fail()) {
+                    std::cerr << "Malformed input record at line " << lineNumber << ": " << line << std::endl;
+                    return false;
+                }
+                frames.back().inputs.push_back(input);
+            } else {
+                std::cerr << "Malformed input record at line " << lineNumber << ": " << line << std::endl;
+                return false;
+            }
+        }
+
+        std::cout << "Loaded " << frames.size() << " frames of recorded input" << std::endl;
+        return true;
+    }
+
+    const std::string& DatasetPath() const { return datasetPath; }
+    size_t FrameCount() const { return frames.size(); }
+    size_t FrameIndex() const { return nextFrame; }
+    bool Finished() const { return nextFrame >= frames.size(); }
+
+    // Replaces this frame's live input with the next recorded frame. Call in
+    // place of the platform backend's NewFrame, before ImGui::NewFrame.
+    void ApplyNextFrame() {
+        if (Finished()) return;
+        const RecordedFrame& frame = frames[nextFrame++];
+
+        ImGuiIO& io = ImGui::GetIO();
+        GImGui->InputEventsQueue.resize(0);
+        io.DeltaTime = frame.deltaTime > 0.0f ? frame.deltaTime : 1.0f / 60.0f;
+        io.DisplaySize = frame.displaySize;
+        io.DisplayFramebufferScale = frame.framebufferScale;
+
+        for (const RecordedInput& input : frame.inputs) {
+            switch (input.type) {
+                case 'm': io.AddMousePosEvent(input.x, input.y); break;
+                case 'b': io.AddMouseButtonEvent(input.code, input.down); break;
+                case 'w': io.AddMouseWheelEvent(input.x, input.y); break;
+                case 'k': io.AddKeyEvent((ImGuiKey)input.code, input.down); break;
+                case 'c': io.AddInputCharacter((unsigned int)input.code); break;
+                case 'f': io.AddFocusEvent(input.down); break;
+            }
+        }
+    }
+};
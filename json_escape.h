@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+
+// Escapes text for a JSON string literal: quotes, backslashes and control
+// characters. Shared by the validation report and the event stream.
+inline std::string JsonEscape(const std::string& text) {
+    std::string escaped;
+    escaped.reserve(text.size());
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if ((unsigned char)c < 0x20) {
+            char buffer[8];
+            std::snprintf(buffer, sizeof(buffer), "\\u%04x", (unsigned char)c);
+            escaped += buffer;
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
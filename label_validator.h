@@ -0,0 +1,378 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "annotation_index.h"
+#include "image_header.h"
+#include "json_escape.h"
+#include "oriented_box.h"
+#include "thread_pool.h"
+
+enum class LabelIssue {
+    UnreadableImage,    // image header could not be probed, bounds are not checked
+    UnreadableSidecar,  // sidecar exists but cannot be opened
+    StrayHeader,        // text row after the first line
+    MalformedRow,       // fewer than four columns or a non-numeric value
+    NonFinite,          // NaN or infinite coordinate
+    Inverted,           // x_min > x_max or y_min > y_max
+    ZeroArea,           // zero width or height
+    OutOfBounds,        // coordinate or rotated corner outside [0, width] x [0, height]
+    InvalidClass,       // class column that is not an integer in [0, 65535]
+    InvalidAngle,       // angle column that is not a finite number of degrees
+    Count
+};
+
+inline const char* LabelIssueName(LabelIssue issue) {
+    switch (issue) {
+        case LabelIssue::UnreadableImage: return "unreadable_image";
+        case LabelIssue::UnreadableSidecar: return "unreadable_sidecar";
+        case LabelIssue::StrayHeader: return "stray_header";
+        case LabelIssue::MalformedRow: return "malformed_row";
+        case LabelIssue::NonFinite: return "non_finite";
+        case LabelIssue::Inverted: return "inverted";
+        case LabelIssue::ZeroArea: return "zero_area";
+        case LabelIssue::OutOfBounds: return "out_of_bounds";
+        case LabelIssue::InvalidClass: return "invalid_class";
+        case LabelIssue::InvalidAngle: return "invalid_angle";
+        default: return "unknown";
+    }
+}
+
+struct LabelFinding {
+    std::string imagePath;
+    std::string csvPath;
+    int line = 0;           // 1-based line in the sidecar, 0 for file-level findings
+    LabelIssue issue = LabelIssue::MalformedRow;
+    std::string detail;
+    std::string fix;        // action taken with --fix: "clamped", "shrunk", "swapped", "removed", "reset" or empty
+};
+
+struct ValidationReport {
+    std::string directory;
+    size_t images = 0;
+    size_t sidecars = 0;
+    size_t boxes = 0;
+    size_t filesRewritten = 0;
+    double seconds = 0.0;
+    std::vector<LabelFinding> findings;
+
+    std::vector<size_t> CountByIssue() const {
+        std::vector<size_t> counts((size_t)LabelIssue::Count, 0);
+        for (const auto& finding : findings) {
+            counts[(size_t)finding.issue]++;
+        }
+        return counts;
+    }
+
+    bool WriteJSON(const std::string& path) const {
+        std::ofstream out(path);
+        if (!out.is_open()) {
+            std::cerr << "Failed to write validation report: " << path << std::endl;
+            return false;
+        }
+
+        std::vector<size_t> counts = CountByIssue();
+        out << "{\n";
+        out << "  \"directory\": \"" << JsonEscape(directory) << "\",\n";
+        out << "  \"images\": " << images << ",\n";
+        out << "  \"sidecars\": " << sidecars << ",\n";
+        out << "  \"boxes\": " << boxes << ",\n";
+        out << "  \"files_rewritten\": " << filesRewritten << ",\n";
+        out << "  \"counts\": {";
+        for (size_t i = 0; i < counts.size(); i++) {
+            out << (i ? ", " : "") << "\"" << LabelIssueName((LabelIssue)i) << "\": " << counts[i];
+        }
+        out << "},\n";
+        out << "  \"findings\": [";
+        for (size_t i = 0; i < findings.size(); i++) {
+            const LabelFinding& f = findings[i];
+            out << (i ? "," : "") << "\n    {\"image\": \"" << JsonEscape(f.imagePath) << "\", \"csv\": \""
+                << JsonEscape(f.csvPath) << "\", \"line\": " << f.line << ", \"class\": \"" << LabelIssueName(f.issue)
+                << "\", \"detail\": \"" << JsonEscape(f.detail) << "\", \"fix\": \"" << f.fix << "\"}";
+        }
+        out << (findings.empty() ? "]\n" : "\n  ]\n");
+        out << "}\n";
+        return true;
+    }
+
+    bool WriteCSV(const std::string& path) const {
+        std::ofstream out(path);
+        if (!out.is_open()) {
+            std::cerr << "Failed to write validation report: " << path << std::endl;
+            return false;
+        }
+
+        out << "image,csv,line,class,detail,fix" << std::endl;
+        for (const LabelFinding& f : findings) {
+            out << CsvQuote(f.imagePath) << "," << CsvQuote(f.csvPath) << "," << f.line << "," << LabelIssueName(f.issue)
+                << "," << CsvQuote(f.detail) << "," << f.fix << std::endl;
+        }
+        return true;
+    }
+
+    static std::string CsvQuote(const std::string& text) {
+        if (text.find_first_of(",\"\n") == std::string::npos) return text;
+        std::string quoted = "\"";
+        for (char c : text) {
+            if (c == '"') quoted += '"';
+            quoted += c;
+        }
+        return quoted + "\"";
+    }
+};
+
+// Headless sidecar checker. Every image in a directory is checked in parallel
+// against its header-probed size; with fix enabled, boxes are normalized and
+// clamped exactly like SaveBoundingBoxToCSV (rotated boxes are then shrunk
+// until their corners fit) and rows that cannot be repaired are dropped
+// before the sidecar is rewritten.
+class LabelValidator {
+private:
+    bool fix = false;
+    ThreadPool& pool;
+
+public:
+    explicit LabelValidator(bool applyFixes, ThreadPool& threadPool = ThreadPool::Shared())
+        : fix(applyFixes), pool(threadPool) {}
+
+    ValidationReport ValidateDirectory(const std::string& directory) {
+        ValidationReport report;
+        report.directory = directory;
+        auto startTime = std::chrono::steady_clock::now();
+
+        std::vector<std::string> images = ListImageFiles(directory);
+        report.images = images.size();
+
+        struct ImageResult {
+            std::vector<LabelFinding> findings;
+            size_t boxes = 0;
+            bool hasSidecar = false;
+            bool rewritten = false;
+        };
+        std::vector<ImageResult> results(images.size());
+
+        pool.ParallelFor(0, images.size(), [&](size_t begin, size_t end, size_t) {
+            for (size_t i = begin; i < end; i++) {
+                ImageResult& result = results[i];
+                result.hasSidecar = ValidateImage(images[i], result.findings, result.boxes, result.rewritten);
+            }
+        }, 16);
+
+        for (auto& result : results) {
+            report.sidecars += result.hasSidecar ? 1 : 0;
+            report.boxes += result.boxes;
+            report.filesRewritten += result.rewritten ? 1 : 0;
+            for (auto& finding : result.findings) {
+                report.findings.push_back(std::move(finding));
+            }
+        }
+        report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        return report;
+    }
+
+private:
+    // Returns true if the image has a sidecar
+    bool ValidateImage(const std::string& imagePath, std::vector<LabelFinding>& findings, size_t& boxCount,
+                       bool& rewritten) const {
+        std::string csvPath = CsvPathForImage(imagePath);
+        std::error_code error;
+        if (!std::filesystem::exists(csvPath, error)) return false;
+
+        auto report = [&](int line, LabelIssue issue, const std::string& detail, const std::string& action) {
+            findings.push_back({imagePath, csvPath, line, issue, detail, action});
+        };
+
+        int width = 0, height = 0;
+        bool hasSize = ProbeImageSize(imagePath, width, height);
+        if (!hasSize) {
+            report(0, LabelIssue::UnreadableImage, "image header could not be read; bounds not checked", "");
+        }
+
+        std::ifstream csvFile(csvPath);
+        if (!csvFile.is_open()) {
+            report(0, LabelIssue::UnreadableSidecar, "cannot open sidecar", "");
+            return true;
+        }
+
+        std::vector<BoxRecord> keptBoxes;
+        bool changed = false;
+        std::string line;
+        int lineNumber = 0;
+        while (std::getline(csvFile, line)) {
+            lineNumber++;
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (line.find_first_not_of(" \t") == std::string::npos) continue;
+
+            std::vector<std::string> tokens;
+            std::stringstream ss(line);
+            std::string token;
+            while (std::getline(ss, token, ',')) {
+                tokens.push_back(token);
+            }
+
+            double values[4];
+            int numeric = 0;
+            for (size_t t = 0; t < tokens.size() && t < 4; t++) {
+                if (!ParseNumber(tokens[t], values[t])) break;
+                numeric++;
+            }
+
+            bool hasLetters = std::any_of(line.begin(), line.end(), [](char c) { return std::isalpha((unsigned char)c); });
+            if (numeric < 4 && hasLetters) {
+                // The first text line is the expected header
+                if (lineNumber > 1) {
+                    report(lineNumber, LabelIssue::StrayHeader, line, fix ? "removed" : "");
+                    changed = true;
+                }
+                continue;
+            }
+            if (numeric < 4) {
+                report(lineNumber, LabelIssue::MalformedRow, line, fix ? "removed" : "");
+                changed = true;
+                continue;
+            }
+            boxCount++;
+
+            if (!std::isfinite(values[0]) || !std::isfinite(values[1]) || !std::isfinite(values[2]) || !std::isfinite(values[3])) {
+                report(lineNumber, LabelIssue::NonFinite, line, fix ? "removed" : "");
+                changed = true;
+                continue;
+            }
+
+            // Repair the same way SaveBoundingBoxToCSV normalizes and clamps
+            auto toPixel = [](double v) { return (int)std::max(-1e9, std::min(1e9, v)); };
+            int xmin = toPixel(std::min(values[0], values[2]));
+            int ymin = toPixel(std::min(values[1], values[3]));
+            int xmax = toPixel(std::max(values[0], values[2]));
+            int ymax = toPixel(std::max(values[1], values[3]));
+
+            if (values[0] > values[2] || values[1] > values[3]) {
+                report(lineNumber, LabelIssue::Inverted, line, fix ? "swapped" : "");
+                changed = true;
+            }
+
+            // The angle column is optional; a bad one leaves the box axis-aligned
+            float angle = 0.0f;
+            if (tokens.size() > 5) {
+                double value = 0.0;
+                if (ParseNumber(tokens[5], value) && std::isfinite(value)) {
+                    angle = NormalizeAngle((float)value);
+                } else {
+                    report(lineNumber, LabelIssue::InvalidAngle, line, fix ? "reset" : "");
+                    changed = true;
+                }
+            }
+
+            if (hasSize && angle != 0.0f) {
+                if (!RotatedInside(xmin, ymin, xmax, ymax, angle, width, height)) {
+                    report(lineNumber, LabelIssue::OutOfBounds,
+                           line + " (image " + std::to_string(width) + "x" + std::to_string(height) + ")",
+                           fix ? "shrunk" : "");
+                    changed = true;
+                    ShrinkRotatedInside(xmin, ymin, xmax, ymax, angle, width, height);
+                }
+            } else if (hasSize) {
+                bool outside = xmin < 0 || ymin < 0 || xmax > width || ymax > height;
+                if (outside) {
+                    report(lineNumber, LabelIssue::OutOfBounds,
+                           line + " (image " + std::to_string(width) + "x" + std::to_string(height) + ")",
+                           fix ? "clamped" : "");
+                    changed = true;
+                    xmin = std::max(0, std::min(xmin, width));
+                    ymin = std::max(0, std::min(ymin, height));
+                    xmax = std::max(0, std::min(xmax, width));
+                    ymax = std::max(0, std::min(ymax, height));
+                }
+            }
+
+            if (xmin == xmax || ymin == ymax) {
+                report(lineNumber, LabelIssue::ZeroArea, line, fix ? "removed" : "");
+                changed = true;
+                continue;
+            }
+
+            // So is the class column; a bad one falls back to class 0
+            uint16_t classId = 0;
+            if (tokens.size() > 4) {
+                double value = 0.0;
+                if (ParseNumber(tokens[4], value) && value >= 0.0 && value <= kMaxClassId && value == std::floor(value)) {
+                    classId = (uint16_t)value;
+                } else {
+                    report(lineNumber, LabelIssue::InvalidClass, line, fix ? "reset" : "");
+                    changed = true;
+                }
+            }
+
+            keptBoxes.push_back({(float)xmin, (float)ymin, (float)xmax, (float)ymax, classId, angle});
+        }
+        csvFile.close();
+
+        if (fix && changed) {
+            rewritten = RewriteSidecar(csvPath, keptBoxes);
+        }
+        return true;
+    }
+
+    static bool ParseNumber(const std::string& token, double& value) {
+        const char* begin = token.c_str();
+        char* end = nullptr;
+        value = std::strtod(begin, &end);
+        if (end == begin) return false;
+        while (*end == ' ' || *end == '\t' || *end == '\r') end++;
+        return *end == '\0';
+    }
+
+    // Rotated corners may overhang the image by half a pixel, since the
+    // sidecar holds the unrotated box in whole pixels
+    static bool RotatedInside(int xmin, int ymin, int xmax, int ymax, float angle, int width, int height) {
+        BoxCorners corners = OrientedCorners({(float)xmin, (float)ymin, (float)xmax, (float)ymax, 0, angle});
+        for (int k = 0; k < 4; k++) {
+            if (corners.x[k] < -0.5f || corners.y[k] < -0.5f || corners.x[k] > width + 0.5f ||
+                corners.y[k] > height + 0.5f) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Clamps the unrotated box like an axis-aligned one, then scales it about
+    // its center until every rotated corner fits
+    static void ShrinkRotatedInside(int& xmin, int& ymin, int& xmax, int& ymax, float angle, int width, int height) {
+        xmin = std::max(0, std::min(xmin, width));
+        ymin = std::max(0, std::min(ymin, height));
+        xmax = std::max(0, std::min(xmax, width));
+        ymax = std::max(0, std::min(ymax, height));
+        double cx = (xmin + xmax) * 0.5, cy = (ymin + ymax) * 0.5;
+        double hw = (xmax - xmin) * 0.5, hh = (ymax - ymin) * 0.5;
+        double radians = angle * kDegreesToRadians;
+        double c = std::abs(std::cos(radians)), s = std::abs(std::sin(radians));
+        // Half extents of the rotated box along the image axes
+        double extentX = c * hw + s * hh, extentY = s * hw + c * hh;
+        double scale = 1.0;
+        if (extentX > 0.0) scale = std::min(scale, std::min(cx, width - cx) / extentX);
+        if (extentY > 0.0) scale = std::min(scale, std::min(cy, height - cy) / extentY);
+        xmin = (int)std::ceil(cx - scale * hw);
+        xmax = (int)std::floor(cx + scale * hw);
+        ymin = (int)std::ceil(cy - scale * hh);
+        ymax = (int)std::floor(cy + scale * hh);
+        xmax = std::max(xmin, xmax);
+        ymax = std::max(ymin, ymax);
+    }
+
+    static bool RewriteSidecar(const std::string& csvPath, const std::vector<BoxRecord>& boxes) {
+        if (WriteSidecar(csvPath, boxes)) return true;
+        std::cerr << "Failed to write fixed sidecar: " << csvPath << std::endl;
+        return false;
+    }
+};
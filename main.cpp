@@ -12,6 +12,39 @@
 #include <vector>
 #include <algorithm>
 #include <sstream>
+#include <deque>
+#include <bitset>
+#include <csignal>
+#include <cstring>
+
+#include "allocation_tracker.h"
+#include "anchor_kmeans.h"
+#include "annotation_index.h"
+#include "batch_reader.h"
+#include "class_table.h"
+#include "dataset_stats.h"
+#include "decoded_frame_cache.h"
+#include "dota_format.h"
+#include "label_validator.h"
+#include "viewer_event.h"
+#include "control_protocol.h"
+#include "control_server.h"
+#include "event_stream.h"
+#include "frame_arena.h"
+#include "frame_pacer.h"
+#include "frame_profiler.h"
+#include "frame_spill_cache.h"
+#include "gpu_timer.h"
+#include "headless_backend.h"
+#include "image_prefetcher.h"
+#include "input_recorder.h"
+#include "multi_camera.h"
+#include "readahead_hinter.h"
+#include "oriented_box.h"
+#include "overlay_cache.h"
+#include "pixel_kernels.h"
+#include "preview_exporter.h"
+#include "video_exporter.h"
 
 enum class ResizeHandle {
     None,
@@ -22,7 +55,8 @@ enum class ResizeHandle {
     Top,
     Bottom,
     Left,
-    Right
+    Right,
+    Rotate
 };
 
 struct BoundingBox {
@@ -32,12 +66,15 @@ struct BoundingBox {
     bool isSelected = false;
     bool loadedFromCSV = false;
     int pixelX1 = 0, pixelY1 = 0, pixelX2 = 0, pixelY2 = 0;  // Store original pixel coordinates
+    uint16_t classId = 0;
+    float angle = 0.0f;  // degrees clockwise about the center; the corners above are the unrotated box
     ResizeHandle activeHandle = ResizeHandle::None;
 };
 
 class ImageViewer {
 private:
-    cv::Mat image;
+    cv::Mat image;                       // texture pixels, possibly reduced for display
+    int imageWidth = 0, imageHeight = 0;  // source pixel grid that boxes are measured in
     GLuint textureID = 0;
     std::string imagePath;
     std::vector<std::string> imageFiles;
@@ -46,22 +83,264 @@ private:
     ImVec2 imagePos;
     ImVec2 imageSize;
     ResizeHandle hoveredHandle = ResizeHandle::None;
+    static constexpr float kRotationKnobOffset = 24.0f;  // screen pixels from the top edge to the rotation knob
+    
+    // Class names (from --classes or a classes file next to the images) and
+    // the class given to newly drawn boxes
+    ClassTable classTable;
+    bool classTableFromOption = false;
+    uint16_t activeClass = 0;
+    
+    // Classes whose boxes are not drawn; the generation invalidates the retained box overlay
+    std::bitset<kMaxClassId + 1> hiddenClasses;
+    RetainedDrawBlock indexedBoxesOverlay;
+    
+    // Dataset-wide annotation index and statistics for the current directory
+    AnnotationIndex annotationIndex;
+    DatasetStats datasetStats;
+    bool showStatsPanel = false;
+    GLuint heatmapTextureID = 0;
+    uint64_t heatmapVersion = 0;
+    
+    // Anchor generation runs in the background from the statistics panel
+    int anchorCount = 9;
+    std::future<AnchorResult> anchorJob;
+    AnchorResult anchorResult;
+    
+    std::vector<std::function<void(const ViewerEvent&)>> eventListeners;
+    
+    // Texture upload time since the last TakeUploadMilliseconds(), for the frame profiler
+    double uploadMilliseconds = 0.0;
+    
+    // Overlay text is laid out once per navigation and replayed from cached geometry
+    RetainedDrawBlock filePathOverlay;
+    uint64_t overlayGeneration = 0;
+    
+    // GPU timestamps around texture upload, image draw and overlay draw
+    GpuTimer gpuTimer;
+    
+    // Background decoding of the images around the cursor (optional)
+    ImagePrefetcher* prefetcher = nullptr;
+    int prefetchAhead = 0;
+    
+    // Page cache warming for the files further ahead (optional)
+    ReadaheadHinter* readahead = nullptr;
+    int readaheadFiles = 0;
+    
+    // Decoded frames kept in RAM and on tmpfs/NVMe across review passes (optional, shown in the stats panel)
+    DecodedFrameCache* frameCache = nullptr;
+    FrameSpillCache* spillCache = nullptr;
+    
+    // Screen area of this viewer; a zero size fills the whole display
+    std::string windowName = "Image Viewer";
+    ImVec2 viewportPos = ImVec2(0, 0);
+    ImVec2 viewportSize = ImVec2(0, 0);
     
 public:
-    ImageViewer() = default;
+    ImageViewer() {
+        // Keep statistics current as boxes are edited
+        annotationIndex.AddChangeListener([this](uint32_t imageId, const std::vector<BoxRecord>& removed, const std::vector<BoxRecord>& added) {
+            datasetStats.ApplyChange(annotationIndex, imageId, removed, added);
+        });
+    }
     
     ~ImageViewer() {
         if (textureID != 0) {
             glDeleteTextures(1, &textureID);
         }
+        if (heatmapTextureID != 0) {
+            glDeleteTextures(1, &heatmapTextureID);
+        }
     }
     
-    void SaveCSV() {
-        SaveBoundingBoxToCSV();
+    bool SaveCSV() {
+        return SaveBoundingBoxToCSV();
     }
     
     void LoadCSV() {
         LoadBoundingBoxFromCSV();
+        if (currentImageIndex >= 0) {
+            annotationIndex.ReloadSidecar(currentImageIndex);
+        }
+    }
+    
+    void ToggleStatsPanel() {
+        showStatsPanel = !showStatsPanel;
+    }
+    
+    // Uses this classes file for every directory instead of looking for one
+    bool LoadClassTable(const std::string& path) {
+        classTableFromOption = classTable.Load(path);
+        return classTableFromOption;
+    }
+    
+    // Sets the class for new boxes and relabels the current box
+    void SetActiveClass(uint16_t classId) {
+        activeClass = classId;
+        std::cout << "Active class: " << classId << " (" << classTable.Name(classId) << ")" << std::endl;
+        if (bbox.isValid && bbox.classId != classId) {
+            bbox.classId = classId;
+            CommitBoxToIndex();
+        }
+    }
+    
+    uint16_t ActiveClass() const { return activeClass; }
+    
+    // Rotates the current box about its center, making it an oriented box
+    bool SetBoxAngle(float degrees) {
+        if (!bbox.isValid) return false;
+        bbox.angle = NormalizeAngle(degrees);
+        OutputBoundingBox();
+        CommitBoxToIndex();
+        return true;
+    }
+    
+    void SetClassVisible(uint16_t classId, bool visible) {
+        if (hiddenClasses[classId] == !visible) return;
+        hiddenClasses[classId] = !visible;
+    }
+    
+    bool ClassVisible(uint16_t classId) const { return !hiddenClasses[classId]; }
+    
+    // Shows only the active class, or everything again if that is already the case
+    void ToggleActiveClassOnly() {
+        bool soloed = hiddenClasses.count() == hiddenClasses.size() - 1 && !hiddenClasses[activeClass];
+        if (soloed) {
+            hiddenClasses.reset();
+            std::cout << "Showing all classes" << std::endl;
+        } else {
+            hiddenClasses.set();
+            hiddenClasses[activeClass] = false;
+            std::cout << "Showing only class " << activeClass << " (" << classTable.Name(activeClass) << ")" << std::endl;
+        }
+    }
+    
+    // Jumps to the closest image after (or before) the current one with a box of the class
+    bool NavigateToClass(uint16_t classId, bool forward) {
+        if (currentImageIndex < 0) return false;
+        int target = annotationIndex.NextImageWithClass(classId, (uint32_t)currentImageIndex, forward);
+        if (target < 0) {
+            std::cout << "No " << (forward ? "later" : "earlier") << " image with class " << classId << " ("
+                      << classTable.Name(classId) << ")" << std::endl;
+            return false;
+        }
+        return NavigateTo(target);
+    }
+    
+    // Uses another viewer's --classes table (multi-camera views)
+    void ShareClassTable(const ImageViewer& other) {
+        if (!other.classTableFromOption) return;
+        classTable = other.classTable;
+        classTableFromOption = true;
+    }
+    
+    void AddEventListener(std::function<void(const ViewerEvent&)> listener) {
+        eventListeners.push_back(std::move(listener));
+    }
+    
+    double TakeUploadMilliseconds() {
+        double milliseconds = uploadMilliseconds;
+        uploadMilliseconds = 0.0;
+        return milliseconds;
+    }
+    
+    GpuTimer& GetGpuTimer() {
+        return gpuTimer;
+    }
+    
+    // Decodes through a shared prefetcher and keeps the next `ahead` images
+    // (and the previous one) decoding in the background
+    void SetPrefetcher(ImagePrefetcher* imagePrefetcher, int ahead) {
+        prefetcher = imagePrefetcher;
+        prefetchAhead = ahead;
+    }
+    
+    // Asks the kernel to read the next `ahead` images and their sidecars
+    // whenever the cursor moves
+    void SetReadahead(ReadaheadHinter* hinter, int ahead) {
+        readahead = hinter;
+        readaheadFiles = ahead;
+    }
+    
+    void SetFrameCaches(DecodedFrameCache* ramCache, FrameSpillCache* diskCache) {
+        frameCache = ramCache;
+        spillCache = diskCache;
+    }
+    
+    // Places the viewer in part of the display; name must be unique per viewer
+    void SetViewport(const std::string& name, ImVec2 pos, ImVec2 size) {
+        windowName = name;
+        viewportPos = pos;
+        viewportSize = size;
+    }
+    
+    int CurrentIndex() const { return currentImageIndex; }
+    int ImageCount() const { return (int)imageFiles.size(); }
+    const std::string& CurrentPath() const { return imagePath; }
+    
+    // Current image's boxes in image pixel coordinates: the annotation index's
+    // boxes, with the first one replaced by the edited bbox
+    std::vector<BoxRecord> GetCurrentBoxes() {
+        if (image.empty()) return {};
+        
+        std::vector<BoxRecord> boxes;
+        if (currentImageIndex >= 0) {
+            boxes = annotationIndex.GetBoxes(currentImageIndex);
+        }
+        if (bbox.isValid) {
+            if (boxes.empty()) {
+                boxes.push_back(EditedPixelBox());
+            } else {
+                boxes[0] = EditedPixelBox();
+            }
+        }
+        return boxes;
+    }
+    
+    // Replaces the current annotation with pixel-space boxes. The viewer edits a
+    // single box, so only the first is shown; the index keeps all of them.
+    void SetCurrentBoxes(const std::vector<BoxRecord>& boxes) {
+        bbox = BoundingBox();
+        if (!boxes.empty()) {
+            bbox.pixelX1 = (int)boxes[0].xmin;
+            bbox.pixelY1 = (int)boxes[0].ymin;
+            bbox.pixelX2 = (int)boxes[0].xmax;
+            bbox.pixelY2 = (int)boxes[0].ymax;
+            bbox.classId = boxes[0].classId;
+            bbox.angle = boxes[0].angle;
+            bbox.isValid = true;
+            bbox.loadedFromCSV = true;  // screen coordinates are derived on the next render
+        }
+        if (currentImageIndex >= 0) {
+            annotationIndex.SetBoxes(currentImageIndex, boxes);
+        }
+        EmitEvent(ViewerEventType::BoxCommitted, boxes);
+    }
+    
+    // Starts decoding path in the background; true once OpenImage(path) can
+    // show it without waiting for the decode
+    bool RequestImage(const std::string& path) {
+        if (prefetcher == nullptr) return true;
+        prefetcher->Request(path);
+        return prefetcher->Ready(path);
+    }
+    
+    bool OpenImage(const std::string& path) {
+        bbox = BoundingBox(); // Reset bounding box for new image
+        return LoadImage(path);
+    }
+    
+    bool OpenDecodedImage(const std::string& path, const cv::Mat& decoded) {
+        if (path == imagePath) return true;
+        bbox = BoundingBox(); // Reset bounding box for new image
+        return ShowImage(path, decoded);
+    }
+    
+    bool NavigateTo(int index) {
+        if (index < 0 || index >= static_cast<int>(imageFiles.size())) return false;
+        if (index == currentImageIndex) return true;
+        bbox = BoundingBox(); // Reset bounding box for new image
+        return LoadImage(imageFiles[index]);
     }
     
     bool LoadImage(const std::string& path) {
@@ -71,6 +350,24 @@ public:
         std::filesystem::path filePath(path);
         std::cout << "Attempting to load image: " << filePath.filename().string() << std::endl;
         
+        cv::Mat decoded;
+        bool decodedOk = prefetcher ? prefetcher->Acquire(path, decoded) : DecodeImage(path, decoded);
+        // Without prefetching nothing trims the prefetcher, so it keeps no frames
+        if (prefetcher != nullptr && prefetchAhead <= 0) prefetcher->Release(path);
+        if (!decodedOk) return false;
+        return ShowImage(path, decoded);
+    }
+    
+    // Frames at least twice this size in both dimensions are decoded at 1/2,
+    // 1/4 or 1/8 scale for display (0 x 0 = always full resolution)
+    static cv::Size& TextureLimit() {
+        static cv::Size limit(0, 0);
+        return limit;
+    }
+    
+    // Reads an image file and converts it to continuous RGB for upload.
+    // Touches no viewer state, so decode workers can call it.
+    static bool DecodeImage(const std::string& path, cv::Mat& decoded) {
         // Check if file exists
         std::ifstream file(path);
         if (!file.good()) {
@@ -79,44 +376,105 @@ public:
         }
         file.close();
         
-        image = cv::imread(path);
-        if (image.empty()) {
+        AllocationScope decodeScope(AllocationTag::ImageDecode);
+        decoded = cv::imread(path);
+        if (decoded.empty()) {
             std::cerr << "Failed to load image (OpenCV could not decode): " << path << std::endl;
             return false;
         }
         
         // Debug: Check original image properties
-        std::cout << "Original image - Channels: " << image.channels() << ", Type: " << image.type() << std::endl;
-        
-        // Convert BGR to RGB for OpenGL
-        if (image.channels() == 3) {
-            cv::cvtColor(image, image, cv::COLOR_BGR2RGB);
-        } else if (image.channels() == 4) {
-            cv::cvtColor(image, image, cv::COLOR_BGRA2RGB);
+        std::cout << "Original image - Channels: " << decoded.channels() << ", Type: " << decoded.type() << std::endl;
+        
+        // Convert to RGB for OpenGL with the kernel specialized for the decoded layout;
+        // frames bigger than the texture limit are averaged down in the same pass
+        cv::Mat rgb;
+        PixelLayout layout = DecodedLayout(decoded.channels());
+        int factor = DisplayReduction(path, decoded);
+        bool converted = factor > 1 ? DownscalePixels(decoded, rgb, factor, layout, PixelLayout::RGB)
+                                    : SwizzlePixels(decoded, rgb, layout, PixelLayout::RGB);
+        if (!converted) {
+            std::cerr << "Unsupported pixel format (type " << decoded.type() << "): " << path << std::endl;
+            return false;
         }
+        decoded = rgb;
         
         // Don't flip - let's see the original image first
         // cv::flip(image, image, 0);
         
         // Ensure image data is continuous in memory
-        if (!image.isContinuous()) {
-            image = image.clone();
+        if (!decoded.isContinuous()) {
+            decoded = decoded.clone();
         }
-        
+        return true;
+    }
+    
+    // Only frames whose header size matches the decode are reduced, so
+    // SourceSize can always recover the full-resolution grid from the header
+    static int DisplayReduction(const std::string& path, const cv::Mat& decoded) {
+        const cv::Size& limit = TextureLimit();
+        if (limit.width <= 0 || limit.height <= 0) return 1;
+        int width, height;
+        if (!ProbeImageSize(path, width, height) || width != decoded.cols || height != decoded.rows) return 1;
+        return ReductionFactor(width, height, limit.width, limit.height);
+    }
+    
+    // Size of the image a decoded frame was made from. Checks every factor,
+    // not just the current limit's, because cached frames may predate it.
+    static cv::Size SourceSize(const std::string& path, const cv::Mat& decoded) {
+        int width, height;
+        if (ProbeImageSize(path, width, height)) {
+            for (int factor : {2, 4, 8}) {
+                if (width / factor == decoded.cols && height / factor == decoded.rows) return cv::Size(width, height);
+            }
+        }
+        return decoded.size();
+    }
+    
+    // Displays an image that was already decoded by DecodeImage, e.g. by the
+    // prefetcher or the multi-camera pipeline
+    bool ShowImage(const std::string& path, const cv::Mat& decoded) {
+        std::filesystem::path filePath(path);
+        image = decoded;
         imagePath = path;
+        cv::Size sourceSize = SourceSize(path, decoded);
+        imageWidth = sourceSize.width;
+        imageHeight = sourceSize.height;
         
         // Scan for other images in the same directory
-        ScanDirectory();
+        {
+            AllocationScope pathsScope(AllocationTag::Paths);
+            ScanDirectory();
+        }
+        overlayGeneration++;
+        
+        // Rebuild the annotation index when the directory listing changed
+        if (annotationIndex.ImagePaths() != imageFiles) {
+            if (!classTableFromOption) {
+                std::string classesPath = ClassTable::FindForDirectory(filePath.parent_path().string());
+                if (classesPath.empty() || !classTable.Load(classesPath)) classTable.Clear();
+            }
+            {
+                AllocationScope indexScope(AllocationTag::Index);
+                annotationIndex.Build(imageFiles);
+            }
+            AllocationScope statsScope(AllocationTag::Stats);
+            datasetStats.Recompute(annotationIndex);
+        }
         
         // Try to load corresponding CSV file (coordinates will be calculated during first render)
         LoadBoundingBoxFromCSV();
         
         // Output image resolution
         std::cout << "Image loaded successfully: " << filePath.filename().string() << std::endl;
-        std::cout << "Resolution: " << image.cols << "x" << image.rows << std::endl;
+        std::cout << "Resolution: " << imageWidth << "x" << imageHeight << std::endl;
+        if (image.cols != imageWidth) {
+            std::cout << "Texture reduced to " << image.cols << "x" << image.rows << std::endl;
+        }
         std::cout << "Is continuous: " << image.isContinuous() << ", Step: " << image.step << std::endl;
         
         // Generate OpenGL texture
+        auto uploadStart = std::chrono::steady_clock::now();
         if (textureID != 0) {
             glDeleteTextures(1, &textureID);
         }
@@ -132,8 +490,15 @@ public:
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
         
+        gpuTimer.Mark(GpuTimer::UploadBegin);
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, image.cols, image.rows, 0, GL_RGB, GL_UNSIGNED_BYTE, image.data);
+        gpuTimer.Mark(GpuTimer::UploadEnd);
         glBindTexture(GL_TEXTURE_2D, 0);
+        uploadMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - uploadStart).count();
+        
+        HintUpcomingFiles();
+        PrefetchNeighbors();
+        EmitEvent(ViewerEventType::Navigated, GetCurrentBoxes());
         
         return true;
     }
@@ -141,31 +506,31 @@ public:
     void Render() {
         if (textureID == 0) return;
         
-        // Get the main window size
-        ImGuiIO& io = ImGui::GetIO();
+        // Get the viewer's area (the main window unless placed in a multi-view grid)
+        ImVec2 area = ViewportArea();
         
         // Calculate image size maintaining aspect ratio
-        float imageAspectRatio = (float)image.cols / (float)image.rows;
-        float windowAspectRatio = io.DisplaySize.x / io.DisplaySize.y;
+        float imageAspectRatio = (float)imageWidth / (float)imageHeight;
+        float windowAspectRatio = area.x / area.y;
         
         if (imageAspectRatio > windowAspectRatio) {
             // Image is wider than window - fit to width
-            imageSize.x = io.DisplaySize.x;
-            imageSize.y = io.DisplaySize.x / imageAspectRatio;
+            imageSize.x = area.x;
+            imageSize.y = area.x / imageAspectRatio;
         } else {
             // Image is taller than window - fit to height
-            imageSize.y = io.DisplaySize.y;
-            imageSize.x = io.DisplaySize.y * imageAspectRatio;
+            imageSize.y = area.y;
+            imageSize.x = area.y * imageAspectRatio;
         }
         
         // Center the image in the window
         ImVec2 imageOffset;
-        imageOffset.x = (io.DisplaySize.x - imageSize.x) * 0.5f;
-        imageOffset.y = (io.DisplaySize.y - imageSize.y) * 0.5f;
+        imageOffset.x = (area.x - imageSize.x) * 0.5f;
+        imageOffset.y = (area.y - imageSize.y) * 0.5f;
         
-        ImGui::SetNextWindowPos(ImVec2(0, 0), ImGuiCond_Always);
-        ImGui::SetNextWindowSize(io.DisplaySize, ImGuiCond_Always);
-        ImGui::Begin("Image Viewer", nullptr, ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoScrollWithMouse);
+        ImGui::SetNextWindowPos(viewportPos, ImGuiCond_Always);
+        ImGui::SetNextWindowSize(area, ImGuiCond_Always);
+        ImGui::Begin(windowName.c_str(), nullptr, ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoScrollWithMouse);
         
         // Set cursor position to center the image
         ImGui::SetCursorPos(imageOffset);
@@ -173,8 +538,8 @@ public:
         
         // Convert pixel coordinates to screen coordinates if loaded from CSV
         if (bbox.loadedFromCSV && bbox.isValid) {
-            float scaleX = imageSize.x / (float)image.cols;
-            float scaleY = imageSize.y / (float)image.rows;
+            float scaleX = imageSize.x / (float)imageWidth;
+            float scaleY = imageSize.y / (float)imageHeight;
             
             bbox.x1 = imagePos.x + bbox.pixelX1 * scaleX;
             bbox.y1 = imagePos.y + bbox.pixelY1 * scaleY;
@@ -188,7 +553,9 @@ public:
         }
         
         // Display image filling the entire window
+        gpuTimer.AddMarker(ImGui::GetWindowDrawList(), GpuTimer::ImageBegin);
         ImGui::Image((void*)(intptr_t)textureID, imageSize);
+        gpuTimer.AddMarker(ImGui::GetWindowDrawList(), GpuTimer::ImageEnd);
         
         // Update hovered handle and set appropriate cursor
         UpdateHoveredHandle();
@@ -197,7 +564,8 @@ public:
         // Handle mouse input for bounding box
         HandleMouseInput();
         
-        // Draw bounding box overlay
+        // Draw the image's other indexed boxes, then the editable one
+        DrawIndexedBoxes();
         DrawBoundingBox();
         
         // Draw crosshair lines
@@ -205,6 +573,7 @@ public:
         
         // Draw file path at the bottom of the window as overlay
         DrawFilePathOverlay();
+        gpuTimer.AddMarker(ImGui::GetWindowDrawList(), GpuTimer::OverlayEnd);
         
         ImGui::End();
     }
@@ -241,6 +610,44 @@ public:
         LoadImage(imageFiles[prevIndex]);
     }
     
+    void RenderStatsPanel() {
+        if (!showStatsPanel) return;
+        
+        ImGui::SetNextWindowPos(ImVec2(20, 20), ImGuiCond_FirstUseEver);
+        ImGui::SetNextWindowSize(ImVec2(420, 720), ImGuiCond_FirstUseEver);
+        ImGui::Begin("Dataset Statistics", &showStatsPanel);
+        
+        ImGui::Text("Images: %zu  Boxes: %lld  Empty images: %lld", annotationIndex.ImageCount(),
+                    (long long)datasetStats.TotalBoxes(), (long long)datasetStats.EmptyImages());
+        ImGui::Text("Mean box size: %.1f x %.1f px", datasetStats.MeanWidth(), datasetStats.MeanHeight());
+        ImGui::Separator();
+        
+        PlotHistogram(datasetStats.BoxWidth(), "Box width (px)");
+        PlotHistogram(datasetStats.BoxHeight(), "Box height (px)");
+        PlotHistogram(datasetStats.AspectRatio(), "Aspect ratio (log2 w/h)");
+        PlotHistogram(datasetStats.BoxesPerImage(), "Boxes per image");
+        
+        ImGui::Text("Object centers");
+        UpdateHeatmapTexture();
+        if (heatmapTextureID != 0) {
+            float side = std::min(ImGui::GetContentRegionAvail().x, 256.0f);
+            ImGui::Image((void*)(intptr_t)heatmapTextureID, ImVec2(side, side));
+        }
+        
+        if (ImGui::Button("Export CSV") && !imagePath.empty()) {
+            std::filesystem::path directory = std::filesystem::path(imagePath).parent_path();
+            datasetStats.ExportCSV((directory / "dataset_stats.csv").string());
+        }
+        
+        RenderClassSection();
+        RenderTimingSection();
+        RenderCacheSection();
+        RenderAnchorSection();
+        RenderMemorySection();
+        
+        ImGui::End();
+    }
+    
 private:
     void HandleMouseInput() {
         if (textureID == 0) return;
@@ -275,6 +682,8 @@ private:
                 bbox.y1 = mousePos.y;
                 bbox.x2 = mousePos.x;
                 bbox.y2 = mousePos.y;
+                bbox.classId = activeClass;
+                bbox.angle = 0.0f;
                 bbox.isDrawing = true;
                 bbox.isValid = false;
                 bbox.isSelected = false;
@@ -303,12 +712,14 @@ private:
                     
                     // Output coordinates to terminal
                     OutputBoundingBox();
+                    CommitBoxToIndex();
                 }
                 
                 if (bbox.activeHandle != ResizeHandle::None) {
                     bbox.activeHandle = ResizeHandle::None;
                     // Output coordinates to terminal
                     OutputBoundingBox();
+                    CommitBoxToIndex();
                 }
             }
         } else {
@@ -323,6 +734,10 @@ private:
         if (textureID == 0 || (!bbox.isDrawing && !bbox.isValid)) {
             return;
         }
+        // A hidden class stays hidden until its box is being edited
+        if (hiddenClasses[bbox.classId] && !bbox.isDrawing && !bbox.isSelected) {
+            return;
+        }
         
         // std::cout << "Drawing bounding box - isValid: " << bbox.isValid << ", isDrawing: " << bbox.isDrawing << std::endl;
         
@@ -332,96 +747,242 @@ private:
         ImVec2 p1(std::min(bbox.x1, bbox.x2), std::min(bbox.y1, bbox.y2));
         ImVec2 p2(std::max(bbox.x1, bbox.x2), std::max(bbox.y1, bbox.y2));
         
-        // Clamp to image bounds
-        p1.x = std::max(p1.x, imagePos.x);
-        p1.y = std::max(p1.y, imagePos.y);
-        p2.x = std::min(p2.x, imagePos.x + imageSize.x);
-        p2.y = std::min(p2.y, imagePos.y + imageSize.y);
+        // Clamp to image bounds (an oriented box is drawn unclamped in its own
+        // frame, then rotated into place)
+        if (bbox.angle == 0.0f) {
+            p1.x = std::max(p1.x, imagePos.x);
+            p1.y = std::max(p1.y, imagePos.y);
+            p2.x = std::min(p2.x, imagePos.x + imageSize.x);
+            p2.y = std::min(p2.y, imagePos.y + imageSize.y);
+        }
+        int firstVertex = drawList->VtxBuffer.Size;
         
         ImU32 color = bbox.isDrawing ? IM_COL32(255, 255, 0, 128) : 
                      (bbox.isSelected ? IM_COL32(0, 255, 0, 128) : IM_COL32(255, 0, 0, 128));
         drawList->AddRect(p1, p2, color, 0.0f, 0, 2.0f);
         drawList->AddRectFilled(p1, p2, IM_COL32(255, 255, 255, 20));
         
-        // Draw resize handles when selected
+        // Draw resize handles and the rotation knob when selected
         if (bbox.isSelected && bbox.isValid) {
             DrawResizeHandles(drawList, p1, p2);
+            ImVec2 knob((p1.x + p2.x) * 0.5f, p1.y - kRotationKnobOffset);
+            drawList->AddLine(ImVec2(knob.x, p1.y), knob, IM_COL32(255, 255, 255, 255), 1.0f);
+            drawList->AddCircleFilled(knob, 5.0f, hoveredHandle == ResizeHandle::Rotate ? IM_COL32(255, 255, 0, 255)
+                                                                                         : IM_COL32(255, 255, 255, 255));
         }
         
         // Highlight hovered edge
         if (hoveredHandle != ResizeHandle::None && bbox.isValid) {
             DrawHighlightedEdge(drawList, p1, p2, hoveredHandle);
         }
+        RotateVertices(drawList, firstVertex, bbox.angle);
+        
+        // Class name above the box, once the dataset has more than the default class
+        if (!classTable.Empty() || bbox.classId != 0) {
+            std::string label = classTable.Name(bbox.classId);
+            ImVec2 anchor = RotateAboutBoxCenter(p1, bbox.angle);
+            float textHeight = ImGui::GetFontSize();
+            drawList->AddText(ImVec2(anchor.x + 2.0f, std::max(imagePos.y, anchor.y - textHeight - 2.0f)),
+                              IM_COL32(255, 255, 255, 230), label.c_str());
+        }
     }
     
-    void OutputBoundingBox() {
-        if (!bbox.isValid) return;
+    // Read-only outlines of the current image's boxes in the annotation index,
+    // except the first, which the editable bbox shows. Hidden classes are
+    // skipped with one bit test per row, and the geometry is replayed from the
+    // retained block until the boxes, the visibility or the layout change.
+    void DrawIndexedBoxes() {
+        if (currentImageIndex < 0 || imageWidth <= 0 || imageHeight <= 0) return;
+        uint32_t count = annotationIndex.ImageBoxCount((uint32_t)currentImageIndex);
+        uint32_t first = bbox.isValid || bbox.isDrawing ? 1 : 0;
+        if (count <= first) return;
+        
+        // The geometry depends on the boxes, the class names and visibility,
+        // and where the image is drawn; positions are hashed by their bits
+        // since a panned image may sit at negative coordinates
+        auto bits = [](float value) {
+            uint32_t word;
+            std::memcpy(&word, &value, sizeof(word));
+            return (uint64_t)word;
+        };
+        uint64_t key = annotationIndex.Version();
+        for (uint64_t part : {classTable.Revision(), (uint64_t)std::hash<std::bitset<kMaxClassId + 1>>()(hiddenClasses),
+                              (uint64_t)currentImageIndex, (uint64_t)first, bits(imagePos.x), bits(imagePos.y),
+                              bits(imageSize.x), bits(imageSize.y)}) {
+            key = (key ^ part) * 0x100000001b3ULL;
+        }
+        indexedBoxesOverlay.Draw(ImGui::GetWindowDrawList(), key, [&](ImDrawList* drawList) {
+            static const ImU32 palette[] = {IM_COL32(255, 99, 71, 200),  IM_COL32(30, 144, 255, 200), IM_COL32(50, 205, 50, 200),
+                                            IM_COL32(255, 215, 0, 200),  IM_COL32(238, 130, 238, 200), IM_COL32(0, 206, 209, 200),
+                                            IM_COL32(255, 140, 0, 200),  IM_COL32(186, 85, 211, 200)};
+            float scaleX = imageSize.x / (float)imageWidth;
+            float scaleY = imageSize.y / (float)imageHeight;
+            bool showNames = !classTable.Empty() || annotationIndex.ClassCount() > 1;
+            const std::vector<uint16_t>& classIds = annotationIndex.ClassIds();
+            uint32_t begin = annotationIndex.ImageBoxBegin((uint32_t)currentImageIndex);
+            for (uint32_t row = begin + first; row < begin + count; row++) {
+                uint16_t classId = classIds[row];
+                if (hiddenClasses[classId]) continue;
+                ImVec2 p1(imagePos.x + annotationIndex.XMin()[row] * scaleX, imagePos.y + annotationIndex.YMin()[row] * scaleY);
+                ImVec2 p2(imagePos.x + annotationIndex.XMax()[row] * scaleX, imagePos.y + annotationIndex.YMax()[row] * scaleY);
+                ImU32 color = palette[classId % (sizeof(palette) / sizeof(palette[0]))];
+                float angle = annotationIndex.Angles()[row];
+                if (angle == 0.0f) {
+                    drawList->AddRect(p1, p2, color, 0.0f, 0, 1.5f);
+                } else {
+                    BoxCorners corners = OrientedCorners({p1.x, p1.y, p2.x, p2.y, classId, angle});
+                    drawList->AddQuad(ImVec2(corners.x[0], corners.y[0]), ImVec2(corners.x[1], corners.y[1]),
+                                      ImVec2(corners.x[2], corners.y[2]), ImVec2(corners.x[3], corners.y[3]), color, 1.5f);
+                    p1 = ImVec2(corners.x[0], corners.y[0]);
+                }
+                if (showNames) {
+                    drawList->AddText(ImVec2(p1.x + 2.0f, p1.y + 1.0f), color, classTable.Name(classId).c_str());
+                }
+            }
+        });
+    }
+    
+    // Converts the screen-space bbox to image pixel coordinates, clamped to image bounds
+    void ComputePixelBox(int& xmin, int& ymin, int& xmax, int& ymax) {
+        if (bbox.loadedFromCSV) {
+            // Not rendered yet, so only the pixel coordinates are meaningful
+            xmin = std::min(bbox.pixelX1, bbox.pixelX2);
+            ymin = std::min(bbox.pixelY1, bbox.pixelY2);
+            xmax = std::max(bbox.pixelX1, bbox.pixelX2);
+            ymax = std::max(bbox.pixelY1, bbox.pixelY2);
+        } else {
+            // Convert screen coordinates to image coordinates
+            float scaleX = (float)imageWidth / imageSize.x;
+            float scaleY = (float)imageHeight / imageSize.y;
+            
+            xmin = (int)((std::min(bbox.x1, bbox.x2) - imagePos.x) * scaleX);
+            ymin = (int)((std::min(bbox.y1, bbox.y2) - imagePos.y) * scaleY);
+            xmax = (int)((std::max(bbox.x1, bbox.x2) - imagePos.x) * scaleX);
+            ymax = (int)((std::max(bbox.y1, bbox.y2) - imagePos.y) * scaleY);
+        }
         
-        // Convert screen coordinates to image coordinates
-        float scaleX = (float)image.cols / imageSize.x;
-        float scaleY = (float)image.rows / imageSize.y;
+        // Clamp to image bounds
+        xmin = std::max(0, std::min(xmin, imageWidth));
+        ymin = std::max(0, std::min(ymin, imageHeight));
+        xmax = std::max(0, std::min(xmax, imageWidth));
+        ymax = std::max(0, std::min(ymax, imageHeight));
+    }
+    
+    // The edited bbox in image pixel coordinates
+    BoxRecord EditedPixelBox() {
+        int xmin, ymin, xmax, ymax;
+        ComputePixelBox(xmin, ymin, xmax, ymax);
+        return {(float)xmin, (float)ymin, (float)xmax, (float)ymax, bbox.classId, bbox.angle};
+    }
+    
+    // Writes the edited bbox over the first of the current image's boxes in the
+    // annotation index; the others, shown read-only, are kept
+    void CommitBoxToIndex() {
+        if (!bbox.isValid || currentImageIndex < 0) return;
         
-        int xmin = (int)((std::min(bbox.x1, bbox.x2) - imagePos.x) * scaleX);
-        int ymin = (int)((std::min(bbox.y1, bbox.y2) - imagePos.y) * scaleY);
-        int xmax = (int)((std::max(bbox.x1, bbox.x2) - imagePos.x) * scaleX);
-        int ymax = (int)((std::max(bbox.y1, bbox.y2) - imagePos.y) * scaleY);
+        annotationIndex.SetBox(currentImageIndex, 0, EditedPixelBox());
+        EmitEvent(ViewerEventType::BoxCommitted, annotationIndex.GetBoxes(currentImageIndex));
+    }
+    
+    void EmitEvent(ViewerEventType type, const std::vector<BoxRecord>& boxes) {
+        if (eventListeners.empty()) return;
+        
+        ViewerEvent event;
+        event.type = type;
+        event.imageIndex = currentImageIndex;
+        event.imageCount = (int)imageFiles.size();
+        event.imagePath = imagePath;
+        event.imageWidth = imageWidth;
+        event.imageHeight = imageHeight;
+        event.boxes = boxes;
+        for (const auto& listener : eventListeners) {
+            listener(event);
+        }
+    }
+    
+    void OutputBoundingBox() {
+        if (!bbox.isValid) return;
         
-        // Clamp to image bounds
-        xmin = std::max(0, std::min(xmin, image.cols));
-        ymin = std::max(0, std::min(ymin, image.rows));
-        xmax = std::max(0, std::min(xmax, image.cols));
-        ymax = std::max(0, std::min(ymax, image.rows));
+        int xmin, ymin, xmax, ymax;
+        ComputePixelBox(xmin, ymin, xmax, ymax);
         
         // Calculate YOLOv5 format: class x_center y_center width height (normalized)
-        float x_center = (xmin + xmax) / 2.0f / image.cols;
-        float y_center = (ymin + ymax) / 2.0f / image.rows;
-        float width = (xmax - xmin) / (float)image.cols;
-        float height = (ymax - ymin) / (float)image.rows;
+        float x_center = (xmin + xmax) / 2.0f / imageWidth;
+        float y_center = (ymin + ymax) / 2.0f / imageHeight;
+        float width = (xmax - xmin) / (float)imageWidth;
+        float height = (ymax - ymin) / (float)imageHeight;
         
         std::cout << "(Xmin, Ymin, Xmax, Ymax) = (" << xmin << ", " << ymin << ", " << xmax << ", " << ymax << ")" << std::endl;
-        std::cout << "YOLOv5 format: 0 " << x_center << " " << y_center << " " << width << " " << height << std::endl;
+        std::cout << "Class: " << bbox.classId << " (" << classTable.Name(bbox.classId) << ")" << std::endl;
+        std::cout << "YOLOv5 format: " << bbox.classId << " " << x_center << " " << y_center << " " << width << " " << height << std::endl;
+        
+        // Oriented boxes also in the YOLO OBB layout: class and the four corners, normalized
+        if (bbox.angle != 0.0f) {
+            BoxCorners corners = OrientedCorners({(float)xmin, (float)ymin, (float)xmax, (float)ymax, bbox.classId, bbox.angle});
+            std::cout << "Angle: " << bbox.angle << " degrees" << std::endl;
+            std::cout << "YOLO OBB format: " << bbox.classId;
+            for (int k = 0; k < 4; k++) {
+                std::cout << " " << corners.x[k] / imageWidth << " " << corners.y[k] / imageHeight;
+            }
+            std::cout << std::endl;
+        }
     }
     
-    void SaveBoundingBoxToCSV() {
-        if (!bbox.isValid || imagePath.empty()) return;
-        
-        // Convert screen coordinates to image coordinates
-        float scaleX = (float)image.cols / imageSize.x;
-        float scaleY = (float)image.rows / imageSize.y;
+    // Writes all of the current image's boxes, not only the edited one
+    bool SaveBoundingBoxToCSV() {
+        if (imagePath.empty()) return false;
         
-        int xmin = (int)((std::min(bbox.x1, bbox.x2) - imagePos.x) * scaleX);
-        int ymin = (int)((std::min(bbox.y1, bbox.y2) - imagePos.y) * scaleY);
-        int xmax = (int)((std::max(bbox.x1, bbox.x2) - imagePos.x) * scaleX);
-        int ymax = (int)((std::max(bbox.y1, bbox.y2) - imagePos.y) * scaleY);
-        
-        // Clamp to image bounds
-        xmin = std::max(0, std::min(xmin, image.cols));
-        ymin = std::max(0, std::min(ymin, image.rows));
-        xmax = std::max(0, std::min(xmax, image.cols));
-        ymax = std::max(0, std::min(ymax, image.rows));
+        std::vector<BoxRecord> boxes = GetCurrentBoxes();
+        if (boxes.empty()) return false;
         
         // Generate CSV file path (same as image path but with .csv extension)
-        std::string csvPath = imagePath;
-        size_t lastDot = csvPath.find_last_of('.');
-        if (lastDot != std::string::npos) {
-            csvPath = csvPath.substr(0, lastDot) + ".csv";
-        } else {
-            csvPath += ".csv";
-        }
+        std::string csvPath = CsvPathForImage(imagePath);
         
-        // Write CSV file in overwrite mode
-        std::ofstream csvFile(csvPath);
-        if (csvFile.is_open()) {
-            csvFile << "x_min,y_min,x_max,y_max" << std::endl;
-            csvFile << xmin << "," << ymin << "," << xmax << "," << ymax << std::endl;
-            csvFile.close();
-            std::cout << "Bounding box saved to: " << csvPath << std::endl;
+        bool saved;
+        if (currentImageIndex >= 0) {
+            // Saving clamps the edited box to the image, so the index gets the saved box too
+            if (bbox.isValid) {
+                annotationIndex.SetBox(currentImageIndex, 0, boxes[0]);
+            }
+            saved = annotationIndex.SaveSidecar(currentImageIndex);
         } else {
+            saved = WriteSidecar(csvPath, boxes);
+        }
+        if (!saved) {
             std::cerr << "Failed to save CSV file: " << csvPath << std::endl;
+            return false;
+        }
+        std::cout << boxes.size() << (boxes.size() == 1 ? " bounding box" : " bounding boxes") << " saved to: " << csvPath << std::endl;
+        EmitEvent(ViewerEventType::Saved, boxes);
+        return true;
+    }
+    
+    ImVec2 BoxCenter() const {
+        return ImVec2((bbox.x1 + bbox.x2) * 0.5f, (bbox.y1 + bbox.y2) * 0.5f);
+    }
+    
+    // Rotates a screen point about the box center; by -bbox.angle this maps the
+    // screen into the box's own frame, where its edges are axis-aligned
+    ImVec2 RotateAboutBoxCenter(ImVec2 point, float degrees) const {
+        if (degrees == 0.0f) return point;
+        ImVec2 center = BoxCenter();
+        float radians = degrees * kDegreesToRadians;
+        float c = std::cos(radians), s = std::sin(radians);
+        float dx = point.x - center.x, dy = point.y - center.y;
+        return ImVec2(center.x + c * dx - s * dy, center.y + s * dx + c * dy);
+    }
+    
+    // Rotates the vertices added to the draw list since firstVertex, so an
+    // oriented box is drawn in its own frame by the axis-aligned code
+    void RotateVertices(ImDrawList* drawList, int firstVertex, float degrees) const {
+        if (degrees == 0.0f) return;
+        for (int i = firstVertex; i < drawList->VtxBuffer.Size; i++) {
+            drawList->VtxBuffer.Data[i].pos = RotateAboutBoxCenter(drawList->VtxBuffer.Data[i].pos, degrees);
         }
     }
     
     bool IsPointInBoundingBox(ImVec2 point) {
+        point = RotateAboutBoxCenter(point, -bbox.angle);
         float minX = std::min(bbox.x1, bbox.x2);
         float maxX = std::max(bbox.x1, bbox.x2);
         float minY = std::min(bbox.y1, bbox.y2);
@@ -433,6 +994,7 @@ private:
     ResizeHandle GetResizeHandle(ImVec2 point) {
         if (!bbox.isValid) return ResizeHandle::None;
         
+        point = RotateAboutBoxCenter(point, -bbox.angle);
         float minX = std::min(bbox.x1, bbox.x2);
         float maxX = std::max(bbox.x1, bbox.x2);
         float minY = std::min(bbox.y1, bbox.y2);
@@ -441,6 +1003,13 @@ private:
         const float cornerSize = 12.0f;
         const float edgeSize = 6.0f;
         
+        // Rotation knob above the top edge (only when selected)
+        if (bbox.isSelected) {
+            float knobX = (minX + maxX) * 0.5f, knobY = minY - kRotationKnobOffset;
+            if (std::abs(point.x - knobX) <= edgeSize && std::abs(point.y - knobY) <= edgeSize)
+                return ResizeHandle::Rotate;
+        }
+        
         // Check corner handles first (always detect corners)
         if (std::abs(point.x - minX) <= cornerSize && std::abs(point.y - minY) <= cornerSize)
             return ResizeHandle::TopLeft;
@@ -467,6 +1036,18 @@ private:
     }
     
     void ResizeBoundingBox(ImVec2 mousePos) {
+        if (bbox.activeHandle == ResizeHandle::Rotate) {
+            // Straight up from the center is angle 0; Shift snaps to 15 degrees
+            ImVec2 center = BoxCenter();
+            float angle = std::atan2(mousePos.x - center.x, center.y - mousePos.y) / kDegreesToRadians;
+            if (ImGui::GetIO().KeyShift) angle = std::round(angle / 15.0f) * 15.0f;
+            bbox.angle = NormalizeAngle(angle);
+            return;
+        }
+        
+        // Edges move in the box's own frame
+        ImVec2 center = BoxCenter();
+        mousePos = RotateAboutBoxCenter(mousePos, -bbox.angle);
         switch (bbox.activeHandle) {
             case ResizeHandle::TopLeft:
                 bbox.x1 = mousePos.x;
@@ -499,6 +1080,21 @@ private:
             default:
                 break;
         }
+        
+        // The resize moved the center; shift the box so the edges that were
+        // not dragged stay where they were on screen once rotated again
+        if (bbox.angle != 0.0f) {
+            ImVec2 newCenter = BoxCenter();
+            float radians = bbox.angle * kDegreesToRadians;
+            float c = std::cos(radians), s = std::sin(radians);
+            float dx = newCenter.x - center.x, dy = newCenter.y - center.y;
+            float shiftX = center.x + c * dx - s * dy - newCenter.x;
+            float shiftY = center.y + s * dx + c * dy - newCenter.y;
+            bbox.x1 += shiftX;
+            bbox.x2 += shiftX;
+            bbox.y1 += shiftY;
+            bbox.y2 += shiftY;
+        }
     }
     
     void DrawResizeHandles(ImDrawList* drawList, ImVec2 p1, ImVec2 p2) {
@@ -589,6 +1185,9 @@ private:
             case ResizeHandle::Right:
                 ImGui::SetMouseCursor(ImGuiMouseCursor_ResizeEW);
                 break;
+            case ResizeHandle::Rotate:
+                ImGui::SetMouseCursor(ImGuiMouseCursor_Hand);
+                break;
             default:
                 // Check if hovering over image for crosshair
                 ImGuiIO& io = ImGui::GetIO();
@@ -632,6 +1231,7 @@ private:
     void DrawCrosshair() {
         ImGuiIO& io = ImGui::GetIO();
         ImVec2 mousePos = io.MousePos;
+        ImVec2 area = ViewportArea();
         
         // Check if mouse is over the image
         bool isOverImage = (mousePos.x >= imagePos.x && mousePos.x <= imagePos.x + imageSize.x &&
@@ -642,16 +1242,16 @@ private:
             
             // Draw horizontal line across entire window that follows mouse
             drawList->AddLine(
-                ImVec2(0, mousePos.y), 
-                ImVec2(io.DisplaySize.x, mousePos.y), 
+                ImVec2(viewportPos.x, mousePos.y), 
+                ImVec2(viewportPos.x + area.x, mousePos.y), 
                 IM_COL32(255, 255, 255, 128), 
                 1.0f
             );
             
             // Draw vertical line across entire window that follows mouse
             drawList->AddLine(
-                ImVec2(mousePos.x, 0), 
-                ImVec2(mousePos.x, io.DisplaySize.y), 
+                ImVec2(mousePos.x, viewportPos.y), 
+                ImVec2(mousePos.x, viewportPos.y + area.y), 
                 IM_COL32(255, 255, 255, 128), 
                 1.0f
             );
@@ -661,33 +1261,228 @@ private:
     void DrawFilePathOverlay() {
         if (imagePath.empty()) return;
         
-        ImGuiIO& io = ImGui::GetIO();
-        ImDrawList* drawList = ImGui::GetWindowDrawList();
+        // Text and layout are only rebuilt after navigation or a window resize
+        filePathOverlay.Draw(ImGui::GetWindowDrawList(), overlayGeneration, [this](ImDrawList* drawList) {
+            ImVec2 area = ViewportArea();
+            
+            // Prepare the text to display with file index (frame-local, formatted into the frame arena)
+            const char* displayText = imagePath.c_str();
+            if (currentImageIndex >= 0 && !imageFiles.empty()) {
+                displayText = FrameArena::Shared().Format("[%d / %zu] %s", currentImageIndex + 1, imageFiles.size(), imagePath.c_str());
+            }
+            
+            // Calculate text size
+            ImVec2 textSize = ImGui::CalcTextSize(displayText);
+            
+            // Position at bottom of window with some padding
+            float padding = 10.0f;
+            ImVec2 textPos;
+            textPos.x = viewportPos.x + padding;
+            textPos.y = viewportPos.y + area.y - textSize.y - padding;
+            
+            // Draw semi-transparent background
+            ImVec2 bgMin = ImVec2(textPos.x - 5.0f, textPos.y - 3.0f);
+            ImVec2 bgMax = ImVec2(textPos.x + textSize.x + 5.0f, textPos.y + textSize.y + 3.0f);
+            drawList->AddRectFilled(bgMin, bgMax, IM_COL32(0, 0, 0, 128)); // Semi-transparent black background
+            
+            // Draw the text
+            drawList->AddText(textPos, IM_COL32(255, 255, 255, 255), displayText);
+        });
+    }
+    
+    // Most recent GPU timer results (a few frames behind)
+    void RenderTimingSection() {
+        if (!gpuTimer.Supported()) return;
+        const GpuFrameTimes& times = gpuTimer.Latest();
+        ImGui::Separator();
+        ImGui::Text("GPU time (ms, frame %lld)", (long long)times.frame);
+        ImGui::Text("  upload %.3f  image %.3f  overlay %.3f  render %.3f", times.uploadMs, times.imageMs, times.overlayMs,
+                    times.renderMs);
+    }
+    
+    // Per-class totals come straight from the index's incremental counts
+    void RenderClassSection() {
+        size_t classCount = std::max(classTable.Count(), annotationIndex.ClassCount());
+        if (classCount == 0) return;
+        ImGui::Separator();
+        ImGui::Text("Classes (active: %s, keys 0-9 select, V shows it alone, N / Shift+N jump)",
+                    classTable.Name(activeClass).c_str());
+        for (size_t classId = 0; classId < classCount; classId++) {
+            uint32_t boxes = annotationIndex.ClassBoxCount((uint16_t)classId);
+            if (boxes == 0 && classId >= classTable.Count()) continue;
+            ImGui::PushID((int)classId);
+            bool visible = ClassVisible((uint16_t)classId);
+            if (ImGui::Checkbox("##visible", &visible)) {
+                SetClassVisible((uint16_t)classId, visible);
+            }
+            ImGui::SameLine();
+            ImGui::Text("%3zu %-20s %8u boxes in %6u images", classId, classTable.Name((uint16_t)classId).c_str(), boxes,
+                        annotationIndex.ClassImageCount((uint16_t)classId));
+            ImGui::SameLine();
+            if (ImGui::SmallButton("<")) NavigateToClass((uint16_t)classId, false);
+            ImGui::SameLine();
+            if (ImGui::SmallButton(">")) NavigateToClass((uint16_t)classId, true);
+            ImGui::PopID();
+        }
+    }
+    
+    // Prefetch and spill cache hit rates
+    void RenderCacheSection() {
+        if (prefetcher == nullptr) return;
+        ImGui::Separator();
+        ImGui::Text("Prefetch: %llu hits, %llu waits, %llu misses", (unsigned long long)prefetcher->Hits(),
+                    (unsigned long long)prefetcher->Waits(), (unsigned long long)prefetcher->Misses());
+        if (frameCache != nullptr) {
+            DecodedFrameCache::Stats ramStats = frameCache->GetStats();
+            ImGui::Text("RAM cache: %.0f%% hit rate (%llu raw, %llu compressed hits, %llu misses)",
+                        ramStats.HitRate() * 100.0, (unsigned long long)ramStats.rawHits,
+                        (unsigned long long)ramStats.compressedHits, (unsigned long long)ramStats.misses);
+            ImGui::Text("  %zu raw (%.0f MB) + %zu compressed (%.0f MB) frames, x%.2f effective capacity",
+                        frameCache->RawFrames(), frameCache->RawBytes() / (1024.0 * 1024.0), frameCache->CompressedFrames(),
+                        frameCache->CompressedBytes() / (1024.0 * 1024.0), frameCache->EffectiveRatio());
+        }
+        if (spillCache == nullptr || !spillCache->Enabled()) return;
+        FrameSpillCache::Stats stats = spillCache->GetStats();
+        ImGui::Text("Spill cache: %.0f%% hit rate (%llu hits, %llu misses, %llu stale)", stats.HitRate() * 100.0,
+                    (unsigned long long)stats.hits, (unsigned long long)stats.misses, (unsigned long long)stats.stale);
+        ImGui::Text("  %zu frames, %.0f / %.0f MB, %llu evicted", spillCache->FrameCount(),
+                    spillCache->TotalBytes() / (1024.0 * 1024.0), spillCache->CapacityBytes() / (1024.0 * 1024.0),
+                    (unsigned long long)stats.evictions);
+    }
+    
+    // Per-subsystem heap usage; only available in builds with J_BBOX_TRACK_ALLOCATIONS
+    void RenderMemorySection() {
+        if (!AllocationTracker::Enabled()) return;
+        ImGui::Separator();
+        ImGui::Text("Heap usage (current / peak MB)");
+        for (size_t i = 0; i < (size_t)AllocationTag::Count; i++) {
+            AllocationTracker::Usage usage = AllocationTracker::GetUsage((AllocationTag)i);
+            if (usage.allocations == 0) continue;
+            ImGui::Text("  %-14s %9.2f / %9.2f", AllocationTagName((AllocationTag)i), usage.currentBytes / (1024.0 * 1024.0),
+                        usage.peakBytes / (1024.0 * 1024.0));
+        }
+        AllocationTracker::Usage total = AllocationTracker::GetTotal();
+        ImGui::Text("  %-14s %9.2f / %9.2f", "total", total.currentBytes / (1024.0 * 1024.0), total.peakBytes / (1024.0 * 1024.0));
+    }
+    
+    void RenderAnchorSection() {
+        ImGui::Separator();
+        ImGui::Text("YOLO anchors (k-means + genetic refinement)");
+        
+        // Collect a finished job
+        if (anchorJob.valid() && anchorJob.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            anchorResult = anchorJob.get();
+            std::cout << "Anchors computed from " << anchorResult.boxCount << " boxes in " << anchorResult.seconds << "s" << std::endl;
+            std::cout << "Mean IoU: " << anchorResult.meanIoU << ", best possible recall: " << anchorResult.bestPossibleRecall << std::endl;
+            std::cout << anchorResult.ToYaml();
+        }
         
-        // Prepare the text to display with file index
-        std::string displayText;
-        if (currentImageIndex >= 0 && !imageFiles.empty()) {
-            displayText = "[" + std::to_string(currentImageIndex + 1) + " / " + std::to_string(imageFiles.size()) + "] " + imagePath;
+        if (anchorJob.valid()) {
+            ImGui::Text("Computing anchors...");
         } else {
-            displayText = imagePath;
+            ImGui::SliderInt("Anchor count", &anchorCount, 1, 15);
+            if (ImGui::Button("Compute anchors")) {
+                StartAnchorJob();
+            }
         }
         
-        // Calculate text size
-        ImVec2 textSize = ImGui::CalcTextSize(displayText.c_str());
+        if (!anchorResult.widths.empty()) {
+            ImGui::Text("%zu boxes, %.2fs  Mean IoU %.3f  BPR %.3f", anchorResult.boxCount, anchorResult.seconds,
+                        anchorResult.meanIoU, anchorResult.bestPossibleRecall);
+            ImGui::TextUnformatted(anchorResult.ToYaml().c_str());
+        }
+    }
+    
+    void StartAnchorJob() {
+        AnchorOptions options;
+        options.anchorCount = anchorCount;
+        
+        // Clustering submits about a thousand parallel rounds; on a pool of its
+        // own (half the cores) they never queue ahead of other work on the shared
+        // pool, and the job releases the threads when it finishes
+        auto pool = std::make_shared<ThreadPool>(std::max(1u, std::thread::hardware_concurrency() / 2));
+        // Box columns are copied on this thread so edits can continue while clustering runs
+        auto generator = std::make_shared<AnchorGenerator>(options, *pool);
+        generator->CollectBoxes(annotationIndex);
+        anchorJob = std::async(std::launch::async, [pool, generator]() {
+            AllocationScope scope(AllocationTag::Anchors);
+            return generator->Run();
+        });
+    }
+    
+    void PlotHistogram(const Histogram& histogram, const char* label) {
+        ArenaVector<float> values(histogram.counts.begin(), histogram.counts.end(), ArenaAllocator<float>());
+        ImGui::Text("%s  [%g, %g)", label, histogram.lower, histogram.upper);
+        ImGui::PushID(label);
+        ImGui::PlotHistogram("##histogram", values.data(), (int)values.size(), 0, nullptr, 0.0f, 3.4e38f, ImVec2(-1, 80));
+        ImGui::PopID();
+    }
+    
+    // Re-uploads the center heatmap as an RGBA texture when the statistics changed
+    void UpdateHeatmapTexture() {
+        if (heatmapTextureID != 0 && heatmapVersion == datasetStats.Version()) return;
+        heatmapVersion = datasetStats.Version();
+        
+        const std::vector<int64_t>& heatmap = datasetStats.Heatmap();
+        int64_t peak = 1;
+        for (int64_t count : heatmap) {
+            peak = std::max(peak, count);
+        }
         
-        // Position at bottom of window with some padding
-        float padding = 10.0f;
-        ImVec2 textPos;
-        textPos.x = padding;
-        textPos.y = io.DisplaySize.y - textSize.y - padding;
+        // Log-scaled black -> red -> yellow -> white ramp
+        const int size = DatasetStats::kHeatmapSize;
+        unsigned char* pixels = FrameArena::Shared().AllocateArray<unsigned char>(size * size * 4);
+        float logPeak = std::log1p((float)peak);
+        for (int i = 0; i < size * size; i++) {
+            float t = std::log1p((float)std::max<int64_t>(heatmap[i], 0)) / logPeak;
+            pixels[i * 4 + 0] = (unsigned char)(255.0f * std::min(1.0f, t * 3.0f));
+            pixels[i * 4 + 1] = (unsigned char)(255.0f * std::clamp(t * 3.0f - 1.0f, 0.0f, 1.0f));
+            pixels[i * 4 + 2] = (unsigned char)(255.0f * std::clamp(t * 3.0f - 2.0f, 0.0f, 1.0f));
+            pixels[i * 4 + 3] = 255;
+        }
         
-        // Draw semi-transparent background
-        ImVec2 bgMin = ImVec2(textPos.x - 5.0f, textPos.y - 3.0f);
-        ImVec2 bgMax = ImVec2(textPos.x + textSize.x + 5.0f, textPos.y + textSize.y + 3.0f);
-        drawList->AddRectFilled(bgMin, bgMax, IM_COL32(0, 0, 0, 128)); // Semi-transparent black background
+        if (heatmapTextureID == 0) {
+            glGenTextures(1, &heatmapTextureID);
+        }
+        glBindTexture(GL_TEXTURE_2D, heatmapTextureID);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    
+    ImVec2 ViewportArea() const {
+        if (viewportSize.x > 0.0f && viewportSize.y > 0.0f) return viewportSize;
+        return ImGui::GetIO().DisplaySize;
+    }
+    
+    void HintUpcomingFiles() {
+        if (readahead == nullptr || readaheadFiles <= 0 || currentImageIndex < 0) return;
+        std::vector<std::string> paths;
+        for (int offset = 1; offset <= readaheadFiles && currentImageIndex + offset < (int)imageFiles.size(); offset++) {
+            const std::string& path = imageFiles[currentImageIndex + offset];
+            paths.push_back(path);
+            paths.push_back(CsvPathForImage(path));
+        }
+        readahead->Hint(paths);
+    }
+    
+    void PrefetchNeighbors() {
+        if (prefetcher == nullptr || prefetchAhead <= 0 || currentImageIndex < 0) return;
         
-        // Draw the text
-        drawList->AddText(textPos, IM_COL32(255, 255, 255, 255), displayText.c_str());
+        // Requested in order of likelihood: forward first, then one step back
+        std::vector<std::string> keep = {imagePath};
+        for (int offset = 1; offset <= prefetchAhead; offset++) {
+            if (currentImageIndex + offset < (int)imageFiles.size()) keep.push_back(imageFiles[currentImageIndex + offset]);
+        }
+        if (currentImageIndex > 0) keep.push_back(imageFiles[currentImageIndex - 1]);
+        for (const std::string& path : keep) {
+            prefetcher->Request(path);
+        }
+        prefetcher->Retain(keep);
     }
     
     void ScanDirectory() {
@@ -753,13 +1548,7 @@ private:
         }
         
         // Generate CSV file path (same as image path but with .csv extension)
-        std::string csvPath = imagePath;
-        size_t lastDot = csvPath.find_last_of('.');
-        if (lastDot != std::string::npos) {
-            csvPath = csvPath.substr(0, lastDot) + ".csv";
-        } else {
-            csvPath += ".csv";
-        }
+        std::string csvPath = CsvPathForImage(imagePath);
         
         std::cout << "Current image path: " << imagePath << std::endl;
         std::cout << "Looking for CSV file: " << csvPath << std::endl;
@@ -805,7 +1594,7 @@ private:
                 }
             }
             
-            // Parse CSV line: x_min,y_min,x_max,y_max
+            // Parse CSV line: x_min,y_min,x_max,y_max[,class_id[,angle]]
             std::stringstream ss(line);
             std::string token;
             std::vector<std::string> tokens;
@@ -819,31 +1608,30 @@ private:
                 std::cout << "Token " << i << ": '" << tokens[i] << "'" << std::endl;
             }
             
-            if (tokens.size() >= 4) {
-                try {
-                    int xmin = std::stoi(tokens[0]);
-                    int ymin = std::stoi(tokens[1]);
-                    int xmax = std::stoi(tokens[2]);
-                    int ymax = std::stoi(tokens[3]);
-                    
-                    // Store pixel coordinates - screen coordinates will be calculated during render
-                    bbox.pixelX1 = xmin;
-                    bbox.pixelY1 = ymin;
-                    bbox.pixelX2 = xmax;
-                    bbox.pixelY2 = ymax;
-                    bbox.isValid = true;
-                    bbox.isSelected = false;
-                    bbox.isDrawing = false;
-                    bbox.loadedFromCSV = true;
-                    bbox.activeHandle = ResizeHandle::None;
-                    
-                    std::cout << "Loaded bounding box from CSV: (" << xmin << "," << ymin << "," << xmax << "," << ymax << ")" << std::endl;
-                    std::cout << "bbox.isValid = " << bbox.isValid << ", bbox.loadedFromCSV = " << bbox.loadedFromCSV << std::endl;
-                    
-                    break; // Only load the first bounding box for now
-                } catch (const std::exception& e) {
-                    std::cerr << "Error parsing CSV line: " << line << " - " << e.what() << std::endl;
-                }
+            // Same row rules as the annotation index and the label validator
+            BoxRecord box;
+            if (ParseBoxCsvRow(line, box)) {
+                bbox.classId = box.classId;
+                bbox.angle = box.angle;
+                
+                // Store pixel coordinates - screen coordinates will be calculated during render
+                bbox.pixelX1 = (int)box.xmin;
+                bbox.pixelY1 = (int)box.ymin;
+                bbox.pixelX2 = (int)box.xmax;
+                bbox.pixelY2 = (int)box.ymax;
+                bbox.isValid = true;
+                bbox.isSelected = false;
+                bbox.isDrawing = false;
+                bbox.loadedFromCSV = true;
+                bbox.activeHandle = ResizeHandle::None;
+                
+                std::cout << "Loaded bounding box from CSV: (" << bbox.pixelX1 << "," << bbox.pixelY1 << "," << bbox.pixelX2 << ","
+                          << bbox.pixelY2 << ")" << std::endl;
+                std::cout << "bbox.isValid = " << bbox.isValid << ", bbox.loadedFromCSV = " << bbox.loadedFromCSV << std::endl;
+                
+                break; // Only load the first bounding box for now
+            } else if (tokens.size() >= 4) {
+                std::cerr << "Error parsing CSV line: " << line << std::endl;
             }
         }
         
@@ -851,36 +1639,770 @@ private:
     }
 };
 
-int main(int argc, char* argv[]) {
-    // Initialize GLFW
-    if (!glfwInit()) {
-        std::cerr << "Failed to initialize GLFW" << std::endl;
+// Synchronized views of a multi-camera rig.
+//
+// The primary viewer shows the reference camera and keeps its role for the
+// stats panel, events and the control socket; one more viewer is created per
+// additional camera. A step requests every camera's frame from the shared
+// prefetcher before acquiring any, so all of them decode in parallel and are
+// uploaded in the same frame, and the following steps in the direction of
+// travel keep decoding in the background. When the primary viewer navigates
+// on its own (control socket), the other cameras follow.
+class MultiCameraView {
+private:
+    CameraRig rig;
+    ImageViewer& primary;
+    ImagePrefetcher& prefetcher;
+    std::vector<std::unique_ptr<ImageViewer>> others;
+    int prefetchSteps;
+    ReadaheadHinter* readahead = nullptr;
+    int readaheadSteps = 0;
+    int currentStep = -1;
+    int direction = 1;
+    bool stepping = false;
+    
+public:
+    MultiCameraView(ImageViewer& primaryViewer, ImagePrefetcher& imagePrefetcher, int aheadSteps)
+        : primary(primaryViewer), prefetcher(imagePrefetcher), prefetchSteps(aheadSteps) {}
+    
+    // Warms the page cache for the next `steps` steps of every camera
+    void SetReadahead(ReadaheadHinter* hinter, int steps) {
+        readahead = hinter;
+        readaheadSteps = steps;
+    }
+    
+    bool Open(const std::string& root, CameraSync sync) {
+        if (!rig.Open(root, sync)) return false;
+        others.clear();
+        for (size_t camera = 1; camera < rig.CameraCount(); camera++) {
+            others.push_back(std::make_unique<ImageViewer>());
+            others.back()->SetPrefetcher(&prefetcher, 0);
+            others.back()->ShareClassTable(primary);
+        }
+        primary.SetPrefetcher(&prefetcher, 0);
+        primary.SetReadahead(nullptr, 0);
+        primary.AddEventListener([this](const ViewerEvent& event) {
+            if (stepping || event.type != ViewerEventType::Navigated) return;
+            int step = rig.StepOf(0, event.imagePath);
+            if (step >= 0) StepTo(step);
+        });
+        return StepTo(0);
+    }
+    
+    bool Active() const { return rig.CameraCount() > 0; }
+    int StepCount() const { return (int)rig.StepCount(); }
+    int CurrentStep() const { return currentStep; }
+    
+    bool StepTo(int step) {
+        if (step < 0 || step >= StepCount()) return false;
+        if (currentStep >= 0 && step != currentStep) direction = step > currentStep ? 1 : -1;
+        currentStep = step;
+        
+        // Every camera's frame is in flight before the first one is waited for
+        std::vector<std::string> paths = rig.FramePaths(step, step);
+        for (const std::string& path : paths) {
+            prefetcher.Request(path);
+        }
+        
+        stepping = true;
+        bool ok = true;
+        for (size_t camera = 0; camera < rig.CameraCount(); camera++) {
+            const std::string& path = rig.FramePath(step, camera);
+            if (path.empty()) continue;
+            cv::Mat decoded;
+            if (!prefetcher.Acquire(path, decoded) || !View(camera).OpenDecodedImage(path, decoded)) {
+                ok = false;
+            }
+        }
+        stepping = false;
+        
+        // Warm the page cache further ahead than decoding reaches
+        if (readahead != nullptr && readaheadSteps > 0) {
+            std::vector<std::string> hints;
+            for (int offset = 1; offset <= readaheadSteps; offset++) {
+                for (const std::string& path : rig.FramePaths(step + offset * direction, step + offset * direction)) {
+                    hints.push_back(path);
+                    hints.push_back(CsvPathForImage(path));
+                }
+            }
+            readahead->Hint(hints);
+        }
+        
+        // Decode ahead in the direction of travel and keep one step behind
+        int first = direction > 0 ? step - 1 : step - prefetchSteps;
+        int last = direction > 0 ? step + prefetchSteps : step + 1;
+        std::vector<std::string> keep = rig.FramePaths(first, last);
+        for (int offset = 1; offset <= prefetchSteps; offset++) {
+            for (const std::string& path : rig.FramePaths(step + offset * direction, step + offset * direction)) {
+                prefetcher.Request(path);
+            }
+        }
+        prefetcher.Retain(keep);
+        return ok;
+    }
+    
+    void StepBy(int delta) {
+        StepTo(std::clamp(currentStep + delta, 0, StepCount() - 1));
+    }
+    
+    // Tiles the views over the display in a near-square grid
+    void Layout() {
+        ImGuiIO& io = ImGui::GetIO();
+        int count = (int)rig.CameraCount();
+        int columns = (int)std::ceil(std::sqrt((double)count));
+        int rows = (count + columns - 1) / columns;
+        ImVec2 cell(io.DisplaySize.x / columns, io.DisplaySize.y / rows);
+        for (int camera = 0; camera < count; camera++) {
+            ImVec2 pos(cell.x * (camera % columns), cell.y * (camera / columns));
+            std::string name = camera == 0 ? "Image Viewer" : "Image Viewer##" + rig.GetCamera(camera).name;
+            View(camera).SetViewport(name, pos, cell);
+        }
+    }
+    
+    void Render() {
+        Layout();
+        for (size_t camera = 0; camera < rig.CameraCount(); camera++) {
+            View(camera).Render();
+        }
+    }
+    
+    void SaveAll() {
+        for (size_t camera = 0; camera < rig.CameraCount(); camera++) {
+            View(camera).SaveCSV();
+        }
+    }
+    
+    void SetActiveClass(uint16_t classId) {
+        for (size_t camera = 0; camera < rig.CameraCount(); camera++) {
+            View(camera).SetActiveClass(classId);
+        }
+    }
+    
+    void ToggleActiveClassOnly() {
+        for (size_t camera = 0; camera < rig.CameraCount(); camera++) {
+            View(camera).ToggleActiveClassOnly();
+        }
+    }
+    
+    void LoadAll() {
+        for (size_t camera = 0; camera < rig.CameraCount(); camera++) {
+            View(camera).LoadCSV();
+        }
+    }
+    
+private:
+    ImageViewer& View(size_t camera) {
+        return camera == 0 ? primary : *others[camera - 1];
+    }
+};
+
+struct CommandLineOptions {
+    std::string inputPath;          // image file or directory to open
+    std::string validateDirectory;  // --validate DIR: headless sidecar check
+    std::string reportPath;         // --report PATH: .json or .csv validation report
+    bool fixLabels = false;         // --fix: clamp/repair sidecars while validating
+    std::string importDotaDirectory;    // --import-dota LABELS: DOTA labelTxt files into sidecars
+    std::string exportDotaDirectory;    // --export-dota OUT: sidecars as DOTA labelTxt files
+    std::string controlSocket;      // --control-socket PATH: line protocol for pipeline integration
+    std::string eventStream;        // --events PATH: NDJSON event records ("-" for stdout)
+    std::string recordPath;         // --record FILE: write every frame's input for later replay
+    std::string replayPath;         // --replay FILE: drive the UI from a recording instead of live input
+    std::string frameReportPath;    // --frame-report PATH: per-frame timing JSON
+    bool headless = false;          // --headless: render offscreen through EGL instead of a window
+    int headlessWidth = 1200;       // --size WxH: offscreen framebuffer size
+    int headlessHeight = 800;
+    std::string captureDirectory;   // --capture DIR: write every rendered frame as PNG
+    std::string previewDirectory;   // --export-previews DIR: headless JPEG previews with boxes burned in
+    PreviewOptions preview;         // --preview-scale N, --contact-sheet CxR
+    std::string videoPath;          // --export-video FILE: annotated .mp4/.avi of the image sequence
+    double videoFps = 30.0;         // --fps N
+    std::string memoryReportPath;   // --memory-report PATH: per-subsystem heap usage at exit
+    PacingMode pacing = PacingMode::Vsync;  // --pacing MODE
+    double maxFps = 60.0;           // --max-fps N: frame rate of the cap pacing mode
+    int prefetchCount = 0;          // --prefetch N: images (or multi-view steps) decoded ahead
+    int readaheadCount = 0;         // --readahead N: images (or steps) whose files are read into the page cache
+    std::string multiViewRoot;      // --multi-view ROOT: one synchronized view per camera subfolder
+    CameraSync cameraSync = CameraSync::Index;  // --sync index|timestamp
+    ReadBackend readBackend = ReadBackend::Auto;  // --io auto|uring|threads: bulk sidecar reads
+    uint64_t ramCacheMB = 0;          // --ram-cache MB: raw + LZ4-compressed decoded frames in memory
+    std::string spillCacheDirectory;  // --spill-cache DIR: keep decoded frames on tmpfs/NVMe
+    uint64_t spillCacheMB = 4096;     // --spill-cache-size MB
+    SpillCompression spillCompression = SpillCompression::Raw;  // --spill-compression raw|lz4
+    int textureLimitWidth = 0;        // --texture-limit WxH: decode large frames reduced for display
+    int textureLimitHeight = 0;
+    std::string classesPath;          // --classes FILE: class names, one per line
+};
+
+void PrintUsage(const char* program) {
+    std::cout << "Usage: " << program << " [image or directory]" << std::endl;
+    std::cout << "       " << program << " --validate DIR [--report report.json|report.csv] [--fix]" << std::endl;
+    std::cout << "       " << program << " --export-previews OUT [--preview-scale 1|2|4|8] [--contact-sheet CxR] DIR" << std::endl;
+    std::cout << "       " << program << " --export-video OUT.mp4 [--fps N] [--preview-scale 1|2|4|8] DIR" << std::endl;
+    std::cout << "       " << program << " --import-dota LABELS [--classes FILE] DIR" << std::endl;
+    std::cout << "       " << program << " --export-dota OUT [--classes FILE] DIR" << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "  --control-socket PATH   accept control commands on a Unix domain socket" << std::endl;
+    std::cout << "  --events PATH           write NDJSON event records to a file or FIFO (- for stdout)" << std::endl;
+    std::cout << "  --record FILE           record input events for deterministic replay" << std::endl;
+    std::cout << "  --replay FILE           replay recorded input as fast as possible, then exit" << std::endl;
+    std::cout << "  --frame-report PATH     write per-frame CPU/upload/frame times as JSON" << std::endl;
+    std::cout << "  --headless              render offscreen without a display; without --replay," << std::endl;
+    std::cout << "                          renders each image of the dataset once and exits" << std::endl;
+    std::cout << "  --size WxH              offscreen framebuffer size (default 1200x800)" << std::endl;
+    std::cout << "  --capture DIR           write every rendered frame to DIR as PNG" << std::endl;
+    std::cout << "  --prefetch N            decode the next N images in the background (default 0 = off)" << std::endl;
+    std::cout << "  --readahead N           warm the page cache for the next N images and sidecars (default 0 = off)" << std::endl;
+    std::cout << "  --multi-view ROOT       synchronized views of the camera subfolders of ROOT" << std::endl;
+    std::cout << "  --sync MODE             multi-view alignment: index (default) or timestamp" << std::endl;
+    std::cout << "  --io BACKEND            bulk sidecar reads: auto (default), uring or threads" << std::endl;
+    std::cout << "  --ram-cache MB          keep up to MB of decoded frames in memory, LZ4-compressed when older" << std::endl;
+    std::cout << "  --spill-cache DIR       keep decoded frames in DIR (e.g. /dev/shm/j_bbox) for later passes" << std::endl;
+    std::cout << "  --spill-cache-size MB   spill cache capacity (default 4096)" << std::endl;
+    std::cout << "  --spill-compression C   raw (default) or lz4 spill cache frames" << std::endl;
+    std::cout << "  --texture-limit WxH     show frames at least twice WxH at 1/2, 1/4 or 1/8 resolution" << std::endl;
+    std::cout << "  --classes FILE          class names, one per line (default: classes.txt next to the images)" << std::endl;
+    std::cout << "  --pacing MODE           vsync (default), adaptive, cap, events or unthrottled" << std::endl;
+    std::cout << "  --max-fps N             frame rate limit; implies --pacing cap (default 60)" << std::endl;
+    std::cout << "  --memory-report PATH    write per-subsystem heap usage at exit (needs J_BBOX_TRACK_ALLOCATIONS)" << std::endl;
+}
+
+bool ParseCommandLine(int argc, char* argv[], CommandLineOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto nextValue = [&](std::string& value) {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << arg << std::endl;
+                return false;
+            }
+            value = argv[++i];
+            return true;
+        };
+        
+        if (arg == "--validate") {
+            if (!nextValue(options.validateDirectory)) return false;
+        } else if (arg == "--import-dota") {
+            if (!nextValue(options.importDotaDirectory)) return false;
+        } else if (arg == "--export-dota") {
+            if (!nextValue(options.exportDotaDirectory)) return false;
+        } else if (arg == "--report") {
+            if (!nextValue(options.reportPath)) return false;
+        } else if (arg == "--fix") {
+            options.fixLabels = true;
+        } else if (arg == "--control-socket") {
+            if (!nextValue(options.controlSocket)) return false;
+        } else if (arg == "--events") {
+            if (!nextValue(options.eventStream)) return false;
+        } else if (arg == "--record") {
+            if (!nextValue(options.recordPath)) return false;
+        } else if (arg == "--replay") {
+            if (!nextValue(options.replayPath)) return false;
+        } else if (arg == "--frame-report") {
+            if (!nextValue(options.frameReportPath)) return false;
+        } else if (arg == "--headless") {
+            options.headless = true;
+        } else if (arg == "--size") {
+            std::string size;
+            if (!nextValue(size)) return false;
+            if (std::sscanf(size.c_str(), "%dx%d", &options.headlessWidth, &options.headlessHeight) != 2 ||
+                options.headlessWidth <= 0 || options.headlessHeight <= 0) {
+                std::cerr << "Invalid size, expected WxH: " << size << std::endl;
+                return false;
+            }
+        } else if (arg == "--classes") {
+            if (!nextValue(options.classesPath)) return false;
+        } else if (arg == "--texture-limit") {
+            std::string size;
+            if (!nextValue(size)) return false;
+            if (std::sscanf(size.c_str(), "%dx%d", &options.textureLimitWidth, &options.textureLimitHeight) != 2 ||
+                options.textureLimitWidth <= 0 || options.textureLimitHeight <= 0) {
+                std::cerr << "Invalid texture limit, expected WxH: " << size << std::endl;
+                return false;
+            }
+        } else if (arg == "--capture") {
+            if (!nextValue(options.captureDirectory)) return false;
+        } else if (arg == "--export-previews") {
+            if (!nextValue(options.previewDirectory)) return false;
+        } else if (arg == "--preview-scale") {
+            std::string scale;
+            if (!nextValue(scale)) return false;
+            options.preview.reduction = std::atoi(scale.c_str());
+            if (options.preview.reduction != 1 && options.preview.reduction != 2 && options.preview.reduction != 4 &&
+                options.preview.reduction != 8) {
+                std::cerr << "Preview scale must be 1, 2, 4 or 8: " << scale << std::endl;
+                return false;
+            }
+        } else if (arg == "--export-video") {
+            if (!nextValue(options.videoPath)) return false;
+        } else if (arg == "--fps") {
+            std::string fps;
+            if (!nextValue(fps)) return false;
+            options.videoFps = std::atof(fps.c_str());
+            if (options.videoFps <= 0.0) {
+                std::cerr << "Invalid frame rate: " << fps << std::endl;
+                return false;
+            }
+        } else if (arg == "--contact-sheet") {
+            std::string grid;
+            if (!nextValue(grid)) return false;
+            if (std::sscanf(grid.c_str(), "%dx%d", &options.preview.sheetColumns, &options.preview.sheetRows) != 2 ||
+                options.preview.sheetColumns <= 0 || options.preview.sheetRows <= 0) {
+                std::cerr << "Invalid contact sheet grid, expected CxR: " << grid << std::endl;
+                return false;
+            }
+        } else if (arg == "--prefetch") {
+            std::string count;
+            if (!nextValue(count)) return false;
+            options.prefetchCount = std::atoi(count.c_str());
+            if (options.prefetchCount < 0) {
+                std::cerr << "Invalid prefetch count: " << count << std::endl;
+                return false;
+            }
+        } else if (arg == "--readahead") {
+            std::string count;
+            if (!nextValue(count)) return false;
+            options.readaheadCount = std::atoi(count.c_str());
+            if (options.readaheadCount < 0) {
+                std::cerr << "Invalid readahead count: " << count << std::endl;
+                return false;
+            }
+        } else if (arg == "--multi-view") {
+            if (!nextValue(options.multiViewRoot)) return false;
+        } else if (arg == "--sync") {
+            std::string sync;
+            if (!nextValue(sync)) return false;
+            if (sync == "index") {
+                options.cameraSync = CameraSync::Index;
+            } else if (sync == "timestamp") {
+                options.cameraSync = CameraSync::Timestamp;
+            } else {
+                std::cerr << "Unknown sync mode: " << sync << std::endl;
+                return false;
+            }
+        } else if (arg == "--io") {
+            std::string backend;
+            if (!nextValue(backend)) return false;
+            if (!ParseReadBackend(backend, options.readBackend)) {
+                std::cerr << "Unknown I/O backend: " << backend << std::endl;
+                return false;
+            }
+        } else if (arg == "--ram-cache") {
+            std::string size;
+            if (!nextValue(size)) return false;
+            long long megabytes = std::atoll(size.c_str());
+            if (megabytes < 0) {
+                std::cerr << "Invalid RAM cache size: " << size << std::endl;
+                return false;
+            }
+            options.ramCacheMB = (uint64_t)megabytes;
+        } else if (arg == "--spill-cache") {
+            if (!nextValue(options.spillCacheDirectory)) return false;
+        } else if (arg == "--spill-cache-size") {
+            std::string size;
+            if (!nextValue(size)) return false;
+            long long megabytes = std::atoll(size.c_str());
+            if (megabytes <= 0) {
+                std::cerr << "Invalid spill cache size: " << size << std::endl;
+                return false;
+            }
+            options.spillCacheMB = (uint64_t)megabytes;
+        } else if (arg == "--spill-compression") {
+            std::string compression;
+            if (!nextValue(compression)) return false;
+            if (compression == "raw") {
+                options.spillCompression = SpillCompression::Raw;
+            } else if (compression == "lz4") {
+                options.spillCompression = SpillCompression::Lz4;
+            } else {
+                std::cerr << "Unknown spill compression: " << compression << std::endl;
+                return false;
+            }
+        } else if (arg == "--pacing") {
+            std::string mode;
+            if (!nextValue(mode)) return false;
+            if (!ParsePacingMode(mode, options.pacing)) {
+                std::cerr << "Unknown pacing mode: " << mode << std::endl;
+                return false;
+            }
+        } else if (arg == "--max-fps") {
+            std::string fps;
+            if (!nextValue(fps)) return false;
+            options.maxFps = std::atof(fps.c_str());
+            if (options.maxFps <= 0.0) {
+                std::cerr << "Invalid frame rate: " << fps << std::endl;
+                return false;
+            }
+            options.pacing = PacingMode::Capped;
+        } else if (arg == "--memory-report") {
+            if (!nextValue(options.memoryReportPath)) return false;
+            if (!AllocationTracker::Enabled()) {
+                std::cerr << "Warning: built without J_BBOX_TRACK_ALLOCATIONS, the memory report will be empty" << std::endl;
+            }
+        } else if (arg == "--help" || arg == "-h") {
+            return false;
+        } else if (arg.rfind("--", 0) == 0) {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return false;
+        } else {
+            options.inputPath = arg;
+        }
+    }
+    if (!options.recordPath.empty() && !options.replayPath.empty()) {
+        std::cerr << "--record and --replay cannot be combined" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Headless label validation; returns the process exit code (1 if any issue was found)
+int RunValidation(const CommandLineOptions& options) {
+    LabelValidator validator(options.fixLabels);
+    ValidationReport report = validator.ValidateDirectory(options.validateDirectory);
+    
+    std::cout << "Validated " << report.images << " images, " << report.sidecars << " sidecars, " << report.boxes
+              << " boxes in " << report.seconds << "s" << std::endl;
+    std::vector<size_t> counts = report.CountByIssue();
+    for (size_t i = 0; i < counts.size(); i++) {
+        if (counts[i] > 0) {
+            std::cout << "  " << LabelIssueName((LabelIssue)i) << ": " << counts[i] << std::endl;
+        }
+    }
+    if (options.fixLabels) {
+        std::cout << "Rewrote " << report.filesRewritten << " sidecar files" << std::endl;
+    }
+    
+    if (!options.reportPath.empty()) {
+        std::string extension = std::filesystem::path(options.reportPath).extension().string();
+        bool written = extension == ".csv" ? report.WriteCSV(options.reportPath) : report.WriteJSON(options.reportPath);
+        if (written) {
+            std::cout << "Validation report written to: " << options.reportPath << std::endl;
+        }
+    }
+    
+    return report.findings.empty() ? 0 : 1;
+}
+
+// Image directory for the headless exporters: the input directory or the directory of the input image
+std::string ExportSourceDirectory(const CommandLineOptions& options) {
+    std::error_code error;
+    if (std::filesystem::is_directory(options.inputPath, error)) {
+        return options.inputPath;
+    }
+    return std::filesystem::path(options.inputPath).parent_path().string();
+}
+
+// Headless preview export
+int RunPreviewExport(const CommandLineOptions& options) {
+    std::string directory = ExportSourceDirectory(options);
+    if (directory.empty()) {
+        std::cerr << "--export-previews needs an image directory" << std::endl;
         return -1;
     }
     
-    // Setup GLFW window
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    AllocationScope scope(AllocationTag::Export);
+    AnnotationIndex index;
+    index.Build(ListImageFiles(directory));
+    PreviewExporter exporter(options.preview);
+    PreviewExportResult result = exporter.Export(index, options.previewDirectory);
     
-    GLFWwindow* window = glfwCreateWindow(1200, 800, "Bounding Box Annotation Tool", NULL, NULL);
-    if (window == NULL) {
-        std::cerr << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
+    std::cout << "Exported " << result.images << " previews (" << result.boxes << " boxes";
+    if (result.sheets > 0) std::cout << ", " << result.sheets << " contact sheets";
+    std::cout << ") to " << options.previewDirectory << " in " << result.seconds << "s: " << result.ImagesPerSecond()
+              << " images/s, " << result.bytesWritten / (1024.0 * 1024.0) / std::max(result.seconds, 1e-9) << " MB/s written"
+              << std::endl;
+    if (result.failed > 0) {
+        std::cerr << result.failed << " images failed" << std::endl;
+    }
+    return result.failed > 0 ? 1 : 0;
+}
+
+// Headless DOTA conversion: labelTxt files into sidecars, or sidecars into labelTxt files
+int RunDotaConversion(const CommandLineOptions& options) {
+    bool importing = !options.importDotaDirectory.empty();
+    std::string directory = ExportSourceDirectory(options);
+    if (directory.empty()) {
+        std::cerr << (importing ? "--import-dota" : "--export-dota") << " needs an image directory" << std::endl;
+        return -1;
+    }
+    
+    ClassTable classes;
+    std::string classesPath = options.classesPath.empty() ? ClassTable::FindForDirectory(directory) : options.classesPath;
+    if (!classesPath.empty() && !classes.Load(classesPath)) {
+        std::cerr << "Failed to load class names: " << classesPath << std::endl;
+        return -1;
+    }
+    
+    if (importing) {
+        DotaStats stats = ImportDota(options.importDotaDirectory, directory, classes);
+        std::cout << "Imported " << stats.boxes << " boxes into " << stats.images << " sidecars (" << stats.difficult
+                  << " marked difficult, " << stats.skipped << " lines skipped)" << std::endl;
+        return stats.skipped > 0 ? 1 : 0;
+    }
+    DotaStats stats = ExportDota(directory, options.exportDotaDirectory, classes);
+    std::cout << "Exported " << stats.boxes << " boxes from " << stats.images << " sidecars to "
+              << options.exportDotaDirectory << std::endl;
+    return 0;
+}
+
+// Headless video export of the image sequence in sorted file order
+int RunVideoExport(const CommandLineOptions& options) {
+    std::string directory = ExportSourceDirectory(options);
+    if (directory.empty()) {
+        std::cerr << "--export-video needs an image directory" << std::endl;
         return -1;
     }
     
-    glfwMakeContextCurrent(window);
-    glfwSwapInterval(1); // Enable vsync
+    AllocationScope scope(AllocationTag::Export);
+    AnnotationIndex index;
+    index.Build(ListImageFiles(directory));
+    VideoOptions videoOptions;
+    videoOptions.fps = options.videoFps;
+    videoOptions.overlay = options.preview;
+    VideoExporter exporter(videoOptions);
+    VideoExportResult result = exporter.Export(index, options.videoPath);
+    
+    std::cout << "Wrote " << result.frames << " frames (" << result.width << "x" << result.height << " @ "
+              << options.videoFps << " fps) to " << options.videoPath << " in " << result.seconds << "s: "
+              << result.FramesPerSecond() << " frames/s" << std::endl;
+    if (result.failed > 0) {
+        std::cerr << result.failed << " images failed to decode" << std::endl;
+    }
+    return result.frames > 0 && result.failed == 0 ? 0 : 1;
+}
+
+void WriteMemoryReport(const CommandLineOptions& options) {
+    if (!options.memoryReportPath.empty()) {
+        AllocationTracker::WriteReport(options.memoryReportPath);
+    }
+}
+
+// Formats a viewer event as a control protocol event line
+std::string FormatControlEvent(const ViewerEvent& event) {
+    std::ostringstream line;
+    line << "event " << ViewerEventName(event.type) << " " << event.imageIndex;
+    if (event.type == ViewerEventType::BoxCommitted) {
+        line << " ";
+        FormatControlBoxes(line, event.boxes);
+    } else {
+        line << " " << event.imagePath;
+    }
+    return line.str();
+}
+
+// Control protocol: one command per line, one "ok ..." or "error ..." reply per command.
+//   ping                      -> ok pong
+//   status                    -> ok <index> <count> <queued> <path>
+//   load <path>               -> ok <index> once an image file, or the first image of a
+//                             directory, has decoded on the prefetcher
+//   goto <index> | next | prev
+//   get-boxes                 -> ok <n> [xmin ymin xmax ymax class_id angle]...
+//   set-boxes <n> [xmin ymin xmax ymax class_id angle]...   boxes may omit angle (axis-aligned)
+//                             or class_id and angle (class 0)
+//   set-class <id>            class for new boxes; relabels the current box
+//   set-angle <degrees>       rotates the current box about its center
+//   next-class <id> | prev-class <id>   closest later / earlier image with the class
+//   show-class <id> | hide-class <id>   per-class box visibility
+//   save                      -> ok <n>, writing every box of the image to the sidecar
+//   queue <path>              append an image to the review queue
+//   queue-next                open the next queued image
+//   queue-clear
+//   subscribe | unsubscribe   receive "event box|navigate|save <index> ..." lines; box
+//                             events carry the boxes in the get-boxes format
+std::string HandleControlCommand(ImageViewer& viewer, std::deque<std::string>& reviewQueue, const std::string& line, bool& subscribe) {
+    std::istringstream input(line);
+    std::string command;
+    input >> command;
+    std::string rest;
+    std::getline(input >> std::ws, rest);
     
-    // Initialize OpenGL loader
-    if (glewInit() != GLEW_OK) {
+    if (command == "ping") {
+        return "ok pong";
+    }
+    if (command == "status") {
+        return "ok " + std::to_string(viewer.CurrentIndex()) + " " + std::to_string(viewer.ImageCount()) + " " +
+               std::to_string(reviewQueue.size()) + " " + viewer.CurrentPath();
+    }
+    if (command == "load" || command == "queue-next") {
+        std::string path = rest;
+        if (command == "queue-next") {
+            if (reviewQueue.empty()) return "error queue empty";
+            path = reviewQueue.front();
+        }
+        if (path.empty()) return "error missing path";
+        std::error_code error;
+        if (std::filesystem::is_directory(path, error)) {
+            std::vector<std::string> images = ListImageFiles(path);
+            if (images.empty()) return "error no images in directory";
+            path = images[0];
+        }
+        // The image decodes on the prefetcher while the UI keeps running; the
+        // command is retried each frame and replies once the image is shown
+        if (!viewer.RequestImage(path)) return std::string();
+        if (command == "queue-next") reviewQueue.pop_front();
+        return viewer.OpenImage(path) ? "ok " + std::to_string(viewer.CurrentIndex()) : "error failed to load " + path;
+    }
+    if (command == "goto") {
+        int index = -1;
+        std::istringstream(rest) >> index;
+        return viewer.NavigateTo(index) ? "ok " + std::to_string(viewer.CurrentIndex()) : "error index out of range";
+    }
+    if (command == "next" || command == "prev") {
+        if (command == "next") viewer.NavigateNext(); else viewer.NavigatePrevious();
+        return "ok " + std::to_string(viewer.CurrentIndex());
+    }
+    if (command == "get-boxes") {
+        std::vector<BoxRecord> boxes = viewer.GetCurrentBoxes();
+        std::ostringstream reply;
+        reply << "ok ";
+        FormatControlBoxes(reply, boxes);
+        return reply.str();
+    }
+    if (command == "set-boxes") {
+        if (viewer.CurrentIndex() < 0) return "error no image loaded";
+        std::vector<BoxRecord> boxes;
+        std::string error;
+        if (!ParseControlBoxes(rest, boxes, error)) return "error " + error;
+        viewer.SetCurrentBoxes(boxes);
+        return "ok " + std::to_string(boxes.size());
+    }
+    if (command == "set-class") {
+        int classId = -1;
+        std::istringstream(rest) >> classId;
+        if (classId < 0 || classId > kMaxClassId) return "error class id out of range";
+        viewer.SetActiveClass((uint16_t)classId);
+        return "ok " + std::to_string(classId);
+    }
+    if (command == "set-angle") {
+        float angle = 0.0f;
+        if (!(std::istringstream(rest) >> angle) || !std::isfinite(angle)) return "error expected an angle in degrees";
+        if (!viewer.SetBoxAngle(angle)) return "error no box to rotate";
+        std::ostringstream reply;
+        reply << "ok " << NormalizeAngle(angle);
+        return reply.str();
+    }
+    if (command == "next-class" || command == "prev-class" || command == "show-class" || command == "hide-class") {
+        int classId = -1;
+        std::istringstream(rest) >> classId;
+        if (classId < 0 || classId > kMaxClassId) return "error class id out of range";
+        if (command == "show-class" || command == "hide-class") {
+            viewer.SetClassVisible((uint16_t)classId, command == "show-class");
+            return "ok";
+        }
+        if (!viewer.NavigateToClass((uint16_t)classId, command == "next-class")) return "error no such image";
+        return "ok " + std::to_string(viewer.CurrentIndex());
+    }
+    if (command == "save") {
+        size_t count = viewer.GetCurrentBoxes().size();
+        if (count == 0) return "error no box to save";
+        if (!viewer.SaveCSV()) return "error failed to write sidecar";
+        return "ok " + std::to_string(count);
+    }
+    if (command == "queue") {
+        if (rest.empty()) return "error missing path";
+        reviewQueue.push_back(rest);
+        return "ok " + std::to_string(reviewQueue.size());
+    }
+    if (command == "queue-clear") {
+        reviewQueue.clear();
+        return "ok";
+    }
+    if (command == "subscribe" || command == "unsubscribe") {
+        subscribe = command == "subscribe";
+        return "ok";
+    }
+    return "error unknown command: " + command;
+}
+
+int main(int argc, char* argv[]) {
+#if defined(J_BBOX_TRACK_ALLOCATIONS)
+    // Route cv::Mat buffers through the tracker so image memory is attributed too
+    cv::Mat::setDefaultAllocator(&TrackingMatAllocator::Shared());
+#endif
+    CommandLineOptions options;
+    if (!ParseCommandLine(argc, argv, options)) {
+        PrintUsage(argv[0]);
+        return -1;
+    }
+    BatchFileReader::DefaultBackend() = options.readBackend;
+    ImageViewer::TextureLimit() = cv::Size(options.textureLimitWidth, options.textureLimitHeight);
+    
+    // With the event stream on stdout, keep stdout machine-readable by sending log output to stderr
+    if (options.eventStream == "-") {
+        std::cout.rdbuf(std::cerr.rdbuf());
+    }
+    
+    // Headless modes run without creating a window
+    if (!options.validateDirectory.empty()) {
+        return RunValidation(options);
+    }
+    if (!options.importDotaDirectory.empty() || !options.exportDotaDirectory.empty()) {
+        return RunDotaConversion(options);
+    }
+    if (!options.previewDirectory.empty()) {
+        int status = RunPreviewExport(options);
+        WriteMemoryReport(options);
+        return status;
+    }
+    if (!options.videoPath.empty()) {
+        int status = RunVideoExport(options);
+        WriteMemoryReport(options);
+        return status;
+    }
+    
+    // A replay opens the dataset it was recorded on unless another one is given
+    InputReplayer replayer;
+    bool replaying = !options.replayPath.empty();
+    if (replaying) {
+        if (!replayer.Load(options.replayPath)) return -1;
+        if (options.inputPath.empty()) options.inputPath = replayer.DatasetPath();
+    }
+    
+    // Either a GLFW window or, with --headless, an offscreen EGL context
+    GLFWwindow* window = NULL;
+    HeadlessContext headlessContext;
+    if (options.headless) {
+        if (!headlessContext.Create()) return -1;
+    } else {
+        // Initialize GLFW
+        if (!glfwInit()) {
+            std::cerr << "Failed to initialize GLFW" << std::endl;
+            return -1;
+        }
+        
+        // Setup GLFW window
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        
+        window = glfwCreateWindow(1200, 800, "Bounding Box Annotation Tool", NULL, NULL);
+        if (window == NULL) {
+            std::cerr << "Failed to create GLFW window" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        
+        glfwMakeContextCurrent(window);
+    }
+    
+    // Replays are benchmarks and always run unthrottled
+    FramePacer pacer(replaying ? PacingMode::Unthrottled : options.pacing, options.maxFps);
+    if (window) {
+        pacer.Apply();
+    }
+    
+    // Initialize OpenGL loader. GLEW built for GLX reports a missing GLX display
+    // on an EGL context even though the entry points were loaded.
+    if (options.headless) glewExperimental = GL_TRUE;
+    GLenum glewStatus = glewInit();
+    if (glewStatus != GLEW_OK && !(options.headless && glewStatus == GLEW_ERROR_NO_GLX_DISPLAY)) {
         std::cerr << "Failed to initialize OpenGL loader" << std::endl;
         return -1;
     }
     
     // Setup Dear ImGui context
     IMGUI_CHECKVERSION();
+#if defined(J_BBOX_TRACK_ALLOCATIONS)
+    ImGui::SetAllocatorFunctions(AllocationTracker::ImGuiAlloc, AllocationTracker::ImGuiFree);
+#endif
     ImGui::CreateContext();
     ImGuiIO& io = ImGui::GetIO();
     io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;
@@ -890,20 +2412,89 @@ int main(int argc, char* argv[]) {
     ImGui::StyleColorsDark();
     
     // Setup Platform/Renderer backends
-    ImGui_ImplGlfw_InitForOpenGL(window, true);
+    if (window) {
+        ImGui_ImplGlfw_InitForOpenGL(window, true);
+    }
     ImGui_ImplOpenGL3_Init("#version 330");
     
-    // Create image viewer
+    // Optional memory and disk tiers for decoded frames, consulted by the decode
+    // workers in that order before decoding. The decode chain holds raw
+    // pointers to them, so they are declared before the prefetcher, whose
+    // destructor waits for every decode it started.
+    std::unique_ptr<DecodedFrameCache> frameCache;
+    std::unique_ptr<FrameSpillCache> spillCache;
+    if (!options.spillCacheDirectory.empty()) {
+        // Frames decoded under a texture limit are reduced, so they are only reused under the same limit
+        std::string variant;
+        if (options.textureLimitWidth > 0 && options.textureLimitHeight > 0) {
+            variant = "texture-limit " + std::to_string(options.textureLimitWidth) + "x" + std::to_string(options.textureLimitHeight);
+        }
+        spillCache = std::make_unique<FrameSpillCache>(options.spillCacheDirectory, options.spillCacheMB * 1024 * 1024,
+                                                       options.spillCompression, variant);
+    }
+    ImagePrefetcher::DecodeFn decode = &ImageViewer::DecodeImage;
+    if (spillCache && spillCache->Enabled()) {
+        FrameSpillCache* cache = spillCache.get();
+        decode = [cache](const std::string& path, cv::Mat& decoded) {
+            if (cache->Load(path, decoded)) return true;
+            if (!ImageViewer::DecodeImage(path, decoded)) return false;
+            cache->Store(path, decoded);
+            return true;
+        };
+    }
+    if (options.ramCacheMB > 0) {
+        frameCache = std::make_unique<DecodedFrameCache>(options.ramCacheMB * 1024 * 1024);
+        if (!DecodedFrameCache::CompressionAvailable()) {
+            std::cerr << "Built without LZ4, the RAM cache keeps raw frames only" << std::endl;
+        }
+        DecodedFrameCache* cache = frameCache.get();
+        decode = [cache, next = decode](const std::string& path, cv::Mat& decoded) {
+            if (cache->Lookup(path, decoded)) return true;
+            if (!next(path, decoded)) return false;
+            cache->Insert(path, decoded);
+            return true;
+        };
+    }
+    
+    // Create image viewer. Images are decoded on the shared thread pool, ahead of navigation.
     ImageViewer viewer;
+    ImagePrefetcher prefetcher(decode);
+    viewer.SetPrefetcher(&prefetcher, options.prefetchCount);
+    viewer.SetFrameCaches(frameCache.get(), spillCache.get());
+    if (!options.classesPath.empty() && !viewer.LoadClassTable(options.classesPath)) {
+        std::cerr << "Failed to load class names: " << options.classesPath << std::endl;
+    }
+    // Hint threads are only started when readahead is on
+    ReadaheadHinter readahead(options.readaheadCount > 0 ? 2 : 0);
+    viewer.SetReadahead(&readahead, options.readaheadCount);
+    MultiCameraView multiView(viewer, prefetcher, options.prefetchCount);
+    multiView.SetReadahead(&readahead, options.readaheadCount);
+    
+    // Optional control socket; serviced once per frame from the main loop
+    ControlServer controlServer;
+    std::deque<std::string> reviewQueue;
+    EventStream eventStream;
+    if (!options.eventStream.empty()) {
+        // A FIFO reader going away fails the write with EPIPE instead of killing the viewer
+        std::signal(SIGPIPE, SIG_IGN);
+        eventStream.Open(options.eventStream);
+        viewer.AddEventListener([&eventStream](const ViewerEvent& event) {
+            eventStream.Publish(event);
+        });
+    }
+    if (!options.controlSocket.empty() && controlServer.Start(options.controlSocket)) {
+        viewer.AddEventListener([&controlServer](const ViewerEvent& event) {
+            controlServer.Broadcast(FormatControlEvent(event));
+        });
+    }
     
     // Load image from command line if provided
-    if (argc > 1) {
-        // Use the raw argv directly to avoid any string copying issues
-        const char* rawPath = argv[1];
-        std::cout << "Raw argument length: " << strlen(rawPath) << std::endl;
-        
-        // Create string carefully
-        std::string inputPath(rawPath);
+    if (!options.multiViewRoot.empty()) {
+        if (!multiView.Open(options.multiViewRoot, options.cameraSync)) {
+            std::cerr << "Failed to open camera rig: " << options.multiViewRoot << std::endl;
+        }
+    } else if (!options.inputPath.empty()) {
+        std::string inputPath = options.inputPath;
         std::cout << "String length: " << inputPath.length() << std::endl;
         std::cout << "Command line argument: " << inputPath << std::endl;
         
@@ -954,64 +2545,243 @@ int main(int argc, char* argv[]) {
         }
     }
     
+    InputRecorder recorder;
+    if (!options.recordPath.empty()) {
+        std::error_code error;
+        std::filesystem::path dataset = std::filesystem::absolute(options.inputPath, error);
+        recorder.Open(options.recordPath, error ? options.inputPath : dataset.string());
+    }
+    FrameProfiler profiler;
+    bool profiling = replaying || !options.frameReportPath.empty();
+    if (window) {
+        profiler.SetPacing(pacer.Describe(), pacer.TargetFrameMs());
+    }
+    
+    // Rendered frames are read back asynchronously and encoded on the thread pool
+    std::deque<std::future<void>> captureWrites;
+    PboReadback readback([&](int64_t frame, const cv::Mat& rgba) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "frame_%06lld.png", (long long)frame);
+        std::string path = (std::filesystem::path(options.captureDirectory) / name).string();
+        captureWrites.push_back(ThreadPool::Shared().Submit([rgba, path]() {
+            cv::Mat bgr;
+            cv::cvtColor(rgba, bgr, cv::COLOR_RGBA2BGR);
+            if (!cv::imwrite(path, bgr)) {
+                std::cerr << "Failed to write frame: " << path << std::endl;
+            }
+        }));
+        while (captureWrites.size() > ThreadPool::Shared().Size() * 2) {
+            captureWrites.front().get();
+            captureWrites.pop_front();
+        }
+    });
+    bool capturing = !options.captureDirectory.empty();
+    if (capturing) {
+        std::error_code error;
+        std::filesystem::create_directories(options.captureDirectory, error);
+    }
+    if (options.headless && !replaying && viewer.ImageCount() == 0) {
+        std::cerr << "Nothing to render: no image loaded" << std::endl;
+    }
+    
     // Main loop
-    while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
+    int64_t frameIndex = 0;
+    bool quit = false;
+    while (!quit) {
+        if (window && glfwWindowShouldClose(window)) break;
+        if (replaying && replayer.Finished()) break;
+        
+        // Without a recording, a headless run renders every image (or rig step) of the dataset once
+        if (options.headless && !replaying) {
+            if (multiView.Active()) {
+                if (frameIndex >= multiView.StepCount()) break;
+                multiView.StepTo((int)frameIndex);
+            } else {
+                if (frameIndex >= viewer.ImageCount()) break;
+                viewer.NavigateTo((int)frameIndex);
+            }
+        }
+        
+        if (window) pacer.WaitForFrame();
+        if (profiling) profiler.BeginFrame();
+        viewer.GetGpuTimer().BeginFrame(frameIndex);
+        
+        controlServer.Poll([&](const std::string& line, bool& subscribe) {
+            return HandleControlCommand(viewer, reviewQueue, line, subscribe);
+        });
+        
+        // Start the Dear ImGui frame. Recorded input replaces live input while replaying.
+        ImGui_ImplOpenGL3_NewFrame();
+        if (replaying) {
+            replayer.ApplyNextFrame();
+        } else if (window) {
+            ImGui_ImplGlfw_NewFrame();
+            recorder.CaptureFrame();
+        } else {
+            io.DisplaySize = ImVec2((float)options.headlessWidth, (float)options.headlessHeight);
+            io.DeltaTime = 1.0f / 60.0f;
+        }
+        FrameArena::Shared().Reset();
+        ImGui::NewFrame();
+        
+        // Keyboard shortcuts go through ImGui so that recordings replay them too.
+        // They are off while a text field has focus, so typing never triggers them.
+        bool shortcuts = !io.WantTextInput;
         
         // Check for 'q' key press to exit
-        if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS) {
-            glfwSetWindowShouldClose(window, GLFW_TRUE);
+        if (shortcuts && ImGui::IsKeyDown(ImGuiKey_Q)) {
+            quit = true;
         }
         
         // Check for 's' key press to save CSV
-        static bool sPrevPressed = false;
-        bool sCurrentPressed = glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS;
-        if (sCurrentPressed && !sPrevPressed) {
-            viewer.SaveCSV();
+        if (shortcuts && ImGui::IsKeyPressed(ImGuiKey_S, false)) {
+            if (multiView.Active()) {
+                multiView.SaveAll();
+            } else {
+                viewer.SaveCSV();
+            }
         }
-        sPrevPressed = sCurrentPressed;
-        
-        // Start the Dear ImGui frame
-        ImGui_ImplOpenGL3_NewFrame();
-        ImGui_ImplGlfw_NewFrame();
-        ImGui::NewFrame();
         
         // Check for arrow key presses using ImGui (after ImGui::NewFrame())
-        if (ImGui::IsKeyPressed(ImGuiKey_LeftArrow)) {
-            viewer.NavigatePrevious();
+        // In multi-view mode they step all cameras together
+        if (shortcuts && ImGui::IsKeyPressed(ImGuiKey_LeftArrow)) {
+            if (multiView.Active()) {
+                multiView.StepBy(-1);
+            } else {
+                viewer.NavigatePrevious();
+            }
         }
         
-        if (ImGui::IsKeyPressed(ImGuiKey_RightArrow)) {
-            viewer.NavigateNext();
+        if (shortcuts && ImGui::IsKeyPressed(ImGuiKey_RightArrow)) {
+            if (multiView.Active()) {
+                multiView.StepBy(1);
+            } else {
+                viewer.NavigateNext();
+            }
         }
         
         // Check for 'L' key press to load CSV
-        if (ImGui::IsKeyPressed(ImGuiKey_L)) {
-            viewer.LoadCSV();
+        if (shortcuts && ImGui::IsKeyPressed(ImGuiKey_L)) {
+            if (multiView.Active()) {
+                multiView.LoadAll();
+            } else {
+                viewer.LoadCSV();
+            }
+        }
+        
+        // Check for 'T' key press to toggle the dataset statistics panel
+        if (shortcuts && ImGui::IsKeyPressed(ImGuiKey_T)) {
+            viewer.ToggleStatsPanel();
+        }
+        
+        // Digit keys pick the class for new boxes and relabel the current one
+        for (int digit = 0; shortcuts && digit <= 9; digit++) {
+            if (!ImGui::IsKeyPressed((ImGuiKey)(ImGuiKey_0 + digit), false)) continue;
+            if (multiView.Active()) {
+                multiView.SetActiveClass((uint16_t)digit);
+            } else {
+                viewer.SetActiveClass((uint16_t)digit);
+            }
+        }
+        
+        // 'V' shows only the active class (again for all); 'N' / Shift+'N' jump to the
+        // next / previous image containing it (the other cameras follow the primary)
+        if (shortcuts && ImGui::IsKeyPressed(ImGuiKey_V, false)) {
+            if (multiView.Active()) {
+                multiView.ToggleActiveClassOnly();
+            } else {
+                viewer.ToggleActiveClassOnly();
+            }
+        }
+        if (shortcuts && ImGui::IsKeyPressed(ImGuiKey_N)) {
+            viewer.NavigateToClass(viewer.ActiveClass(), !io.KeyShift);
         }
         
         // Render image viewer
-        viewer.Render();
+        if (multiView.Active()) {
+            multiView.Render();
+        } else {
+            viewer.Render();
+        }
+        viewer.RenderStatsPanel();
         
         // Rendering
         ImGui::Render();
         int display_w, display_h;
-        glfwGetFramebufferSize(window, &display_w, &display_h);
+        if (window) {
+            glfwGetFramebufferSize(window, &display_w, &display_h);
+        } else {
+            display_w = (int)(io.DisplaySize.x * io.DisplayFramebufferScale.x);
+            display_h = (int)(io.DisplaySize.y * io.DisplayFramebufferScale.y);
+            headlessContext.Bind(display_w, display_h);
+            display_w = headlessContext.Width();
+            display_h = headlessContext.Height();
+        }
         glViewport(0, 0, display_w, display_h);
         glClearColor(0.45f, 0.55f, 0.60f, 1.00f);
         glClear(GL_COLOR_BUFFER_BIT);
+        viewer.GetGpuTimer().Mark(GpuTimer::RenderBegin);
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        viewer.GetGpuTimer().Mark(GpuTimer::RenderEnd);
+        viewer.GetGpuTimer().EndFrame();
+        if (capturing) {
+            readback.Queue(frameIndex, display_w, display_h);
+            readback.Poll();
+        }
+        if (profiling) {
+            const FrameArena::FrameStats& arenaStats = FrameArena::Shared().CurrentFrame();
+            profiler.EndFrame(viewer.TakeUploadMilliseconds(), arenaStats.bytes, arenaStats.refills);
+        }
+        // GPU results arrive a few frames late; drained every frame so they don't pile up
+        for (const GpuFrameTimes& times : viewer.GetGpuTimer().TakeCompleted()) {
+            if (profiling) profiler.SetGpuTimes((size_t)times.frame, times.uploadMs, times.imageMs, times.overlayMs, times.renderMs);
+        }
         
-        glfwSwapBuffers(window);
+        if (window) {
+            glfwSwapBuffers(window);
+            pacer.EndFrame();
+        }
+        frameIndex++;
     }
     
+    readback.Release();
+    viewer.GetGpuTimer().Finish();
+    for (const GpuFrameTimes& times : viewer.GetGpuTimer().TakeCompleted()) {
+        if (profiling) profiler.SetGpuTimes((size_t)times.frame, times.uploadMs, times.imageMs, times.overlayMs, times.renderMs);
+    }
+    viewer.GetGpuTimer().Release();
+    for (auto& write : captureWrites) {
+        write.get();
+    }
+    if (capturing) {
+        std::cout << "Captured " << frameIndex << " frames to: " << options.captureDirectory << std::endl;
+    }
+    recorder.Close();
+    if (profiling) {
+        profiler.PrintSummary(std::cout);
+        if (!options.frameReportPath.empty()) {
+            profiler.WriteReport(options.frameReportPath);
+        }
+    }
+    if (frameCache) {
+        std::cout << frameCache->Describe() << std::endl;
+    }
+    if (spillCache && spillCache->Enabled()) {
+        std::cout << spillCache->Describe() << std::endl;
+    }
+    WriteMemoryReport(options);
+    
     // Cleanup
     ImGui_ImplOpenGL3_Shutdown();
-    ImGui_ImplGlfw_Shutdown();
+    if (window) {
+        ImGui_ImplGlfw_Shutdown();
+    }
     ImGui::DestroyContext();
     
-    glfwDestroyWindow(window);
-    glfwTerminate();
+    if (window) {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+    }
     
     return 0;
 }
\ No newline at end of file
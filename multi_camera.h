@@ -0,0 +1,171 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "annotation_index.h"
+
+enum class CameraSync {
+    Index,      // step N shows the Nth image of every camera
+    Timestamp   // step N shows the reference camera's Nth image and each other camera's nearest timestamp
+};
+
+// Timestamp of a capture file: the last run of digits in the file name
+// (e.g. cam0_1699999999123.jpg or frame_000042.png). Returns false if the name
+// has no digits.
+inline bool ParseFrameTimestamp(const std::string& path, int64_t& timestamp) {
+    std::string stem = std::filesystem::path(path).stem().string();
+    size_t end = stem.size();
+    while (end > 0 && !std::isdigit((unsigned char)stem[end - 1])) end--;
+    size_t begin = end;
+    while (begin > 0 && std::isdigit((unsigned char)stem[begin - 1])) begin--;
+    if (begin == end || end - begin > 18) return false;
+    timestamp = std::stoll(stem.substr(begin, end - begin));
+    return true;
+}
+
+// A capture rig: one sibling folder of images per camera, aligned into
+// timesteps. The first camera (in folder name order) is the reference.
+class CameraRig {
+public:
+    struct Camera {
+        std::string name;
+        std::string directory;
+        std::vector<std::string> images;
+        std::vector<std::pair<int64_t, size_t>> timestamps;  // sorted (timestamp, image index)
+    };
+
+private:
+    std::vector<Camera> cameras;
+    std::vector<std::vector<int>> steps;  // steps[step][camera] = image index, -1 if the camera has none
+    CameraSync sync = CameraSync::Index;
+
+public:
+    // Every immediate subfolder of root that contains images is a camera
+    bool Open(const std::string& root, CameraSync syncMode) {
+        cameras.clear();
+        steps.clear();
+        sync = syncMode;
+
+        std::error_code error;
+        std::vector<std::string> directories;
+        for (const auto& entry : std::filesystem::directory_iterator(root, error)) {
+            if (entry.is_directory()) directories.push_back(entry.path().string());
+        }
+        std::sort(directories.begin(), directories.end());
+        for (const std::string& directory : directories) {
+            Camera camera;
+            camera.directory = directory;
+            camera.name = std::filesystem::path(directory).filename().string();
+            camera.images = ListImageFiles(directory);
+            if (camera.images.empty()) continue;
+            for (size_t i = 0; i < camera.images.size(); i++) {
+                int64_t timestamp;
+                if (ParseFrameTimestamp(camera.images[i], timestamp)) camera.timestamps.emplace_back(timestamp, i);
+            }
+            std::sort(camera.timestamps.begin(), camera.timestamps.end());
+            cameras.push_back(std::move(camera));
+        }
+        if (cameras.empty()) {
+            std::cerr << "No camera folders with images in: " << root << std::endl;
+            return false;
+        }
+
+        if (sync == CameraSync::Timestamp) {
+            AlignByTimestamp();
+        } else {
+            AlignByIndex();
+        }
+        std::cout << "Opened " << cameras.size() << " cameras, " << steps.size() << " synchronized steps ("
+                  << (sync == CameraSync::Timestamp ? "timestamp" : "index") << " sync)" << std::endl;
+        return !steps.empty();
+    }
+
+    size_t CameraCount() const { return cameras.size(); }
+    size_t StepCount() const { return steps.size(); }
+    const Camera& GetCamera(size_t camera) const { return cameras[camera]; }
+
+    // Image of a camera at a step, or an empty string if it has none
+    const std::string& FramePath(size_t step, size_t camera) const {
+        static const std::string none;
+        int image = steps[step][camera];
+        return image >= 0 ? cameras[camera].images[image] : none;
+    }
+
+    // Step showing the given image of a camera, or -1
+    int StepOf(size_t camera, const std::string& path) const {
+        for (size_t step = 0; step < steps.size(); step++) {
+            int image = steps[step][camera];
+            if (image >= 0 && cameras[camera].images[image] == path) return (int)step;
+        }
+        return -1;
+    }
+
+    // Images of every camera for the steps in [first, last], clamped to the timeline
+    std::vector<std::string> FramePaths(int first, int last) const {
+        std::vector<std::string> paths;
+        first = std::max(first, 0);
+        last = std::min(last, (int)steps.size() - 1);
+        for (int step = first; step <= last; step++) {
+            for (size_t camera = 0; camera < cameras.size(); camera++) {
+                const std::string& path = FramePath(step, camera);
+                if (!path.empty()) paths.push_back(path);
+            }
+        }
+        return paths;
+    }
+
+private:
+    void AlignByIndex() {
+        size_t count = cameras[0].images.size();
+        for (const Camera& camera : cameras) {
+            if (camera.images.size() != cameras[0].images.size()) {
+                std::cerr << "Warning: camera " << camera.name << " has " << camera.images.size() << " images, "
+                          << cameras[0].name << " has " << cameras[0].images.size() << "; extra images are not shown"
+                          << std::endl;
+            }
+            count = std::min(count, camera.images.size());
+        }
+        steps.assign(count, std::vector<int>(cameras.size()));
+        for (size_t step = 0; step < count; step++) {
+            for (size_t camera = 0; camera < cameras.size(); camera++) {
+                steps[step][camera] = (int)step;
+            }
+        }
+    }
+
+    // Each reference frame is a step; other cameras contribute their frame
+    // with the nearest timestamp
+    void AlignByTimestamp() {
+        const Camera& reference = cameras[0];
+        if (reference.timestamps.empty()) {
+            std::cerr << "Reference camera " << reference.name << " has no timestamped file names, using index sync" << std::endl;
+            sync = CameraSync::Index;
+            AlignByIndex();
+            return;
+        }
+        for (const auto& frame : reference.timestamps) {
+            std::vector<int> row(cameras.size(), -1);
+            row[0] = (int)frame.second;
+            for (size_t camera = 1; camera < cameras.size(); camera++) {
+                row[camera] = Nearest(cameras[camera], frame.first);
+            }
+            steps.push_back(std::move(row));
+        }
+    }
+
+    static int Nearest(const Camera& camera, int64_t timestamp) {
+        const auto& stamps = camera.timestamps;
+        if (stamps.empty()) return -1;
+        auto it = std::lower_bound(stamps.begin(), stamps.end(), std::make_pair(timestamp, (size_t)0));
+        if (it == stamps.end()) return (int)stamps.back().second;
+        if (it != stamps.begin() && timestamp - std::prev(it)->first < it->first - timestamp) --it;
+        return (int)it->second;
+    }
+};
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <imgui.h>
+
+// Retained overlay geometry.
+//
+// The first time a block is drawn, the vertices and indices its build
+// callback appends to the draw list are captured. While the caller's state key
+// and the layout inputs (display size, font, clip rectangle) stay the same,
+// later frames copy that geometry straight back into the draw list without
+// running the callback, so text formatting and CalcTextSize happen only when
+// something visible changed.
+class RetainedDrawBlock {
+private:
+    std::vector<ImDrawVert> vertices;
+    std::vector<ImDrawIdx> indices;  // relative to the first captured vertex
+    bool valid = false;
+
+    uint64_t key = 0;
+    ImVec2 displaySize;
+    ImFont* font = nullptr;
+    float fontSize = 0.0f;
+    ImVec2 clipMin, clipMax;
+
+    uint64_t rebuilds = 0;
+    uint64_t replays = 0;
+
+public:
+    template <typename BuildFn>
+    void Draw(ImDrawList* drawList, uint64_t stateKey, BuildFn&& build) {
+        ImGuiIO& io = ImGui::GetIO();
+        ImVec2 currentClipMin = drawList->GetClipRectMin();
+        ImVec2 currentClipMax = drawList->GetClipRectMax();
+        bool unchanged = valid && key == stateKey && font == ImGui::GetFont() && fontSize == ImGui::GetFontSize() &&
+                         SameVec(displaySize, io.DisplaySize) && SameVec(clipMin, currentClipMin) &&
+                         SameVec(clipMax, currentClipMax);
+        if (unchanged) {
+            Replay(drawList);
+            replays++;
+            return;
+        }
+
+        int vertexStart = drawList->VtxBuffer.Size;
+        int indexStart = drawList->IdxBuffer.Size;
+        unsigned int baseIndex = drawList->_VtxCurrentIdx;
+        build(drawList);
+        rebuilds++;
+
+        key = stateKey;
+        displaySize = io.DisplaySize;
+        font = ImGui::GetFont();
+        fontSize = ImGui::GetFontSize();
+        clipMin = currentClipMin;
+        clipMax = currentClipMax;
+
+        // Capturing is only exact if the callback's indices all refer to one
+        // contiguous vertex range, i.e. the draw list did not start a new
+        // vertex offset (64K-vertex wrap) while building
+        int vertexCount = drawList->VtxBuffer.Size - vertexStart;
+        int indexCount = drawList->IdxBuffer.Size - indexStart;
+        valid = drawList->_VtxCurrentIdx >= baseIndex && drawList->_VtxCurrentIdx - baseIndex == (unsigned int)vertexCount;
+        if (!valid) return;
+
+        vertices.assign(drawList->VtxBuffer.Data + vertexStart, drawList->VtxBuffer.Data + vertexStart + vertexCount);
+        indices.resize(indexCount);
+        for (int i = 0; i < indexCount; i++) {
+            indices[i] = (ImDrawIdx)(drawList->IdxBuffer.Data[indexStart + i] - baseIndex);
+        }
+    }
+
+    void Invalidate() { valid = false; }
+
+    uint64_t Rebuilds() const { return rebuilds; }
+    uint64_t Replays() const { return replays; }
+
+private:
+    static bool SameVec(const ImVec2& a, const ImVec2& b) {
+        return a.x == b.x && a.y == b.y;
+    }
+
+    void Replay(ImDrawList* drawList) {
+        if (vertices.empty()) return;
+        drawList->PrimReserve((int)indices.size(), (int)vertices.size());
+        std::memcpy(drawList->_VtxWritePtr, vertices.data(), vertices.size() * sizeof(ImDrawVert));
+        ImDrawIdx base = (ImDrawIdx)drawList->_VtxCurrentIdx;
+        for (size_t i = 0; i < indices.size(); i++) {
+            drawList->_IdxWritePtr[i] = (ImDrawIdx)(indices[i] + base);
+        }
+        drawList->_VtxWritePtr += vertices.size();
+        drawList->_IdxWritePtr += indices.size();
+        drawList->_VtxCurrentIdx += (unsigned int)vertices.size();
+    }
+};
@@ -0,0 +1,604 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define J_BBOX_PIXEL_SIMD 1
+#include <immintrin.h>
+#endif
+
+// Pixel conversion kernels for the decode and preview paths.
+//
+// Every kernel is a template specialized at compile time on the source
+// layout, the destination layout and the channel depth, so the per-pixel
+// channel mapping is a constant and the inner loops have no branches. Each
+// specialization is compiled once per instruction set (baseline, SSE4.1, AVX2,
+// AVX-512BW) through target attributes, and the runtime entry points pick the
+// instantiation for the image's layout and the best level the CPU supports.
+// 8- and 16-bit swizzles use hand-written byte shuffles; 8-bit downscales
+// by 2, 4 and 8 use a fused AVX2 kernel that swaps channels while it
+// averages; the rest rely on the compiler vectorizing the specialized loops
+// for each level. tests/pixel_kernel_tests.cpp checks every level against
+// OpenCV; its --benchmark option times the fused downscale against
+// cvtColor + resize.
+
+enum class PixelLayout {
+    Gray,
+    BGR,   // OpenCV's decode order
+    BGRA,
+    RGB,   // texture upload order
+    RGBA
+};
+
+inline const char* PixelLayoutName(PixelLayout layout) {
+    switch (layout) {
+        case PixelLayout::Gray: return "gray";
+        case PixelLayout::BGR: return "bgr";
+        case PixelLayout::BGRA: return "bgra";
+        case PixelLayout::RGB: return "rgb";
+        case PixelLayout::RGBA: return "rgba";
+        default: return "unknown";
+    }
+}
+
+// Layout OpenCV decoders produce for a channel count
+inline PixelLayout DecodedLayout(int channels) {
+    switch (channels) {
+        case 1: return PixelLayout::Gray;
+        case 4: return PixelLayout::BGRA;
+        default: return PixelLayout::BGR;
+    }
+}
+
+enum class SimdLevel {
+    Scalar,  // baseline build flags
+    Sse41,
+    Avx2,
+    Avx512
+};
+
+inline const char* SimdLevelName(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::Scalar: return "scalar";
+        case SimdLevel::Sse41: return "sse4.1";
+        case SimdLevel::Avx2: return "avx2";
+        case SimdLevel::Avx512: return "avx512";
+        default: return "unknown";
+    }
+}
+
+// Highest kernel level this CPU runs
+inline SimdLevel DetectSimdLevel() {
+#if defined(J_BBOX_PIXEL_SIMD)
+    static const SimdLevel level = []() {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) return SimdLevel::Avx512;
+        if (__builtin_cpu_supports("avx2")) return SimdLevel::Avx2;
+        if (__builtin_cpu_supports("sse4.1") && __builtin_cpu_supports("ssse3")) return SimdLevel::Sse41;
+        return SimdLevel::Scalar;
+    }();
+    return level;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+namespace pixel_kernels {
+
+// Channel positions of a layout; -1 marks a channel the layout lacks
+template <PixelLayout L> struct LayoutTraits;
+template <> struct LayoutTraits<PixelLayout::Gray> { static constexpr int channels = 1, r = 0, g = 0, b = 0, a = -1; };
+template <> struct LayoutTraits<PixelLayout::BGR> { static constexpr int channels = 3, r = 2, g = 1, b = 0, a = -1; };
+template <> struct LayoutTraits<PixelLayout::BGRA> { static constexpr int channels = 4, r = 2, g = 1, b = 0, a = 3; };
+template <> struct LayoutTraits<PixelLayout::RGB> { static constexpr int channels = 3, r = 0, g = 1, b = 2, a = -1; };
+template <> struct LayoutTraits<PixelLayout::RGBA> { static constexpr int channels = 4, r = 0, g = 1, b = 2, a = 3; };
+
+// For each destination channel, the source channel it copies; -1 fills an
+// opaque alpha the source does not have
+template <PixelLayout Src, PixelLayout Dst>
+constexpr std::array<int, 4> ChannelMap() {
+    using S = LayoutTraits<Src>;
+    using D = LayoutTraits<Dst>;
+    std::array<int, 4> map = {-1, -1, -1, -1};
+    for (int c = 0; c < D::channels; c++) {
+        if (c == D::a) {
+            map[c] = S::a;
+        } else if (c == D::r) {
+            map[c] = S::r;
+        } else if (c == D::g) {
+            map[c] = S::g;
+        } else {
+            map[c] = S::b;
+        }
+    }
+    return map;
+}
+
+template <typename T>
+constexpr T OpaqueAlpha() {
+    return std::is_floating_point<T>::value ? (T)1 : std::numeric_limits<T>::max();
+}
+
+// Scale that maps a depth's full range to [0, 1]
+template <typename T>
+constexpr float UnitScale() {
+    return std::is_floating_point<T>::value ? 1.0f : 1.0f / (float)std::numeric_limits<T>::max();
+}
+
+// ---- Scalar kernels: one image row, fully specialized ----------------------
+
+template <PixelLayout Src, PixelLayout Dst, typename T>
+inline void SwizzleRow(const T* __restrict src, T* __restrict dst, size_t pixels) {
+    constexpr int sc = LayoutTraits<Src>::channels;
+    constexpr int dc = LayoutTraits<Dst>::channels;
+    constexpr std::array<int, 4> map = ChannelMap<Src, Dst>();
+    for (size_t i = 0; i < pixels; i++) {
+        for (int c = 0; c < dc; c++) {
+            dst[i * dc + c] = map[c] >= 0 ? src[i * sc + map[c]] : OpaqueAlpha<T>();
+        }
+    }
+}
+
+template <PixelLayout Src, PixelLayout Dst, typename T>
+inline void NormalizeRow(const T* __restrict src, float* __restrict dst, size_t pixels) {
+    constexpr int sc = LayoutTraits<Src>::channels;
+    constexpr int dc = LayoutTraits<Dst>::channels;
+    constexpr std::array<int, 4> map = ChannelMap<Src, Dst>();
+    constexpr float scale = UnitScale<T>();
+    for (size_t i = 0; i < pixels; i++) {
+        for (int c = 0; c < dc; c++) {
+            dst[i * dc + c] = map[c] >= 0 ? (float)src[i * sc + map[c]] * scale : 1.0f;
+        }
+    }
+}
+
+// Averages factor x factor source blocks into dst (dst.cols * factor source
+// columns of factor source rows). sums is scratch of dst.cols * source channels.
+template <PixelLayout Src, PixelLayout Dst, typename T>
+inline void DownscaleRow(const T* const* __restrict rows, int factor, T* __restrict dst, size_t dstPixels,
+                         uint32_t* __restrict sums) {
+    constexpr int sc = LayoutTraits<Src>::channels;
+    constexpr int dc = LayoutTraits<Dst>::channels;
+    constexpr std::array<int, 4> map = ChannelMap<Src, Dst>();
+    size_t width = dstPixels * sc;
+    std::fill(sums, sums + width, 0u);
+    for (int dy = 0; dy < factor; dy++) {
+        const T* src = rows[dy];
+        for (size_t x = 0; x < dstPixels; x++) {
+            const T* block = src + x * factor * sc;
+            for (int dx = 0; dx < factor; dx++) {
+                for (int c = 0; c < sc; c++) {
+                    sums[x * sc + c] += block[dx * sc + c];
+                }
+            }
+        }
+    }
+    uint32_t area = (uint32_t)(factor * factor);
+    for (size_t x = 0; x < dstPixels; x++) {
+        for (int c = 0; c < dc; c++) {
+            dst[x * dc + c] = map[c] >= 0 ? (T)((sums[x * sc + map[c]] + area / 2) / area) : OpaqueAlpha<T>();
+        }
+    }
+}
+
+// ---- Byte-shuffle swizzle (8- and 16-bit) ----------------------------------
+
+// One 16-byte shuffle converts Pixels pixels; bytes past the block are zeroed
+// by the mask and overwritten by the next block or the scalar tail
+template <PixelLayout Src, PixelLayout Dst, typename T>
+struct ShuffleBlock {
+    static constexpr int sc = LayoutTraits<Src>::channels;
+    static constexpr int dc = LayoutTraits<Dst>::channels;
+    static constexpr int E = (int)sizeof(T);
+    static constexpr int Pixels = std::min(16 / (sc * E), 16 / (dc * E));
+    static constexpr int SrcBytes = Pixels * sc * E;
+    static constexpr int DstBytes = Pixels * dc * E;
+    // Pixels left after a block start so its 16-byte load and store stay in the row
+    static constexpr int Guard = std::max({Pixels, (16 + sc * E - 1) / (sc * E), (16 + dc * E - 1) / (dc * E)});
+
+    static constexpr std::array<uint8_t, 16> Mask() {
+        constexpr std::array<int, 4> map = ChannelMap<Src, Dst>();
+        std::array<uint8_t, 16> mask = {};
+        for (int k = 0; k < 16; k++) {
+            int element = k / E;
+            int pixel = element / dc;
+            int channel = element % dc;
+            mask[k] = k < DstBytes && map[channel] >= 0 ? (uint8_t)((pixel * sc + map[channel]) * E + k % E) : 0x80;
+        }
+        return mask;
+    }
+
+    static constexpr std::array<uint8_t, 16> Alpha() {
+        constexpr std::array<int, 4> map = ChannelMap<Src, Dst>();
+        std::array<uint8_t, 16> alpha = {};
+        for (int k = 0; k < DstBytes; k++) {
+            alpha[k] = map[(k / E) % dc] < 0 ? 0xFF : 0x00;
+        }
+        return alpha;
+    }
+
+    static constexpr bool HasAlphaFill() {
+        constexpr std::array<int, 4> map = ChannelMap<Src, Dst>();
+        for (int c = 0; c < dc; c++) {
+            if (map[c] < 0) return true;
+        }
+        return false;
+    }
+};
+
+#if defined(J_BBOX_PIXEL_SIMD)
+
+template <PixelLayout Src, PixelLayout Dst, typename T>
+__attribute__((target("ssse3,sse4.1"))) void SwizzleRowSse41(const T* src, T* dst, size_t pixels) {
+    using B = ShuffleBlock<Src, Dst, T>;
+    static constexpr std::array<uint8_t, 16> maskBytes = B::Mask();
+    static constexpr std::array<uint8_t, 16> alphaBytes = B::Alpha();
+    const __m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i*>(maskBytes.data()));
+    const __m128i alpha = _mm_loadu_si128(reinterpret_cast<const __m128i*>(alphaBytes.data()));
+    const uint8_t* in = reinterpret_cast<const uint8_t*>(src);
+    uint8_t* out = reinterpret_cast<uint8_t*>(dst);
+    size_t i = 0;
+    for (; i + B::Guard <= pixels; i += B::Pixels) {
+        __m128i v = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i * B::sc * B::E)), mask);
+        if (B::HasAlphaFill()) v = _mm_or_si128(v, alpha);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * B::dc * B::E), v);
+    }
+    SwizzleRow<Src, Dst, T>(src + i * B::sc, dst + i * B::dc, pixels - i);
+}
+
+template <PixelLayout Src, PixelLayout Dst, typename T>
+__attribute__((target("avx2"))) void SwizzleRowAvx2(const T* src, T* dst, size_t pixels) {
+    using B = ShuffleBlock<Src, Dst, T>;
+    static constexpr std::array<uint8_t, 16> maskBytes = B::Mask();
+    static constexpr std::array<uint8_t, 16> alphaBytes = B::Alpha();
+    const __m256i mask = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(maskBytes.data())));
+    const __m256i alpha = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(alphaBytes.data())));
+    const uint8_t* in = reinterpret_cast<const uint8_t*>(src);
+    uint8_t* out = reinterpret_cast<uint8_t*>(dst);
+    constexpr size_t sb = B::SrcBytes, db = B::DstBytes;
+    size_t i = 0;
+    // Two blocks per iteration, one per 128-bit lane (vpshufb does not cross lanes)
+    for (; i + B::Pixels + B::Guard <= pixels; i += 2 * B::Pixels) {
+        const uint8_t* s = in + i * B::sc * B::E;
+        uint8_t* d = out + i * B::dc * B::E;
+        __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s))),
+                                            _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + sb)), 1);
+        v = _mm256_shuffle_epi8(v, mask);
+        if (B::HasAlphaFill()) v = _mm256_or_si256(v, alpha);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(d), _mm256_castsi256_si128(v));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(d + db), _mm256_extracti128_si256(v, 1));
+    }
+    SwizzleRow<Src, Dst, T>(src + i * B::sc, dst + i * B::dc, pixels - i);
+}
+
+template <PixelLayout Src, PixelLayout Dst, typename T>
+__attribute__((target("avx512f,avx512bw"))) void SwizzleRowAvx512(const T* src, T* dst, size_t pixels) {
+    using B = ShuffleBlock<Src, Dst, T>;
+    static constexpr std::array<uint8_t, 16> maskBytes = B::Mask();
+    static constexpr std::array<uint8_t, 16> alphaBytes = B::Alpha();
+    const __m512i mask = _mm512_broadcast_i32x4(_mm_loadu_si128(reinterpret_cast<const __m128i*>(maskBytes.data())));
+    const __m512i alpha = _mm512_broadcast_i32x4(_mm_loadu_si128(reinterpret_cast<const __m128i*>(alphaBytes.data())));
+    const uint8_t* in = reinterpret_cast<const uint8_t*>(src);
+    uint8_t* out = reinterpret_cast<uint8_t*>(dst);
+    constexpr size_t sb = B::SrcBytes, db = B::DstBytes;
+    size_t i = 0;
+    // Four blocks per iteration, one per 128-bit lane
+    for (; i + 3 * B::Pixels + B::Guard <= pixels; i += 4 * B::Pixels) {
+        const uint8_t* s = in + i * B::sc * B::E;
+        uint8_t* d = out + i * B::dc * B::E;
+        __m512i v = _mm512_castsi128_si512(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s)));
+        v = _mm512_inserti32x4(v, _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + sb)), 1);
+        v = _mm512_inserti32x4(v, _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 2 * sb)), 2);
+        v = _mm512_inserti32x4(v, _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 3 * sb)), 3);
+        v = _mm512_shuffle_epi8(v, mask);
+        if (B::HasAlphaFill()) v = _mm512_or_si512(v, alpha);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(d), _mm512_castsi512_si128(v));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(d + db), _mm512_extracti32x4_epi32(v, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(d + 2 * db), _mm512_extracti32x4_epi32(v, 2));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(d + 3 * db), _mm512_extracti32x4_epi32(v, 3));
+    }
+    SwizzleRow<Src, Dst, T>(src + i * B::sc, dst + i * B::dc, pixels - i);
+}
+
+// Downscale and normalize: the specialized scalar loops, vectorized by the
+// compiler for each level
+template <PixelLayout Src, PixelLayout Dst, typename T>
+__attribute__((target("ssse3,sse4.1"))) void NormalizeRowSse41(const T* src, float* dst, size_t pixels) {
+    NormalizeRow<Src, Dst, T>(src, dst, pixels);
+}
+template <PixelLayout Src, PixelLayout Dst, typename T>
+__attribute__((target("avx2,fma"))) void NormalizeRowAvx2(const T* src, float* dst, size_t pixels) {
+    NormalizeRow<Src, Dst, T>(src, dst, pixels);
+}
+template <PixelLayout Src, PixelLayout Dst, typename T>
+__attribute__((target("avx512f,avx512bw"))) void NormalizeRowAvx512(const T* src, float* dst, size_t pixels) {
+    NormalizeRow<Src, Dst, T>(src, dst, pixels);
+}
+
+template <PixelLayout Src, PixelLayout Dst, typename T>
+__attribute__((target("ssse3,sse4.1"))) void DownscaleRowSse41(const T* const* rows, int factor, T* dst, size_t dstPixels,
+                                                              uint32_t* sums) {
+    DownscaleRow<Src, Dst, T>(rows, factor, dst, dstPixels, sums);
+}
+template <PixelLayout Src, PixelLayout Dst, typename T>
+__attribute__((target("avx2"))) void DownscaleRowAvx2(const T* const* rows, int factor, T* dst, size_t dstPixels,
+                                                     uint32_t* sums) {
+    DownscaleRow<Src, Dst, T>(rows, factor, dst, dstPixels, sums);
+}
+template <PixelLayout Src, PixelLayout Dst, typename T>
+__attribute__((target("avx512f,avx512bw"))) void DownscaleRowAvx512(const T* const* rows, int factor, T* dst,
+                                                                   size_t dstPixels, uint32_t* sums) {
+    DownscaleRow<Src, Dst, T>(rows, factor, dst, dstPixels, sums);
+}
+
+// ---- Fused 8-bit swizzle + area downscale ----------------------------------
+
+// One pass over Factor source rows, tiled so the column sums stay in L1:
+// the rows are summed vertically in 16-bit lanes, neighbouring pixels are
+// added with shifted loads, the block average is rounded with a shift, and
+// the channel swap happens while the averages are written out. The source is
+// read once and nothing full-size is written, where cvtColor + resize reads
+// the source, writes a converted copy and reads that copy again.
+template <PixelLayout Src, PixelLayout Dst, int Factor>
+__attribute__((target("avx2"))) void DownscaleRowFusedAvx2(const uint8_t* const* rows, uint8_t* dst, size_t dstPixels) {
+    constexpr int sc = LayoutTraits<Src>::channels;
+    constexpr int dc = LayoutTraits<Dst>::channels;
+    constexpr std::array<int, 4> map = ChannelMap<Src, Dst>();
+    constexpr int shift = Factor == 2 ? 2 : Factor == 4 ? 4 : 6;  // log2(Factor * Factor)
+    constexpr size_t kTileValues = 4096;                         // 8 KiB of 16-bit sums
+    constexpr size_t kTilePixels = kTileValues / (Factor * sc);
+    // Room for the last 16-lane block and the shifted loads past it
+    alignas(32) uint16_t sums[kTileValues + 16 + (Factor - 1) * sc];
+    const __m256i half = _mm256_set1_epi16((short)(1 << (shift - 1)));
+
+    for (size_t x0 = 0; x0 < dstPixels; x0 += kTilePixels) {
+        size_t pixels = std::min(kTilePixels, dstPixels - x0);
+        size_t values = pixels * Factor * sc;
+        size_t offset = x0 * Factor * sc;
+
+        // Vertical: Factor rows into 16-bit sums (at most 64 * 255)
+        size_t k = 0;
+        for (; k + 16 <= values; k += 16) {
+            __m256i sum = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[0] + offset + k)));
+            for (int dy = 1; dy < Factor; dy++) {
+                __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[dy] + offset + k));
+                sum = _mm256_add_epi16(sum, _mm256_cvtepu8_epi16(next));
+            }
+            _mm256_store_si256(reinterpret_cast<__m256i*>(sums + k), sum);
+        }
+        for (; k < values; k++) {
+            uint16_t sum = 0;
+            for (int dy = 0; dy < Factor; dy++) sum += rows[dy][offset + k];
+            sums[k] = sum;
+        }
+        std::fill(sums + values, sums + ((values + 15) & ~(size_t)15) + (Factor - 1) * sc, (uint16_t)0);
+
+        // Horizontal: sums[k] += the next Factor - 1 pixels' sums, then round.
+        // In place is safe because each block reads only at or after itself.
+        for (k = 0; k < values; k += 16) {
+            __m256i sum = _mm256_load_si256(reinterpret_cast<const __m256i*>(sums + k));
+            for (int dx = 1; dx < Factor; dx++) {
+                sum = _mm256_add_epi16(sum, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sums + k + dx * sc)));
+            }
+            sum = _mm256_srli_epi16(_mm256_add_epi16(sum, half), shift);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(sums + k), sum);
+        }
+
+        // Each block's averages sit at its first source pixel; swap on the way out
+        uint8_t* out = dst + x0 * dc;
+        for (size_t x = 0; x < pixels; x++) {
+            const uint16_t* block = sums + x * Factor * sc;
+            for (int c = 0; c < dc; c++) {
+                out[x * dc + c] = map[c] >= 0 ? (uint8_t)block[map[c]] : (uint8_t)255;
+            }
+        }
+    }
+}
+
+// Fused path for the power-of-two factors previews use; other factors fall
+// back to the specialized loop at the same level
+template <PixelLayout Src, PixelLayout Dst, bool Avx512>
+void DownscaleRowFused(const uint8_t* const* rows, int factor, uint8_t* dst, size_t dstPixels, uint32_t* sums) {
+    switch (factor) {
+        case 2: DownscaleRowFusedAvx2<Src, Dst, 2>(rows, dst, dstPixels); return;
+        case 4: DownscaleRowFusedAvx2<Src, Dst, 4>(rows, dst, dstPixels); return;
+        case 8: DownscaleRowFusedAvx2<Src, Dst, 8>(rows, dst, dstPixels); return;
+        default: break;
+    }
+    if (Avx512) {
+        DownscaleRowAvx512<Src, Dst, uint8_t>(rows, factor, dst, dstPixels, sums);
+    } else {
+        DownscaleRowAvx2<Src, Dst, uint8_t>(rows, factor, dst, dstPixels, sums);
+    }
+}
+
+#endif
+
+template <typename T>
+using SwizzleRowFn = void (*)(const T*, T*, size_t);
+template <typename T>
+using NormalizeRowFn = void (*)(const T*, float*, size_t);
+template <typename T>
+using DownscaleRowFn = void (*)(const T* const*, int, T*, size_t, uint32_t*);
+
+template <PixelLayout Src, PixelLayout Dst, typename T>
+SwizzleRowFn<T> SelectSwizzle(SimdLevel level) {
+#if defined(J_BBOX_PIXEL_SIMD)
+    switch (level) {
+        case SimdLevel::Avx512: return &SwizzleRowAvx512<Src, Dst, T>;
+        case SimdLevel::Avx2: return &SwizzleRowAvx2<Src, Dst, T>;
+        case SimdLevel::Sse41: return &SwizzleRowSse41<Src, Dst, T>;
+        default: break;
+    }
+#endif
+    (void)level;
+    return &SwizzleRow<Src, Dst, T>;
+}
+
+template <PixelLayout Src, PixelLayout Dst, typename T>
+NormalizeRowFn<T> SelectNormalize(SimdLevel level) {
+#if defined(J_BBOX_PIXEL_SIMD)
+    switch (level) {
+        case SimdLevel::Avx512: return &NormalizeRowAvx512<Src, Dst, T>;
+        case SimdLevel::Avx2: return &NormalizeRowAvx2<Src, Dst, T>;
+        case SimdLevel::Sse41: return &NormalizeRowSse41<Src, Dst, T>;
+        default: break;
+    }
+#endif
+    (void)level;
+    return &NormalizeRow<Src, Dst, T>;
+}
+
+template <PixelLayout Src, PixelLayout Dst, typename T>
+DownscaleRowFn<T> SelectDownscale(SimdLevel level) {
+#if defined(J_BBOX_PIXEL_SIMD)
+    if constexpr (std::is_same<T, uint8_t>::value) {
+        if (level == SimdLevel::Avx512) return &DownscaleRowFused<Src, Dst, true>;
+        if (level == SimdLevel::Avx2) return &DownscaleRowFused<Src, Dst, false>;
+    }
+    switch (level) {
+        case SimdLevel::Avx512: return &DownscaleRowAvx512<Src, Dst, T>;
+        case SimdLevel::Avx2: return &DownscaleRowAvx2<Src, Dst, T>;
+        case SimdLevel::Sse41: return &DownscaleRowSse41<Src, Dst, T>;
+        default: break;
+    }
+#endif
+    (void)level;
+    return &DownscaleRow<Src, Dst, T>;
+}
+
+template <PixelLayout L>
+using LayoutTag = std::integral_constant<PixelLayout, L>;
+
+template <typename T>
+struct DepthTag {
+    using type = T;
+};
+
+// Calls visit(LayoutTag<Src>, LayoutTag<Dst>, DepthTag<T>) for the runtime
+// layouts and OpenCV depth; false if the combination has no kernel. Sources
+// are what decoders produce, destinations what uploads and encoders take.
+template <PixelLayout Src, typename Visitor>
+bool VisitDestination(PixelLayout dst, int depth, Visitor&& visit) {
+    auto withDepth = [&](auto dstTag) {
+        if (depth == CV_8U) {
+            visit(LayoutTag<Src>(), dstTag, DepthTag<uint8_t>());
+        } else if (depth == CV_16U) {
+            visit(LayoutTag<Src>(), dstTag, DepthTag<uint16_t>());
+        } else {
+            return false;
+        }
+        return true;
+    };
+    switch (dst) {
+        case PixelLayout::RGB: return withDepth(LayoutTag<PixelLayout::RGB>());
+        case PixelLayout::RGBA: return withDepth(LayoutTag<PixelLayout::RGBA>());
+        case PixelLayout::BGR: return withDepth(LayoutTag<PixelLayout::BGR>());
+        default: return false;
+    }
+}
+
+template <typename Visitor>
+bool VisitKernel(PixelLayout src, PixelLayout dst, int depth, Visitor&& visit) {
+    switch (src) {
+        case PixelLayout::Gray: return VisitDestination<PixelLayout::Gray>(dst, depth, visit);
+        case PixelLayout::BGR: return VisitDestination<PixelLayout::BGR>(dst, depth, visit);
+        case PixelLayout::BGRA: return VisitDestination<PixelLayout::BGRA>(dst, depth, visit);
+        default: return false;
+    }
+}
+
+inline int LayoutChannels(PixelLayout layout) {
+    switch (layout) {
+        case PixelLayout::Gray: return 1;
+        case PixelLayout::BGR:
+        case PixelLayout::RGB: return 3;
+        default: return 4;
+    }
+}
+
+}  // namespace pixel_kernels
+
+// Converts src (in srcLayout) to a new dstLayout image of the same depth.
+// src must not alias dst. Returns false for unsupported layouts or depths.
+inline bool SwizzlePixels(const cv::Mat& src, cv::Mat& dst, PixelLayout srcLayout, PixelLayout dstLayout,
+                          SimdLevel level = DetectSimdLevel()) {
+    using namespace pixel_kernels;
+    if (src.channels() != LayoutChannels(srcLayout)) return false;
+    return VisitKernel(srcLayout, dstLayout, src.depth(), [&](auto srcTag, auto dstTag, auto depthTag) {
+        using T = typename decltype(depthTag)::type;
+        constexpr PixelLayout S = decltype(srcTag)::value;
+        constexpr PixelLayout D = decltype(dstTag)::value;
+        SwizzleRowFn<T> row = SelectSwizzle<S, D, T>(level);
+        dst.create(src.rows, src.cols, CV_MAKETYPE(src.depth(), LayoutTraits<D>::channels));
+        if (src.isContinuous() && dst.isContinuous()) {
+            row(src.ptr<T>(0), dst.ptr<T>(0), src.total());
+            return;
+        }
+        for (int y = 0; y < src.rows; y++) {
+            row(src.ptr<T>(y), dst.ptr<T>(y), (size_t)src.cols);
+        }
+    });
+}
+
+// Converts src to a CV_32F image in dstLayout with values in [0, 1]
+inline bool NormalizePixels(const cv::Mat& src, cv::Mat& dst, PixelLayout srcLayout, PixelLayout dstLayout,
+                            SimdLevel level = DetectSimdLevel()) {
+    using namespace pixel_kernels;
+    if (src.channels() != LayoutChannels(srcLayout)) return false;
+    return VisitKernel(srcLayout, dstLayout, src.depth(), [&](auto srcTag, auto dstTag, auto depthTag) {
+        using T = typename decltype(depthTag)::type;
+        constexpr PixelLayout S = decltype(srcTag)::value;
+        constexpr PixelLayout D = decltype(dstTag)::value;
+        NormalizeRowFn<T> row = SelectNormalize<S, D, T>(level);
+        dst.create(src.rows, src.cols, CV_MAKETYPE(CV_32F, LayoutTraits<D>::channels));
+        for (int y = 0; y < src.rows; y++) {
+            row(src.ptr<T>(y), dst.ptr<float>(y), (size_t)src.cols);
+        }
+    });
+}
+
+// Area-averages src by an integer factor into dstLayout. Rows and columns
+// past the last whole factor x factor block are dropped.
+inline bool DownscalePixels(const cv::Mat& src, cv::Mat& dst, int factor, PixelLayout srcLayout, PixelLayout dstLayout,
+                            SimdLevel level = DetectSimdLevel()) {
+    using namespace pixel_kernels;
+    if (src.channels() != LayoutChannels(srcLayout) || factor < 1 || factor > 16) return false;
+    return VisitKernel(srcLayout, dstLayout, src.depth(), [&](auto srcTag, auto dstTag, auto depthTag) {
+        using T = typename decltype(depthTag)::type;
+        constexpr PixelLayout S = decltype(srcTag)::value;
+        constexpr PixelLayout D = decltype(dstTag)::value;
+        DownscaleRowFn<T> row = SelectDownscale<S, D, T>(level);
+        int dstRows = src.rows / factor;
+        int dstCols = src.cols / factor;
+        dst.create(dstRows, dstCols, CV_MAKETYPE(src.depth(), LayoutTraits<D>::channels));
+        std::vector<uint32_t> sums((size_t)dstCols * LayoutTraits<S>::channels);
+        std::vector<const T*> rows((size_t)factor);
+        for (int y = 0; y < dstRows; y++) {
+            for (int dy = 0; dy < factor; dy++) {
+                rows[dy] = src.ptr<T>(y * factor + dy);
+            }
+            row(rows.data(), factor, dst.ptr<T>(y), (size_t)dstCols, sums.data());
+        }
+    });
+}
+
+// Largest power-of-two reduction (at most 8) that keeps a width x height
+// frame at least maxWidth x maxHeight, so the display never magnifies it
+inline int ReductionFactor(int width, int height, int maxWidth, int maxHeight) {
+    if (maxWidth <= 0 || maxHeight <= 0) return 1;
+    int factor = 1;
+    while (factor < 8 && width / (factor * 2) >= maxWidth && height / (factor * 2) >= maxHeight) {
+        factor *= 2;
+    }
+    return factor;
+}
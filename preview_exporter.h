@@ -0,0 +1,345 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "annotation_index.h"
+#include "oriented_box.h"
+#include "pixel_kernels.h"
+#include "thread_pool.h"
+
+// Fills pixels [x0, x1) of a BGR row with one color. The color is expanded
+// into a 16-pixel pattern once, so the loop body is a fixed-size 48-byte copy
+// that compiles to vector stores.
+inline void FillSpanBGR(uint8_t* row, int x0, int x1, const uint8_t color[3]) {
+    if (x1 <= x0) return;
+    uint8_t pattern[48];
+    for (int i = 0; i < 16; i++) {
+        pattern[i * 3 + 0] = color[0];
+        pattern[i * 3 + 1] = color[1];
+        pattern[i * 3 + 2] = color[2];
+    }
+    uint8_t* out = row + (size_t)x0 * 3;
+    int remaining = x1 - x0;
+    for (; remaining >= 16; remaining -= 16, out += 48) {
+        std::memcpy(out, pattern, 48);
+    }
+    std::memcpy(out, pattern, (size_t)remaining * 3);
+}
+
+// Axis-aligned rectangle outline over [x0, x1) x [y0, y1) on a CV_8UC3 image,
+// drawn inward from the edges. Every stroke is a horizontal span, so the
+// whole outline costs two full-width runs per band row plus two short runs per
+// interior row.
+inline void DrawRectOutlineBGR(cv::Mat& image, int x0, int y0, int x1, int y1, const uint8_t color[3], int thickness) {
+    x0 = std::max(x0, 0);
+    y0 = std::max(y0, 0);
+    x1 = std::min(x1, image.cols);
+    y1 = std::min(y1, image.rows);
+    if (x1 <= x0 || y1 <= y0) return;
+    thickness = std::max(1, std::min(thickness, std::min(x1 - x0, y1 - y0)));
+
+    for (int y = y0; y < y1; y++) {
+        uint8_t* row = image.ptr<uint8_t>(y);
+        if (y < y0 + thickness || y >= y1 - thickness) {
+            FillSpanBGR(row, x0, x1, color);
+        } else {
+            FillSpanBGR(row, x0, x0 + thickness, color);
+            FillSpanBGR(row, x1 - thickness, x1, color);
+        }
+    }
+}
+
+struct PreviewOptions {
+    int reduction = 2;          // decode at 1/1, 1/2, 1/4 or 1/8 scale (IMREAD_REDUCED_COLOR_*)
+    int jpegQuality = 90;
+    int lineThickness = 2;
+    bool drawLabels = true;     // box number and pixel size above each box
+    int sheetColumns = 0;       // contact sheet grid; 0 disables sheets
+    int sheetRows = 0;
+    int tileWidth = 320;        // contact sheet tile size, 4:3; at least PreviewExporter::kMinTileWidth
+};
+
+struct PreviewExportResult {
+    size_t images = 0;
+    size_t boxes = 0;
+    size_t failed = 0;
+    size_t sheets = 0;
+    uint64_t bytesWritten = 0;
+    double seconds = 0.0;
+
+    double ImagesPerSecond() const { return seconds > 0.0 ? images / seconds : 0.0; }
+};
+
+// Writes a JPEG preview with boxes burned in for every image in the index,
+// and optionally contact sheets tiling the previews.
+//
+// Each worker decodes, draws and encodes its own images. Contact sheets are
+// assembled in batches: workers write their tile straight into the batch's
+// sheet canvases (tiles never overlap), and the finished sheets are encoded in
+// parallel before the next batch, so memory stays bounded by one batch.
+class PreviewExporter {
+private:
+    PreviewOptions options;
+    ThreadPool& pool;
+
+public:
+    // Narrowest tile that fits the caption strip, the border and a thumbnail
+    static constexpr int kMinTileWidth = 32;
+
+    explicit PreviewExporter(const PreviewOptions& exportOptions, ThreadPool& threadPool = ThreadPool::Shared())
+        : options(exportOptions), pool(threadPool) {
+        options.tileWidth = std::max(options.tileWidth, kMinTileWidth);
+    }
+
+    PreviewExportResult Export(const AnnotationIndex& index, const std::string& outputDirectory) {
+        auto start = std::chrono::steady_clock::now();
+        PreviewExportResult result;
+
+        std::error_code error;
+        std::filesystem::create_directories(outputDirectory, error);
+        if (error) {
+            std::cerr << "Failed to create preview directory " << outputDirectory << ": " << error.message() << std::endl;
+            return result;
+        }
+
+        size_t imageCount = index.ImageCount();
+        bool sheets = options.sheetColumns > 0 && options.sheetRows > 0;
+        size_t tilesPerSheet = sheets ? (size_t)options.sheetColumns * options.sheetRows : 0;
+        int tileHeight = options.tileWidth * 3 / 4;
+
+        // Enough images per batch to keep every worker busy
+        size_t batchSize = imageCount;
+        if (sheets) {
+            size_t sheetsPerBatch = std::max<size_t>(1, (pool.MaxChunks() + tilesPerSheet - 1) / tilesPerSheet);
+            batchSize = sheetsPerBatch * tilesPerSheet;
+        }
+
+        std::vector<std::string> previewNames = PreviewFileNames(index.ImagePaths());
+
+        std::atomic<size_t> exported{0};
+        std::atomic<size_t> boxes{0};
+        std::atomic<size_t> failed{0};
+        std::atomic<uint64_t> bytes{0};
+
+        for (size_t batchBegin = 0; batchBegin < imageCount; batchBegin += batchSize) {
+            size_t batchEnd = std::min(imageCount, batchBegin + batchSize);
+
+            std::vector<cv::Mat> canvases;
+            if (sheets) {
+                size_t sheetCount = (batchEnd - batchBegin + tilesPerSheet - 1) / tilesPerSheet;
+                for (size_t s = 0; s < sheetCount; s++) {
+                    canvases.emplace_back(tileHeight * options.sheetRows, options.tileWidth * options.sheetColumns, CV_8UC3,
+                                          cv::Scalar(32, 32, 32));
+                }
+            }
+
+            pool.ParallelFor(batchBegin, batchEnd, [&](size_t begin, size_t end, size_t) {
+                for (size_t i = begin; i < end; i++) {
+                    cv::Mat preview;
+                    if (!RenderPreview(index, (uint32_t)i, preview)) {
+                        failed++;
+                        continue;
+                    }
+
+                    std::string target = (std::filesystem::path(outputDirectory) / previewNames[i]).string();
+                    uint64_t written = WriteJpeg(preview, target);
+                    if (written > 0) {
+                        exported++;
+                        boxes += index.ImageBoxCount((uint32_t)i);
+                    } else {
+                        failed++;
+                    }
+                    bytes += written;
+
+                    if (sheets) {
+                        size_t slot = i - batchBegin;
+                        cv::Mat& canvas = canvases[slot / tilesPerSheet];
+                        int tile = (int)(slot % tilesPerSheet);
+                        cv::Rect cell((tile % options.sheetColumns) * options.tileWidth,
+                                      (tile / options.sheetColumns) * tileHeight, options.tileWidth, tileHeight);
+                        DrawTile(preview, std::filesystem::path(index.ImagePaths()[i]).filename().string(), canvas(cell));
+                    }
+                }
+            }, 1);
+
+            if (sheets) {
+                size_t firstSheet = batchBegin / tilesPerSheet;
+                pool.ParallelFor(0, canvases.size(), [&](size_t begin, size_t end, size_t) {
+                    for (size_t s = begin; s < end; s++) {
+                        char name[48];
+                        std::snprintf(name, sizeof(name), "contact_sheet_%04zu.jpg", firstSheet + s + 1);
+                        bytes += WriteJpeg(canvases[s], (std::filesystem::path(outputDirectory) / name).string());
+                    }
+                }, 1);
+                result.sheets += canvases.size();
+            }
+        }
+
+        result.images = exported;
+        result.boxes = boxes;
+        result.failed = failed;
+        result.bytesWritten = bytes;
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return result;
+    }
+
+    // Decodes one image at reduced scale and draws its boxes
+    bool RenderPreview(const AnnotationIndex& index, uint32_t imageId, cv::Mat& preview) const {
+        const std::string& path = index.ImagePaths()[imageId];
+        preview = cv::imread(path, ReducedReadFlag());
+        if (preview.empty()) {
+            std::cerr << "Failed to decode " << path << std::endl;
+            return false;
+        }
+
+        // Scale from the original pixel grid; the header size is exact, the reduction factor is a fallback
+        int originalWidth = index.ImageWidth(imageId);
+        int originalHeight = index.ImageHeight(imageId);
+        float scaleX = originalWidth > 0 ? (float)preview.cols / originalWidth : 1.0f / options.reduction;
+        float scaleY = originalHeight > 0 ? (float)preview.rows / originalHeight : 1.0f / options.reduction;
+
+        static const uint8_t kBoxColor[3] = {0, 255, 0};
+        uint32_t begin = index.ImageBoxBegin(imageId);
+        uint32_t count = index.ImageBoxCount(imageId);
+        for (uint32_t k = 0; k < count; k++) {
+            uint32_t row = begin + k;
+            float xmin = index.XMin()[row], ymin = index.YMin()[row];
+            float xmax = index.XMax()[row], ymax = index.YMax()[row];
+            int x0 = (int)std::floor(std::min(xmin, xmax) * scaleX);
+            int y0 = (int)std::floor(std::min(ymin, ymax) * scaleY);
+            int x1 = (int)std::ceil(std::max(xmin, xmax) * scaleX);
+            int y1 = (int)std::ceil(std::max(ymin, ymax) * scaleY);
+            float angle = index.Angles()[row];
+            if (angle == 0.0f) {
+                DrawRectOutlineBGR(preview, x0, y0, x1, y1, kBoxColor, options.lineThickness);
+            } else {
+                // The span fill only draws axis-aligned outlines; rotated ones go through OpenCV
+                BoxCorners corners = OrientedCorners({xmin * scaleX, ymin * scaleY, xmax * scaleX, ymax * scaleY, 0, angle});
+                std::vector<cv::Point> outline;
+                for (int c = 0; c < 4; c++) outline.emplace_back((int)std::lround(corners.x[c]), (int)std::lround(corners.y[c]));
+                cv::polylines(preview, outline, true, cv::Scalar(kBoxColor[0], kBoxColor[1], kBoxColor[2]), options.lineThickness);
+                x0 = outline[0].x;
+                y0 = outline[0].y;
+            }
+
+            if (options.drawLabels) {
+                char label[64];
+                std::snprintf(label, sizeof(label), "%u: %dx%d", k + 1, (int)std::fabs(xmax - xmin), (int)std::fabs(ymax - ymin));
+                DrawLabel(preview, label, x0, y0);
+            }
+        }
+        return true;
+    }
+
+    // Output file name of every image's preview: <stem>_preview.jpg, with the
+    // extension kept (<stem>_<ext>_preview.jpg) for stems shared by several
+    // images, and the image number added if that still collides (same file
+    // name in different directories), so no preview overwrites another
+    static std::vector<std::string> PreviewFileNames(const std::vector<std::string>& imagePaths) {
+        std::map<std::string, size_t> stemCounts;
+        for (const std::string& path : imagePaths) {
+            stemCounts[std::filesystem::path(path).stem().string()]++;
+        }
+
+        std::vector<std::string> names(imagePaths.size());
+        std::map<std::string, size_t> nameCounts;
+        for (size_t i = 0; i < imagePaths.size(); i++) {
+            std::filesystem::path path(imagePaths[i]);
+            std::string name = path.stem().string();
+            std::string extension = path.extension().string();
+            if (stemCounts[name] > 1 && !extension.empty()) name += "_" + extension.substr(1);
+            names[i] = name;
+            nameCounts[name]++;
+        }
+        for (size_t i = 0; i < names.size(); i++) {
+            if (nameCounts[names[i]] > 1) names[i] += "_" + std::to_string(i);
+            names[i] += "_preview.jpg";
+        }
+        return names;
+    }
+
+private:
+    int ReducedReadFlag() const {
+        switch (options.reduction) {
+            case 2: return cv::IMREAD_REDUCED_COLOR_2;
+            case 4: return cv::IMREAD_REDUCED_COLOR_4;
+            case 8: return cv::IMREAD_REDUCED_COLOR_8;
+            default: return cv::IMREAD_COLOR;
+        }
+    }
+
+    static void DrawLabel(cv::Mat& image, const std::string& text, int x, int y) {
+        double fontScale = 0.4 * std::max(1.0, image.cols / 960.0);
+        int baseline = 0;
+        cv::Size size = cv::getTextSize(text, cv::FONT_HERSHEY_SIMPLEX, fontScale, 1, &baseline);
+        // Above the box when there is room, otherwise just inside it
+        int top = y - size.height - baseline - 2 >= 0 ? y - size.height - baseline - 2 : std::max(y, 0);
+        int left = std::max(0, std::min(x, image.cols - size.width - 2));
+        cv::rectangle(image, cv::Point(left, top), cv::Point(left + size.width + 2, top + size.height + baseline + 2),
+                      cv::Scalar(0, 255, 0), cv::FILLED);
+        cv::putText(image, text, cv::Point(left + 1, top + size.height + 1), cv::FONT_HERSHEY_SIMPLEX, fontScale,
+                    cv::Scalar(0, 0, 0), 1, cv::LINE_AA);
+    }
+
+    // Letterboxes a preview into a contact sheet cell with its file name underneath
+    void DrawTile(const cv::Mat& preview, const std::string& caption, cv::Mat cell) const {
+        const int captionHeight = 16;
+        int areaWidth = cell.cols - 4;
+        int areaHeight = cell.rows - captionHeight - 4;
+        if (areaWidth < 1 || areaHeight < 1) return;
+        float scale = std::min((float)areaWidth / preview.cols, (float)areaHeight / preview.rows);
+        cv::Size size(std::max(1, (int)(preview.cols * scale)), std::max(1, (int)(preview.rows * scale)));
+
+        // Average whole 2/4/8 blocks in one pass first so INTER_AREA only
+        // handles the leftover fraction on a much smaller image
+        cv::Mat source = preview, reduced;
+        int factor = ReductionFactor(preview.cols, preview.rows, size.width, size.height);
+        if (factor > 1 && DownscalePixels(preview, reduced, factor, PixelLayout::BGR, PixelLayout::BGR)) {
+            source = reduced;
+        }
+        cv::Mat thumbnail;
+        cv::resize(source, thumbnail, size, 0, 0, cv::INTER_AREA);
+        int left = (cell.cols - size.width) / 2;
+        int top = 2 + (areaHeight - size.height) / 2;
+        cv::Mat target = cell(cv::Rect(left, top, size.width, size.height));
+        thumbnail.copyTo(target);
+
+        std::string text = caption;
+        int baseline = 0;
+        while (text.size() > 4 && cv::getTextSize(text, cv::FONT_HERSHEY_SIMPLEX, 0.35, 1, &baseline).width > cell.cols - 4) {
+            text = text.substr(0, text.size() - 4) + "..";
+        }
+        cv::putText(cell, text, cv::Point(2, cell.rows - 5), cv::FONT_HERSHEY_SIMPLEX, 0.35, cv::Scalar(220, 220, 220), 1,
+                    cv::LINE_AA);
+    }
+
+    // Returns the number of bytes written, 0 on failure
+    uint64_t WriteJpeg(const cv::Mat& image, const std::string& path) const {
+        std::vector<unsigned char> encoded;
+        if (!cv::imencode(".jpg", image, encoded, {cv::IMWRITE_JPEG_QUALITY, options.jpegQuality})) {
+            std::cerr << "Failed to encode " << path << std::endl;
+            return 0;
+        }
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+        if (!file) {
+            std::cerr << "Failed to write " << path << std::endl;
+            return 0;
+        }
+        return encoded.size();
+    }
+};
@@ -0,0 +1,309 @@
+// Python bindings for the annotation core (index, statistics, anchors, validation).
+//
+// Box columns are exposed as read-only NumPy views over the index's own
+// storage; the view keeps the index alive. Any call that changes the box count
+// of an image (set_boxes, reload_sidecar, compact) may reallocate the columns,
+// so views must be re-fetched afterwards. Whole-dataset operations release the
+// GIL and run on the native thread pool.
+
+#include <algorithm>
+
+#include <pybind11/numpy.h>
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+
+#include "anchor_kmeans.h"
+#include "annotation_index.h"
+#include "dataset_stats.h"
+#include "image_header.h"
+#include "label_validator.h"
+#include "oriented_box.h"
+
+namespace py = pybind11;
+
+namespace {
+
+template <typename T>
+py::array ColumnView(const std::vector<T>& column, py::handle owner) {
+    py::array_t<T> view({(py::ssize_t)column.size()}, {(py::ssize_t)sizeof(T)}, column.data(), owner);
+    view.attr("setflags")(py::arg("write") = false);
+    return std::move(view);
+}
+
+py::array HistogramCounts(const Histogram& histogram) {
+    py::array_t<int64_t> counts(histogram.counts.size());
+    std::copy(histogram.counts.begin(), histogram.counts.end(), counts.mutable_data());
+    return std::move(counts);
+}
+
+py::array BoxesToArray(const std::vector<BoxRecord>& boxes) {
+    py::array_t<float> result({(py::ssize_t)boxes.size(), (py::ssize_t)4});
+    auto view = result.mutable_unchecked<2>();
+    for (size_t i = 0; i < boxes.size(); i++) {
+        view(i, 0) = boxes[i].xmin;
+        view(i, 1) = boxes[i].ymin;
+        view(i, 2) = boxes[i].xmax;
+        view(i, 3) = boxes[i].ymax;
+    }
+    return std::move(result);
+}
+
+py::array ClassesToArray(const std::vector<BoxRecord>& boxes) {
+    py::array_t<uint16_t> result((py::ssize_t)boxes.size());
+    for (size_t i = 0; i < boxes.size(); i++) {
+        result.mutable_data()[i] = boxes[i].classId;
+    }
+    return std::move(result);
+}
+
+py::array AnglesToArray(const std::vector<BoxRecord>& boxes) {
+    py::array_t<float> result((py::ssize_t)boxes.size());
+    for (size_t i = 0; i < boxes.size(); i++) {
+        result.mutable_data()[i] = boxes[i].angle;
+    }
+    return std::move(result);
+}
+
+// Row i of an (N, 4) or (N, 5) box array; NaN or infinite values raise ValueError
+BoxRecord BoxFromRow(const py::detail::unchecked_reference<float, 2>& view, py::ssize_t i) {
+    for (py::ssize_t k = 0; k < view.shape(1); k++) {
+        if (!std::isfinite(view(i, k))) throw std::invalid_argument("boxes must be finite");
+    }
+    BoxRecord box = {view(i, 0), view(i, 1), view(i, 2), view(i, 3)};
+    if (view.shape(1) == 5) box.angle = NormalizeAngle(view(i, 4));
+    return box;
+}
+
+std::vector<BoxRecord> ArrayToBoxes(py::array_t<float, py::array::c_style | py::array::forcecast> array,
+                                    py::object classIds, py::object angles = py::none()) {
+    if (array.ndim() != 2 || array.shape(1) != 4) {
+        throw std::invalid_argument("boxes must have shape (N, 4): xmin, ymin, xmax, ymax");
+    }
+    auto view = array.unchecked<2>();
+    std::vector<BoxRecord> boxes(array.shape(0));
+    for (py::ssize_t i = 0; i < array.shape(0); i++) {
+        boxes[i] = BoxFromRow(view, i);
+    }
+    if (!classIds.is_none()) {
+        // Read as int64 so negative or oversized ids are caught instead of wrapping
+        auto classes = classIds.cast<py::array_t<int64_t, py::array::c_style | py::array::forcecast>>();
+        if (classes.ndim() != 1 || classes.shape(0) != array.shape(0)) {
+            throw std::invalid_argument("class_ids must have shape (N,)");
+        }
+        for (py::ssize_t i = 0; i < classes.shape(0); i++) {
+            int64_t classId = classes.at(i);
+            if (classId < 0 || classId > kMaxClassId) {
+                throw std::invalid_argument("class_ids must be in [0, " + std::to_string(kMaxClassId) + "]");
+            }
+            boxes[i].classId = (uint16_t)classId;
+        }
+    }
+    if (!angles.is_none()) {
+        auto degrees = angles.cast<py::array_t<float, py::array::c_style | py::array::forcecast>>();
+        if (degrees.ndim() != 1 || degrees.shape(0) != array.shape(0)) {
+            throw std::invalid_argument("angles must have shape (N,)");
+        }
+        for (py::ssize_t i = 0; i < degrees.shape(0); i++) {
+            if (!std::isfinite(degrees.at(i))) throw std::invalid_argument("angles must be finite");
+            boxes[i].angle = NormalizeAngle(degrees.at(i));
+        }
+    }
+    return boxes;
+}
+
+// (N, 5) xmin, ymin, xmax, ymax, angle; (N, 4) is taken as axis-aligned
+std::vector<BoxRecord> OrientedArrayToBoxes(py::array_t<float, py::array::c_style | py::array::forcecast> array) {
+    if (array.ndim() != 2 || (array.shape(1) != 4 && array.shape(1) != 5)) {
+        throw std::invalid_argument("boxes must have shape (N, 5): xmin, ymin, xmax, ymax, angle");
+    }
+    auto view = array.unchecked<2>();
+    std::vector<BoxRecord> boxes(array.shape(0));
+    for (py::ssize_t i = 0; i < array.shape(0); i++) {
+        boxes[i] = BoxFromRow(view, i);
+    }
+    return boxes;
+}
+
+}  // namespace
+
+PYBIND11_MODULE(j_bbox, m) {
+    m.doc() = "Annotation core of the bounding box annotation tool";
+
+    m.def("list_image_files", &ListImageFiles, py::arg("directory"),
+          "Sorted image files in a directory, using the viewer's extension list");
+    m.def("csv_path_for_image", &CsvPathForImage, py::arg("image_path"));
+    m.def("probe_image_size", [](const std::string& path) -> py::object {
+        int width = 0, height = 0;
+        if (!ProbeImageSize(path, width, height)) return py::none();
+        return py::make_tuple(width, height);
+    }, py::arg("path"), "(width, height) read from the file header, or None");
+    m.def("thread_count", []() { return ThreadPool::Shared().Size(); });
+
+    py::class_<AnnotationIndex>(m, "AnnotationIndex")
+        .def(py::init<>())
+        .def_property_readonly_static("DEAD_ROW", [](py::object) { return AnnotationIndex::kDeadRow; })
+        .def("build", [](AnnotationIndex& index, const std::vector<std::string>& files) { index.Build(files); },
+             py::arg("files"), py::call_guard<py::gil_scoped_release>())
+        .def("build_directory", [](AnnotationIndex& index, const std::string& directory) {
+            index.Build(ListImageFiles(directory));
+        }, py::arg("directory"), py::call_guard<py::gil_scoped_release>())
+        .def_property_readonly("image_count", &AnnotationIndex::ImageCount)
+        .def_property_readonly("box_count", &AnnotationIndex::BoxCount)
+        .def_property_readonly("row_count", &AnnotationIndex::RowCount)
+        .def_property_readonly("version", &AnnotationIndex::Version)
+        .def_property_readonly("image_paths", &AnnotationIndex::ImagePaths)
+        .def("image_size", [](const AnnotationIndex& index, uint32_t imageId) {
+            if (imageId >= index.ImageCount()) throw py::index_error("image id out of range");
+            return py::make_tuple(index.ImageWidth(imageId), index.ImageHeight(imageId));
+        }, py::arg("image_id"))
+        .def("get_boxes", [](const AnnotationIndex& index, uint32_t imageId) {
+            if (imageId >= index.ImageCount()) throw py::index_error("image id out of range");
+            return BoxesToArray(index.GetBoxes(imageId));
+        }, py::arg("image_id"), "Boxes of one image as a (N, 4) float32 array")
+        .def("get_class_ids", [](const AnnotationIndex& index, uint32_t imageId) {
+            if (imageId >= index.ImageCount()) throw py::index_error("image id out of range");
+            return ClassesToArray(index.GetBoxes(imageId));
+        }, py::arg("image_id"), "Class ids of one image's boxes as a (N,) uint16 array")
+        .def("get_angles", [](const AnnotationIndex& index, uint32_t imageId) {
+            if (imageId >= index.ImageCount()) throw py::index_error("image id out of range");
+            return AnglesToArray(index.GetBoxes(imageId));
+        }, py::arg("image_id"), "Rotation of one image's boxes in degrees as a (N,) float32 array")
+        .def("set_boxes", [](AnnotationIndex& index, uint32_t imageId, py::array_t<float, py::array::c_style | py::array::forcecast> boxes,
+                             py::object classIds, py::object angles) {
+            if (imageId >= index.ImageCount()) throw py::index_error("image id out of range");
+            index.SetBoxes(imageId, ArrayToBoxes(boxes, classIds, angles));
+        }, py::arg("image_id"), py::arg("boxes"), py::arg("class_ids") = py::none(), py::arg("angles") = py::none(),
+           "class_ids defaults to class 0, angles to axis-aligned boxes")
+        .def_property_readonly("class_count", &AnnotationIndex::ClassCount)
+        .def("class_box_count", &AnnotationIndex::ClassBoxCount, py::arg("class_id"))
+        .def("class_image_count", &AnnotationIndex::ClassImageCount, py::arg("class_id"))
+        .def("images_with_class", &AnnotationIndex::ImagesWithClass, py::arg("class_id"),
+             "Sorted ids of the images containing the class")
+        .def("next_image_with_class", &AnnotationIndex::NextImageWithClass, py::arg("class_id"), py::arg("from_image"),
+             py::arg("forward") = true, "Closest image after (or before) from_image with the class, or -1")
+        .def("reload_sidecar", &AnnotationIndex::ReloadSidecar, py::arg("image_id"))
+        .def("compact", &AnnotationIndex::Compact, "Drop dead rows so column views contain only live boxes")
+        // Zero-copy column views; rows whose image_ids entry is DEAD_ROW are stale
+        .def_property_readonly("xmin", [](py::object self) { return ColumnView(self.cast<const AnnotationIndex&>().XMin(), self); })
+        .def_property_readonly("ymin", [](py::object self) { return ColumnView(self.cast<const AnnotationIndex&>().YMin(), self); })
+        .def_property_readonly("xmax", [](py::object self) { return ColumnView(self.cast<const AnnotationIndex&>().XMax(), self); })
+        .def_property_readonly("ymax", [](py::object self) { return ColumnView(self.cast<const AnnotationIndex&>().YMax(), self); })
+        .def_property_readonly("class_ids", [](py::object self) { return ColumnView(self.cast<const AnnotationIndex&>().ClassIds(), self); })
+        .def_property_readonly("angles", [](py::object self) { return ColumnView(self.cast<const AnnotationIndex&>().Angles(), self); })
+        .def_property_readonly("image_ids", [](py::object self) { return ColumnView(self.cast<const AnnotationIndex&>().ImageIds(), self); });
+
+    py::class_<DatasetStats>(m, "DatasetStats")
+        .def(py::init<>())
+        .def("recompute", [](DatasetStats& stats, const AnnotationIndex& index) { stats.Recompute(index); },
+             py::arg("index"), py::call_guard<py::gil_scoped_release>())
+        .def_property_readonly("total_boxes", &DatasetStats::TotalBoxes)
+        .def_property_readonly("empty_images", &DatasetStats::EmptyImages)
+        .def_property_readonly("mean_width", &DatasetStats::MeanWidth)
+        .def_property_readonly("mean_height", &DatasetStats::MeanHeight)
+        .def_property_readonly("box_width", [](const DatasetStats& stats) { return HistogramCounts(stats.BoxWidth()); })
+        .def_property_readonly("box_height", [](const DatasetStats& stats) { return HistogramCounts(stats.BoxHeight()); })
+        .def_property_readonly("aspect_ratio", [](const DatasetStats& stats) { return HistogramCounts(stats.AspectRatio()); })
+        .def_property_readonly("boxes_per_image", [](const DatasetStats& stats) { return HistogramCounts(stats.BoxesPerImage()); })
+        .def_property_readonly("heatmap", [](const DatasetStats& stats) {
+            const int size = DatasetStats::kHeatmapSize;
+            py::array_t<int64_t> heatmap({size, size});
+            std::copy(stats.Heatmap().begin(), stats.Heatmap().end(), heatmap.mutable_data());
+            return heatmap;
+        })
+        .def("export_csv", &DatasetStats::ExportCSV, py::arg("path"), py::call_guard<py::gil_scoped_release>());
+
+    py::class_<AnchorResult>(m, "AnchorResult")
+        .def_property_readonly("anchors", [](const AnchorResult& result) {
+            py::array_t<float> anchors({(py::ssize_t)result.widths.size(), (py::ssize_t)2});
+            auto view = anchors.mutable_unchecked<2>();
+            for (size_t i = 0; i < result.widths.size(); i++) {
+                view(i, 0) = result.widths[i];
+                view(i, 1) = result.heights[i];
+            }
+            return anchors;
+        })
+        .def_readonly("mean_iou", &AnchorResult::meanIoU)
+        .def_readonly("best_possible_recall", &AnchorResult::bestPossibleRecall)
+        .def_readonly("fitness", &AnchorResult::fitness)
+        .def_readonly("box_count", &AnchorResult::boxCount)
+        .def_readonly("seconds", &AnchorResult::seconds)
+        .def("to_yaml", &AnchorResult::ToYaml);
+
+    m.def("compute_anchors", [](const AnnotationIndex& index, int count, int imageSize, float threshold, int generations, uint32_t seed) {
+        AnchorOptions options;
+        options.anchorCount = count;
+        options.imageSize = imageSize;
+        options.anchorThreshold = threshold;
+        options.generations = generations;
+        options.seed = seed;
+        AnchorGenerator generator(options);
+        generator.CollectBoxes(index);
+        return generator.Run();
+    }, py::arg("index"), py::arg("count") = 9, py::arg("image_size") = 640, py::arg("threshold") = 4.0f,
+       py::arg("generations") = 1000, py::arg("seed") = 0, py::call_guard<py::gil_scoped_release>());
+
+    py::enum_<LabelIssue>(m, "LabelIssue")
+        .value("UNREADABLE_IMAGE", LabelIssue::UnreadableImage)
+        .value("UNREADABLE_SIDECAR", LabelIssue::UnreadableSidecar)
+        .value("STRAY_HEADER", LabelIssue::StrayHeader)
+        .value("MALFORMED_ROW", LabelIssue::MalformedRow)
+        .value("NON_FINITE", LabelIssue::NonFinite)
+        .value("INVERTED", LabelIssue::Inverted)
+        .value("ZERO_AREA", LabelIssue::ZeroArea)
+        .value("OUT_OF_BOUNDS", LabelIssue::OutOfBounds)
+        .value("INVALID_CLASS", LabelIssue::InvalidClass)
+        .value("INVALID_ANGLE", LabelIssue::InvalidAngle);
+
+    py::class_<LabelFinding>(m, "LabelFinding")
+        .def_readonly("image_path", &LabelFinding::imagePath)
+        .def_readonly("csv_path", &LabelFinding::csvPath)
+        .def_readonly("line", &LabelFinding::line)
+        .def_readonly("issue", &LabelFinding::issue)
+        .def_readonly("detail", &LabelFinding::detail)
+        .def_readonly("fix", &LabelFinding::fix);
+
+    py::class_<ValidationReport>(m, "ValidationReport")
+        .def_readonly("directory", &ValidationReport::directory)
+        .def_readonly("images", &ValidationReport::images)
+        .def_readonly("sidecars", &ValidationReport::sidecars)
+        .def_readonly("boxes", &ValidationReport::boxes)
+        .def_readonly("files_rewritten", &ValidationReport::filesRewritten)
+        .def_readonly("seconds", &ValidationReport::seconds)
+        .def_readonly("findings", &ValidationReport::findings)
+        .def("write_json", &ValidationReport::WriteJSON, py::arg("path"))
+        .def("write_csv", &ValidationReport::WriteCSV, py::arg("path"));
+
+    m.def("oriented_iou", [](py::array_t<float, py::array::c_style | py::array::forcecast> a,
+                             py::array_t<float, py::array::c_style | py::array::forcecast> b) {
+        OrientedBoxColumns first(OrientedArrayToBoxes(a)), second(OrientedArrayToBoxes(b));
+        py::array_t<float> result({(py::ssize_t)first.Size(), (py::ssize_t)second.Size()});
+        std::vector<float> iou;
+        {
+            py::gil_scoped_release release;
+            OrientedIoUMatrix(first, second, iou);
+        }
+        std::copy(iou.begin(), iou.end(), result.mutable_data());
+        return result;
+    }, py::arg("a"), py::arg("b"), "(N, M) IoU of oriented boxes given as (N, 5) and (M, 5) arrays: xmin, ymin, xmax, ymax, angle");
+
+    m.def("match_oriented_boxes", [](py::array_t<float, py::array::c_style | py::array::forcecast> a,
+                                     py::array_t<float, py::array::c_style | py::array::forcecast> b, float threshold) {
+        std::vector<BoxRecord> first = OrientedArrayToBoxes(a), second = OrientedArrayToBoxes(b);
+        std::vector<OrientedMatch> matches;
+        {
+            py::gil_scoped_release release;
+            matches = MatchOrientedBoxes(first, second, threshold, false);
+        }
+        py::list result;
+        for (const OrientedMatch& match : matches) {
+            result.append(py::make_tuple(match.a, match.b, match.iou));
+        }
+        return result;
+    }, py::arg("a"), py::arg("b"), py::arg("threshold") = 0.5f,
+       "Greedy one-to-one matching by descending IoU: list of (index in a, index in b, iou)");
+
+    m.def("validate", [](const std::string& directory, bool fix) {
+        LabelValidator validator(fix);
+        return validator.ValidateDirectory(directory);
+    }, py::arg("directory"), py::arg("fix") = false, py::call_guard<py::gil_scoped_release>());
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Warms the page cache for files the cursor is about to reach.
+//
+// Hint() hands a list of upcoming paths to a couple of dedicated threads that
+// open each file and ask the kernel to read it in: readahead(2) on Linux,
+// posix_fadvise(WILLNEED) elsewhere. The threads are separate from the decode
+// pool so hints run ahead of decoding instead of queueing behind it, and so a
+// slow NFS open never blocks the UI thread. Each Hint() replaces the hints
+// still queued from the previous cursor position, and files hinted recently
+// are skipped, so moving the cursor by one image costs one new hint.
+class ReadaheadHinter {
+private:
+    std::vector<std::thread> threads;
+    std::deque<std::string> queue;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping = false;
+
+    // Recently hinted paths, oldest first (UI thread only); both hold the same paths
+    std::deque<std::string> recent;
+    std::unordered_set<std::string> recentSet;
+    static constexpr size_t kRecentCapacity = 512;
+
+    std::atomic<uint64_t> filesHinted{0};
+    std::atomic<uint64_t> bytesHinted{0};
+    std::atomic<uint64_t> failures{0};
+
+public:
+    explicit ReadaheadHinter(size_t threadCount = 2) {
+        for (size_t i = 0; i < threadCount; i++) {
+            threads.emplace_back([this]() { WorkerLoop(); });
+        }
+    }
+
+    ~ReadaheadHinter() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            queue.clear();
+        }
+        condition.notify_all();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    ReadaheadHinter(const ReadaheadHinter&) = delete;
+    ReadaheadHinter& operator=(const ReadaheadHinter&) = delete;
+
+    // Paths in the order they will be needed
+    void Hint(const std::vector<std::string>& paths) {
+        // Hints from the old cursor position that never ran may be hinted again
+        std::deque<std::string> dropped;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            dropped.swap(queue);
+        }
+        if (!dropped.empty()) {
+            std::unordered_set<std::string> unrun(dropped.begin(), dropped.end());
+            recent.erase(std::remove_if(recent.begin(), recent.end(),
+                                        [&](const std::string& path) { return unrun.count(path) > 0; }),
+                         recent.end());
+            for (const std::string& path : unrun) {
+                recentSet.erase(path);
+            }
+        }
+
+        std::vector<std::string> fresh;
+        for (const std::string& path : paths) {
+            if (path.empty() || recentSet.count(path) > 0) continue;
+            fresh.push_back(path);
+            recent.push_back(path);
+            recentSet.insert(path);
+            if (recent.size() > kRecentCapacity) {
+                recentSet.erase(recent.front());
+                recent.pop_front();
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.assign(fresh.begin(), fresh.end());
+        }
+        condition.notify_all();
+    }
+
+    uint64_t FilesHinted() const { return filesHinted.load(); }
+    uint64_t BytesHinted() const { return bytesHinted.load(); }
+    uint64_t Failures() const { return failures.load(); }
+
+private:
+    void WorkerLoop() {
+        while (true) {
+            std::string path;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [this]() { return stopping || !queue.empty(); });
+                if (stopping) return;
+                path = std::move(queue.front());
+                queue.pop_front();
+            }
+            HintFile(path);
+        }
+    }
+
+    void HintFile(const std::string& path) {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            // Sidecars are optional, so a missing file is not a failure
+            if (errno != ENOENT) failures++;
+            return;
+        }
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size > 0) {
+#if defined(__linux__)
+            int result = (int)readahead(fd, 0, (size_t)info.st_size);
+#else
+            int result = posix_fadvise(fd, 0, info.st_size, POSIX_FADV_WILLNEED);
+#endif
+            if (result == 0) {
+                filesHinted++;
+                bytesHinted += (uint64_t)info.st_size;
+            } else {
+                failures++;
+            }
+        }
+        close(fd);
+    }
+};
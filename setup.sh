@@ -28,6 +28,7 @@ sudo apt-get install -y \
     libgl1-mesa-dev \
     libglew-dev \
     libopencv-dev \
+    liblz4-dev \
     pkg-config
 
 echo "Setup complete!"
@@ -0,0 +1,132 @@
+// Checks the rotated-IoU kernels against a reference polygon clipper and
+// exits with status 1 on any mismatch. With --benchmark it times a 2000 x
+// 2000 box IoU matrix with each kernel instead.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "oriented_box.h"
+#include "thread_pool.h"
+
+namespace {
+
+// Intersection area by Sutherland-Hodgman clipping in double precision, the
+// reference the kernel is verified against
+double ReferenceIntersection(const BoxRecord& a, const BoxRecord& b) {
+    BoxCorners ca = OrientedCorners(a), cb = OrientedCorners(b);
+    std::vector<std::pair<double, double>> polygon;
+    for (int k = 0; k < 4; k++) polygon.push_back({ca.x[k], ca.y[k]});
+    for (int k = 0; k < 4 && !polygon.empty(); k++) {
+        double ex = cb.x[k], ey = cb.y[k];
+        double fx = cb.x[(k + 1) & 3], fy = cb.y[(k + 1) & 3];
+        auto side = [&](const std::pair<double, double>& p) { return (fx - ex) * (p.second - ey) - (fy - ey) * (p.first - ex); };
+        std::vector<std::pair<double, double>> clipped;
+        for (size_t i = 0; i < polygon.size(); i++) {
+            const auto& p = polygon[i];
+            const auto& n = polygon[(i + 1) % polygon.size()];
+            double sp = side(p), sn = side(n);
+            if (sp >= 0.0) clipped.push_back(p);
+            if ((sp >= 0.0) != (sn >= 0.0)) {
+                double t = sp / (sp - sn);
+                clipped.push_back({p.first + t * (n.first - p.first), p.second + t * (n.second - p.second)});
+            }
+        }
+        polygon.swap(clipped);
+    }
+    double area = 0.0;
+    for (size_t i = 0; i < polygon.size(); i++) {
+        const auto& p = polygon[i];
+        const auto& n = polygon[(i + 1) % polygon.size()];
+        area += p.first * n.second - n.first * p.second;
+    }
+    return std::abs(area) * 0.5;
+}
+
+BoxRecord RandomBox(std::mt19937& random, float extent, float maxSize) {
+    std::uniform_real_distribution<float> position(0.0f, extent), size(2.0f, maxSize), angle(-180.0f, 180.0f);
+    float cx = position(random), cy = position(random), w = size(random), h = size(random);
+    BoxRecord box = {cx - w * 0.5f, cy - h * 0.5f, cx + w * 0.5f, cy + h * 0.5f, 0, NormalizeAngle(angle(random))};
+    return box;
+}
+
+// Checks the scalar and AVX2 kernels against polygon clipping on random boxes
+// and on the shared-edge cases the tie rule exists for
+bool VerifyOrientedIoU(std::ostream& log) {
+    std::mt19937 random(7);
+    std::vector<BoxRecord> a, b;
+    for (int i = 0; i < 300; i++) a.push_back(RandomBox(random, 400.0f, 80.0f));
+    for (int i = 0; i < 301; i++) b.push_back(RandomBox(random, 400.0f, 80.0f));
+    // Identical, touching, nested, flipped by 180 degrees, axis-aligned with shared edges
+    BoxRecord base = {100, 100, 180, 140, 0, 30.0f};
+    for (BoxRecord box : {base, BoxRecord{180, 100, 260, 140, 0, 0.0f}, BoxRecord{120, 110, 160, 130, 0, 30.0f},
+                          BoxRecord{100, 100, 180, 140, 0, -150.0f}, BoxRecord{100, 100, 140, 140, 0, 0.0f},
+                          BoxRecord{100, 100, 180, 140, 0, 0.0f}, BoxRecord{140, 100, 220, 140, 0, 0.0f}}) {
+        a.push_back(box);
+        b.push_back(box);
+    }
+
+    OrientedBoxColumns columnsA(a), columnsB(b);
+    std::vector<float> scalar, simd;
+    OrientedIoUMatrix(columnsA, columnsB, scalar, ThreadPool::Shared(), false);
+    OrientedIoUMatrix(columnsA, columnsB, simd, ThreadPool::Shared(), true);
+
+    double worstReference = 0.0, worstSimd = 0.0;
+    size_t overlapping = 0;
+    for (size_t i = 0; i < a.size(); i++) {
+        for (size_t j = 0; j < b.size(); j++) {
+            double intersection = ReferenceIntersection(a[i], b[j]);
+            double areaA = (a[i].xmax - a[i].xmin) * (double)(a[i].ymax - a[i].ymin);
+            double areaB = (b[j].xmax - b[j].xmin) * (double)(b[j].ymax - b[j].ymin);
+            double reference = intersection / (areaA + areaB - intersection);
+            if (reference > 0.0) overlapping++;
+            worstReference = std::max(worstReference, std::abs(scalar[i * b.size() + j] - reference));
+            worstSimd = std::max(worstSimd, (double)std::abs(simd[i * b.size() + j] - scalar[i * b.size() + j]));
+        }
+    }
+    bool ok = worstReference < 1e-3 && worstSimd < 1e-4;
+    log << "Oriented IoU: " << a.size() * b.size() << " pairs (" << overlapping << " overlapping), max error "
+        << worstReference << " against polygon clipping, " << worstSimd << " between "
+        << (OrientedIoUHasAvx2() ? "avx2" : "scalar") << " and scalar: " << (ok ? "ok" : "FAILED") << std::endl;
+    return ok;
+}
+
+// Times one image's all-pairs IoU matrix (consensus between two labelers of a
+// densely annotated aerial image: small vehicles and ships on a 4k tile) on
+// one thread, scalar against AVX2
+void BenchmarkOrientedIoU(std::ostream& log, size_t boxesPerImage = 2000, int iterations = 5) {
+    std::mt19937 random(11);
+    std::vector<BoxRecord> a, b;
+    for (size_t i = 0; i < boxesPerImage; i++) {
+        a.push_back(RandomBox(random, 4000.0f, 120.0f));
+        b.push_back(RandomBox(random, 4000.0f, 120.0f));
+    }
+    OrientedBoxColumns columnsA(a), columnsB(b);
+    std::vector<float> row(b.size());
+    for (bool simd : {false, true}) {
+        if (simd && !OrientedIoUHasAvx2()) continue;
+        double best = 1e30;
+        for (int iteration = 0; iteration < iterations; iteration++) {
+            auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < a.size(); i++) OrientedIoURow(columnsA, i, columnsB, row.data(), simd);
+            best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        log << "Oriented IoU " << boxesPerImage << "x" << boxesPerImage << " (" << (simd ? "avx2" : "scalar")
+            << ", one thread): " << best << " ms, " << a.size() * b.size() / (best * 1e3) << " Mpairs/s" << std::endl;
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::string(argv[1]) == "--benchmark") {
+        BenchmarkOrientedIoU(std::cout);
+        return 0;
+    }
+    return VerifyOrientedIoU(std::cout) ? 0 : 1;
+}
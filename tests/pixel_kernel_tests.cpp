@@ -0,0 +1,190 @@
+// Checks the pixel conversion kernels against OpenCV and exits with status 1
+// on any mismatch. With --benchmark [2|4|8] it times preview downscaling of a
+// 24 MP frame at that reduction (default 2) instead.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include <opencv2/opencv.hpp>
+
+#include "pixel_kernels.h"
+
+namespace {
+
+// Checks every kernel at every level up to DetectSimdLevel() against OpenCV
+// (cvtColor, resize with INTER_AREA, convertTo) on random images, including
+// odd widths and strided ROIs. Returns the number of mismatches.
+int VerifyPixelKernels(std::ostream& log) {
+    using namespace pixel_kernels;
+    struct Case {
+        PixelLayout src, dst;
+        int code;  // cvtColor code, or -1 for a plain copy
+    };
+    const Case cases[] = {
+        {PixelLayout::Gray, PixelLayout::RGB, cv::COLOR_GRAY2RGB},   {PixelLayout::Gray, PixelLayout::RGBA, cv::COLOR_GRAY2RGBA},
+        {PixelLayout::Gray, PixelLayout::BGR, cv::COLOR_GRAY2BGR},   {PixelLayout::BGR, PixelLayout::RGB, cv::COLOR_BGR2RGB},
+        {PixelLayout::BGR, PixelLayout::RGBA, cv::COLOR_BGR2RGBA},   {PixelLayout::BGR, PixelLayout::BGR, -1},
+        {PixelLayout::BGRA, PixelLayout::RGB, cv::COLOR_BGRA2RGB},   {PixelLayout::BGRA, PixelLayout::RGBA, cv::COLOR_BGRA2RGBA},
+        {PixelLayout::BGRA, PixelLayout::BGR, cv::COLOR_BGRA2BGR},
+    };
+    const cv::Size sizes[] = {cv::Size(1, 1), cv::Size(7, 3), cv::Size(1037, 611), cv::Size(1040, 616)};
+
+    auto maxDifference = [](const cv::Mat& a, const cv::Mat& b) {
+        if (a.size() != b.size() || a.type() != b.type()) return 1e30;
+        cv::Mat difference;
+        cv::absdiff(a, b, difference);
+        double maxValue = 0.0;
+        cv::minMaxLoc(difference.reshape(1), nullptr, &maxValue);
+        return maxValue;
+    };
+
+    cv::RNG rng(0x6a62626f);
+    int failures = 0;
+    int checks = 0;
+    for (int level = 0; level <= (int)DetectSimdLevel(); level++) {
+        SimdLevel simd = (SimdLevel)level;
+        int levelFailures = 0;
+        for (const Case& test : cases) {
+            for (int depth : {CV_8U, CV_16U}) {
+                for (const cv::Size& size : sizes) {
+                    // A ROI of a wider image exercises strided rows
+                    cv::Mat full(size.height + 2, size.width + 5, CV_MAKETYPE(depth, LayoutChannels(test.src)));
+                    rng.fill(full, cv::RNG::UNIFORM, 0, depth == CV_8U ? 256 : 65536);
+                    for (const cv::Mat& source : {full, full(cv::Rect(3, 1, size.width, size.height))}) {
+                        cv::Mat expected, actual;
+                        if (test.code >= 0) {
+                            cv::cvtColor(source, expected, test.code);
+                        } else {
+                            expected = source.clone();
+                        }
+                        SwizzlePixels(source, actual, test.src, test.dst, simd);
+                        double swizzleError = maxDifference(expected, actual);
+
+                        cv::Mat expectedFloat, actualFloat;
+                        expected.convertTo(expectedFloat, CV_32F, depth == CV_8U ? 1.0 / 255.0 : 1.0 / 65535.0);
+                        NormalizePixels(source, actualFloat, test.src, test.dst, simd);
+                        double normalizeError = maxDifference(expectedFloat, actualFloat);
+
+                        double downscaleError = 0.0;
+                        for (int factor : {2, 4, 8}) {
+                            if (source.cols % factor != 0 || source.rows % factor != 0) continue;
+                            cv::Mat expectedSmall, actualSmall;
+                            cv::resize(expected, expectedSmall, cv::Size(source.cols / factor, source.rows / factor), 0, 0,
+                                       cv::INTER_AREA);
+                            DownscalePixels(source, actualSmall, factor, test.src, test.dst, simd);
+                            downscaleError = std::max(downscaleError, maxDifference(expectedSmall, actualSmall));
+                        }
+
+                        checks++;
+                        // INTER_AREA rounds through float, so averages may differ by one level
+                        if (swizzleError > 0.0 || normalizeError > 1e-6 || downscaleError > 1.0) {
+                            levelFailures++;
+                            log << "  FAIL " << SimdLevelName(simd) << " " << PixelLayoutName(test.src) << "->"
+                                << PixelLayoutName(test.dst) << (depth == CV_8U ? " 8u " : " 16u ") << source.cols << "x"
+                                << source.rows << ": swizzle " << swizzleError << ", normalize " << normalizeError
+                                << ", downscale " << downscaleError << std::endl;
+                        }
+                    }
+                }
+            }
+        }
+        log << "Pixel kernels (" << SimdLevelName(simd) << "): " << (levelFailures == 0 ? "ok" : "mismatches found")
+            << std::endl;
+        failures += levelFailures;
+    }
+    log << checks << " checks, " << failures << " failures" << std::endl;
+    return failures;
+}
+
+// Times making an RGB preview of a random BGR frame reduced by factor three
+// ways: cvtColor + resize(INTER_AREA), the two-pass kernels (swizzle, then
+// downscale) and the fused downscale. Traffic counts the bytes each approach
+// must move through memory: the two-pass versions read the frame, write a
+// converted copy and read it again; the fused kernel reads the frame once.
+// Returns false if a kernel path is unsupported or its preview differs from
+// OpenCV's by more than one level.
+bool BenchmarkPreviewDownscale(std::ostream& log, cv::Size size, int factor, int iterations = 5) {
+    cv::Mat source(size, CV_8UC3);
+    cv::RNG rng(0x6a62626f);
+    rng.fill(source, cv::RNG::UNIFORM, 0, 256);
+    cv::Size previewSize(size.width / factor, size.height / factor);
+    double sourceBytes = (double)source.total() * source.elemSize();
+    double previewBytes = (double)previewSize.area() * 3;
+
+    auto best = [&](const auto& run) {
+        double fastest = 1e30;
+        for (int i = 0; i < iterations; i++) {
+            auto start = std::chrono::steady_clock::now();
+            run();
+            fastest = std::min(fastest, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        return fastest;
+    };
+    auto report = [&](const char* name, double milliseconds, double bytes) {
+        log << "  " << name << ": " << milliseconds << " ms, " << (int)(bytes / 1e6) << " MB moved, "
+            << bytes / 1e6 / milliseconds << " GB/s" << std::endl;
+    };
+
+    log << "Preview of a " << size.width << "x" << size.height << " BGR frame at 1/" << factor << " ("
+        << previewSize.width << "x" << previewSize.height << " RGB, best of " << iterations << ")" << std::endl;
+
+    cv::Mat converted, reference;
+    double openCv = best([&]() {
+        cv::cvtColor(source, converted, cv::COLOR_BGR2RGB);
+        cv::resize(converted, reference, previewSize, 0, 0, cv::INTER_AREA);
+    });
+    report("cvtColor + resize", openCv, 3 * sourceBytes + previewBytes);
+
+    // The kernels take BGR, BGRA or gray sources, so the second pass reads
+    // the swizzled RGB frame as a three-channel BGR image and keeps its order
+    SimdLevel level = DetectSimdLevel();
+    cv::Mat twoPass;
+    bool twoPassOk = true;
+    double kernels = best([&]() {
+        twoPassOk = SwizzlePixels(source, converted, PixelLayout::BGR, PixelLayout::RGB, level) &&
+                    DownscalePixels(converted, twoPass, factor, PixelLayout::BGR, PixelLayout::BGR, level) && twoPassOk;
+    });
+    cv::Mat fused;
+    bool fusedOk = true;
+    double single = best([&]() { fusedOk = DownscalePixels(source, fused, factor, PixelLayout::BGR, PixelLayout::RGB, level) && fusedOk; });
+    if (!twoPassOk || !fusedOk) {
+        log << "  " << (twoPassOk ? "fused" : "two-pass") << " kernels unsupported at " << SimdLevelName(level) << std::endl;
+        return false;
+    }
+    report("swizzle + downscale", kernels, 3 * sourceBytes + previewBytes);
+    report("fused", single, sourceBytes + previewBytes);
+
+    // Both kernel paths must produce the OpenCV preview, or the timings compare different work
+    auto maxDifference = [&](const cv::Mat& preview) {
+        if (preview.size() != reference.size() || preview.type() != reference.type()) return 256.0;
+        cv::Mat difference;
+        double maxError = 0.0;
+        cv::absdiff(preview, reference, difference);
+        cv::minMaxLoc(difference.reshape(1), nullptr, &maxError);
+        return maxError;
+    };
+    double fusedError = maxDifference(fused);
+    double twoPassError = maxDifference(twoPass);
+    log << "  fused (" << SimdLevelName(level) << ") is " << openCv / single << "x cvtColor + resize, "
+        << kernels / single << "x the two-pass kernels; max difference from INTER_AREA " << fusedError << " fused, "
+        << twoPassError << " two-pass" << std::endl;
+    return fusedError <= 1.0 && twoPassError <= 1.0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::string(argv[1]) == "--benchmark") {
+        int factor = argc > 2 ? std::atoi(argv[2]) : 2;
+        if (factor != 2 && factor != 4 && factor != 8) {
+            std::cerr << "Usage: " << argv[0] << " [--benchmark [2|4|8]]" << std::endl;
+            return 2;
+        }
+        return BenchmarkPreviewDownscale(std::cout, cv::Size(6000, 4000), factor) ? 0 : 1;
+    }
+    std::cout << "CPU kernel level: " << SimdLevelName(DetectSimdLevel()) << std::endl;
+    return VerifyPixelKernels(std::cout) == 0 ? 0 : 1;
+}
@@ -0,0 +1,138 @@
+// Self-checks for multi-box annotations: box edits and saves in the
+// annotation index, and box lists sent through the control protocol. Exits
+// with status 1 if any box is lost.
+
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "annotation_index.h"
+#include "control_protocol.h"
+
+namespace {
+
+// Creates a new, empty directory under the system temporary directory. Returns an empty path if that fails.
+std::filesystem::path CreateScratchDirectory(const std::string& prefix) {
+    std::error_code error;
+    std::filesystem::path directory = std::filesystem::temp_directory_path(error) /
+        (prefix + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()));
+    if (error || !std::filesystem::create_directories(directory, error)) {
+        std::cerr << "Cannot create a temporary directory: " << error.message() << std::endl;
+        return std::filesystem::path();
+    }
+    return directory;
+}
+
+// Checks that editing one box of an image keeps its other boxes, in the index
+// and in the saved sidecar, by replaying the viewer's edits (SetBox on the box
+// it edits, then SaveSidecar) on a three-box sidecar in a temporary directory.
+// Returns false on any mismatch.
+bool VerifySidecarEdits(std::ostream& log) {
+    std::filesystem::path directory = CreateScratchDirectory("j_bbox_verify_");
+    if (directory.empty()) return false;
+    std::string imagePath = (directory / "frame.jpg").string();
+    std::string csvPath = CsvPathForImage(imagePath);
+    std::vector<BoxRecord> expected = {{10, 20, 110, 220, 0}, {200, 40, 260, 90, 1}, {300, 300, 420, 380, 2, 30.0f}};
+    bool ok = WriteSidecar(csvPath, expected);
+
+    AnnotationIndex index;
+    index.Build({imagePath});
+    auto same = [](const BoxRecord& a, const BoxRecord& b) {
+        return a.xmin == b.xmin && a.ymin == b.ymin && a.xmax == b.xmax && a.ymax == b.ymax && a.classId == b.classId &&
+               std::fabs(a.angle - b.angle) < 1e-3f;
+    };
+    auto check = [&](const char* step) {
+        std::vector<BoxRecord> indexed = index.GetBoxes(0), saved;
+        bool matches = ParseBoxCsv(csvPath, saved) && indexed.size() == expected.size() && saved.size() == expected.size();
+        for (size_t i = 0; matches && i < expected.size(); i++) {
+            matches = same(indexed[i], expected[i]) && same(saved[i], expected[i]);
+        }
+        log << step << ": " << indexed.size() << " boxes indexed, " << saved.size() << " saved, expected "
+            << expected.size() << (matches ? ": ok" : ": MISMATCH") << std::endl;
+        ok = ok && matches;
+    };
+    check("load");
+
+    expected[0].classId = 3;
+    index.SetBox(0, 0, expected[0]);
+    ok = index.SaveSidecar(0) && ok;
+    check("relabel the edited box and save");
+
+    expected[0] = {15, 25, 95, 180, 3, -45.0f};
+    index.SetBox(0, 0, expected[0]);
+    ok = index.SaveSidecar(0) && ok;
+    check("resize and rotate the edited box and save");
+
+    index.ReloadSidecar(0);
+    check("reload");
+
+    std::error_code error;
+    std::filesystem::remove_all(directory, error);
+    return ok;
+}
+
+// Checks the control path for multi-box annotations: a set-boxes list of
+// three boxes is applied, saved and reloaded the way SetCurrentBoxes, save
+// and LoadCSV do, a get-boxes reply parses back into the same boxes, and an
+// oversized count is rejected without allocating. Returns false on any
+// mismatch.
+bool VerifyControlBoxes(std::ostream& log) {
+    bool ok = true;
+    auto check = [&](const std::string& step, bool passed) {
+        log << step << (passed ? ": ok" : ": MISMATCH") << std::endl;
+        ok = ok && passed;
+    };
+    auto same = [](const std::vector<BoxRecord>& a, const std::vector<BoxRecord>& b) {
+        if (a.size() != b.size()) return false;
+        for (size_t i = 0; i < a.size(); i++) {
+            if (a[i].xmin != b[i].xmin || a[i].ymin != b[i].ymin || a[i].xmax != b[i].xmax || a[i].ymax != b[i].ymax ||
+                a[i].classId != b[i].classId || std::fabs(a[i].angle - b[i].angle) > 1e-3f) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    std::vector<BoxRecord> boxes;
+    std::string error;
+    check("set-boxes 1000000000000 rejected", !ParseControlBoxes("1000000000000 1 2 3 4", boxes, error));
+    check("four-value boxes get class 0",
+          ParseControlBoxes("2 1 2 3 4 5 6 7 8", boxes, error) && same(boxes, {{1, 2, 3, 4, 0}, {5, 6, 7, 8, 0}}));
+    check("non-finite coordinate rejected", !ParseControlBoxes("1 1 2 3 nan", boxes, error));
+    check("angles are normalized", ParseControlBoxes("1 1 2 3 4 5 270", boxes, error) && same(boxes, {{1, 2, 3, 4, 5, -90.0f}}));
+    check("non-finite angle rejected", !ParseControlBoxes("1 1 2 3 4 5 nan", boxes, error));
+
+    std::filesystem::path directory = CreateScratchDirectory("j_bbox_verify_");
+    if (directory.empty()) return false;
+    std::string imagePath = (directory / "frame.jpg").string();
+    AnnotationIndex index;
+    index.Build({imagePath});
+
+    std::vector<BoxRecord> expected = {{10, 20, 110, 220, 0}, {200, 40, 260, 90, 1}, {300, 300, 420, 380, 2, 30.0f}};
+    bool parsed = ParseControlBoxes("3 10 20 110 220 0 0 200 40 260 90 1 0 300 300 420 380 2 30", boxes, error);
+    if (parsed) index.SetBoxes(0, boxes);
+    bool saved = parsed && index.SaveSidecar(0);
+    index.Build({imagePath});
+    std::vector<BoxRecord> reloaded = index.GetBoxes(0);
+    check("set-boxes 3, save, reload: " + std::to_string(reloaded.size()) + " boxes", saved && same(reloaded, expected));
+
+    std::ostringstream reply;
+    FormatControlBoxes(reply, reloaded);
+    check("get-boxes reply parses back", ParseControlBoxes(reply.str(), boxes, error) && same(boxes, expected));
+
+    std::error_code removeError;
+    std::filesystem::remove_all(directory, removeError);
+    return ok;
+}
+
+}  // namespace
+
+int main() {
+    bool edits = VerifySidecarEdits(std::cout);
+    bool control = VerifyControlBoxes(std::cout);
+    return edits && control ? 0 : 1;
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "allocation_tracker.h"
+
+// Fixed-size worker pool shared by the dataset passes (index build, statistics,
+// validation, export). Tasks are plain std::function<void()> jobs; ParallelFor
+// splits an index range into contiguous chunks and blocks until all are done.
+class ThreadPool {
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping = false;
+
+public:
+    explicit ThreadPool(size_t threadCount = 0) {
+        if (threadCount == 0) {
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+        for (size_t i = 0; i < threadCount; i++) {
+            workers.emplace_back([this]() { WorkerLoop(); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        condition.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Process-wide pool sized to the number of hardware threads
+    static ThreadPool& Shared() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    size_t Size() const { return workers.size(); }
+
+    std::future<void> Submit(std::function<void()> task) {
+#if defined(J_BBOX_TRACK_ALLOCATIONS)
+        // Attribute the task's allocations to the submitting subsystem
+        task = [task = std::move(task), tag = CurrentAllocationTag()]() {
+            AllocationScope scope(tag);
+            task();
+        };
+#endif
+        auto packaged = std::make_shared<std::packaged_task<void()>>(std::move(task));
+        std::future<void> result = packaged->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push([packaged]() { (*packaged)(); });
+        }
+        condition.notify_one();
+        return result;
+    }
+
+    // Calls fn(chunkBegin, chunkEnd, chunkIndex) for contiguous chunks covering
+    // [begin, end). Returns the number of chunks used so callers can size
+    // per-chunk accumulators with MaxChunks() up front.
+    size_t ParallelFor(size_t begin, size_t end, const std::function<void(size_t, size_t, size_t)>& fn,
+                       size_t minChunkSize = 1024) {
+        if (end <= begin) return 0;
+        size_t count = end - begin;
+        size_t chunks = std::min(MaxChunks(), (count + minChunkSize - 1) / minChunkSize);
+        chunks = std::max<size_t>(1, chunks);
+
+        if (chunks == 1) {
+            fn(begin, end, 0);
+            return 1;
+        }
+
+        size_t chunkSize = (count + chunks - 1) / chunks;
+        std::vector<std::future<void>> pending;
+        pending.reserve(chunks);
+        for (size_t c = 0; c < chunks; c++) {
+            size_t chunkBegin = begin + c * chunkSize;
+            size_t chunkEnd = std::min(end, chunkBegin + chunkSize);
+            if (chunkBegin >= chunkEnd) break;
+            pending.push_back(Submit([&fn, chunkBegin, chunkEnd, c]() { fn(chunkBegin, chunkEnd, c); }));
+        }
+        for (auto& f : pending) {
+            f.get();  // rethrows exceptions from workers
+        }
+        return pending.size();
+    }
+
+    size_t MaxChunks() const { return workers.size() * 4; }
+
+private:
+    void WorkerLoop() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+                if (stopping && tasks.empty()) return;
+                task = std::move(tasks.front());
+                tasks.pop();
+            }
+            task();
+        }
+    }
+};
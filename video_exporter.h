@@ -0,0 +1,163 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <future>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "annotation_index.h"
+#include "preview_exporter.h"
+#include "thread_pool.h"
+
+struct VideoOptions {
+    double fps = 30.0;
+    PreviewOptions overlay;     // decode scale, line thickness and labels
+    size_t reorderWindow = 0;   // frames in flight ahead of the writer; 0 = 2 per worker
+};
+
+struct VideoExportResult {
+    size_t frames = 0;
+    size_t failed = 0;          // undecodable images, replaced by the previous frame
+    int width = 0;
+    int height = 0;
+    double seconds = 0.0;
+
+    double FramesPerSecond() const { return seconds > 0.0 ? frames / seconds : 0.0; }
+};
+
+// Renders the images of an index, in order, into a video with boxes drawn.
+//
+// Pool workers claim frame numbers in order, decode and draw them and park the
+// result in a reorder buffer; the calling thread writes frames to
+// cv::VideoWriter strictly in sequence as they become available. Workers may
+// only run reorderWindow frames ahead of the writer, which bounds memory when
+// encoding is the bottleneck.
+class VideoExporter {
+private:
+    VideoOptions options;
+    ThreadPool& pool;
+
+public:
+    explicit VideoExporter(const VideoOptions& exportOptions, ThreadPool& threadPool = ThreadPool::Shared())
+        : options(exportOptions), pool(threadPool) {}
+
+    VideoExportResult Export(const AnnotationIndex& index, const std::string& outputPath) {
+        auto start = std::chrono::steady_clock::now();
+        VideoExportResult result;
+        size_t frameCount = index.ImageCount();
+        if (frameCount == 0) return result;
+
+        PreviewExporter renderer(options.overlay, pool);
+        size_t workers = std::min(pool.Size(), frameCount);
+        size_t window = options.reorderWindow > 0 ? options.reorderWindow : workers * 2;
+
+        std::mutex mutex;
+        std::condition_variable frameReady;
+        std::condition_variable slotFree;
+        std::map<size_t, cv::Mat> reorder;
+        size_t nextToClaim = 0;
+        size_t written = 0;
+        bool cancelled = false;
+
+        auto worker = [&]() {
+            while (true) {
+                size_t frame;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    slotFree.wait(lock, [&]() { return cancelled || nextToClaim >= frameCount || nextToClaim < written + window; });
+                    if (cancelled || nextToClaim >= frameCount) return;
+                    frame = nextToClaim++;
+                }
+
+                cv::Mat image;
+                if (!renderer.RenderPreview(index, (uint32_t)frame, image)) {
+                    image.release();
+                }
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    reorder.emplace(frame, std::move(image));
+                }
+                frameReady.notify_one();
+            }
+        };
+
+        std::vector<std::future<void>> tasks;
+        for (size_t i = 0; i < workers; i++) {
+            tasks.push_back(pool.Submit(worker));
+        }
+
+        cv::VideoWriter writer;
+        cv::Mat previous;
+        cv::Size frameSize;
+        for (size_t frame = 0; frame < frameCount; frame++) {
+            cv::Mat image;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                frameReady.wait(lock, [&]() { return reorder.count(frame) > 0; });
+                auto it = reorder.find(frame);
+                image = std::move(it->second);
+                reorder.erase(it);
+                written = frame + 1;
+            }
+            slotFree.notify_all();
+
+            if (image.empty()) {
+                result.failed++;
+                if (previous.empty()) continue;  // nothing decoded yet to stand in
+                image = previous;
+            }
+
+            // The first decoded frame fixes the video size
+            if (!writer.isOpened()) {
+                frameSize = image.size();
+                if (!writer.open(outputPath, FourccForPath(outputPath), options.fps, frameSize)) {
+                    std::cerr << "Failed to open video writer: " << outputPath << std::endl;
+                    std::lock_guard<std::mutex> lock(mutex);
+                    cancelled = true;
+                    break;
+                }
+                result.width = frameSize.width;
+                result.height = frameSize.height;
+            }
+            if (image.size() != frameSize) {
+                cv::Mat resized;
+                cv::resize(image, resized, frameSize, 0, 0, cv::INTER_AREA);
+                image = resized;
+            }
+
+            writer.write(image);
+            previous = image;
+            result.frames++;
+            if (result.frames % 500 == 0) {
+                std::cout << "Encoded " << result.frames << "/" << frameCount << " frames" << std::endl;
+            }
+        }
+
+        slotFree.notify_all();
+        for (auto& task : tasks) {
+            task.get();
+        }
+        writer.release();
+
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return result;
+    }
+
+private:
+    static int FourccForPath(const std::string& path) {
+        std::string extension = std::filesystem::path(path).extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        if (extension == ".avi") return cv::VideoWriter::fourcc('M', 'J', 'P', 'G');
+        return cv::VideoWriter::fourcc('m', 'p', '4', 'v');
+    }
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "annotation_index.h"
+
+enum class ViewerEventType {
+    BoxCommitted,  // a box was drawn, resized or set remotely
+    Navigated,     // a new image was loaded
+    Saved          // the sidecar CSV was written
+};
+
+inline const char* ViewerEventName(ViewerEventType type) {
+    switch (type) {
+        case ViewerEventType::BoxCommitted: return "box";
+        case ViewerEventType::Navigated: return "navigate";
+        case ViewerEventType::Saved: return "save";
+        default: return "unknown";
+    }
+}
+
+// Emitted by ImageViewer for every user-visible state change; consumed by the
+// control socket and other integrations
+struct ViewerEvent {
+    ViewerEventType type = ViewerEventType::Navigated;
+    int imageIndex = -1;
+    int imageCount = 0;
+    std::string imagePath;
+    int imageWidth = 0;
+    int imageHeight = 0;
+    std::vector<BoxRecord> boxes;  // pixel coordinates
+};